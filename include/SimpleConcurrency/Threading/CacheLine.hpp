@@ -0,0 +1,102 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <new>
+#include <utility>
+
+
+#ifndef SIMPLECONCURRENCY_CACHE_LINE_SIZE
+#define SIMPLECONCURRENCY_CACHE_LINE_SIZE 64
+#endif // !SIMPLECONCURRENCY_CACHE_LINE_SIZE
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A base for a class holding `CacheLinePadded` members, so that
+ *        `new` puts it on a cache-line boundary, as over-aligned `new` is
+ *        not available before C++17.
+ *
+ */
+struct CacheLineAligned
+{
+	static constexpr size_t sk_cacheLineSize =
+		SIMPLECONCURRENCY_CACHE_LINE_SIZE;
+
+	static void* operator new(size_t size)
+	{
+		// the original pointer is kept right before the aligned one;
+		// there is always room, as `::operator new` aligns to at least
+		// the size of a pointer
+		void* raw = ::operator new(size + sk_cacheLineSize);
+		uintptr_t aligned =
+			(reinterpret_cast<uintptr_t>(raw) + sk_cacheLineSize) &
+			~static_cast<uintptr_t>(sk_cacheLineSize - 1);
+		reinterpret_cast<void**>(aligned)[-1] = raw;
+		return reinterpret_cast<void*>(aligned);
+	}
+
+	static void operator delete(void* ptr) noexcept
+	{
+		if (ptr != nullptr)
+		{
+			::operator delete(reinterpret_cast<void**>(ptr)[-1]);
+		}
+	}
+
+protected:
+
+	CacheLineAligned() = default;
+
+	~CacheLineAligned() = default;
+
+}; // struct CacheLineAligned
+
+
+/**
+ * @brief Wraps a value so that it is aligned to, and occupies, whole cache
+ *        lines by itself, which prevents false sharing with its neighbours.
+ *        NOTE: before C++17, `new` does not honour over-alignment, so a
+ *        class holding these on the heap should derive from
+ *        `CacheLineAligned` to be allocated on a cache-line boundary.
+ *
+ */
+template<typename _ValType>
+struct alignas(SIMPLECONCURRENCY_CACHE_LINE_SIZE) CacheLinePadded
+{
+	static constexpr size_t sk_cacheLineSize =
+		SIMPLECONCURRENCY_CACHE_LINE_SIZE;
+
+	CacheLinePadded() :
+		m_value()
+	{}
+
+	template<typename _ArgType>
+	explicit CacheLinePadded(_ArgType&& arg) :
+		m_value(std::forward<_ArgType>(arg))
+	{}
+
+	// `alignas` also rounds the size up to whole cache lines
+	_ValType m_value;
+
+}; // struct CacheLinePadded
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
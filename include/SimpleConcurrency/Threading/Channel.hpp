@@ -0,0 +1,752 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include <atomic>
+#include <iterator>
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+#include "CacheLine.hpp"
+#include "Executor.hpp"
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A lock-free list of tasks waiting for a channel to become
+ *        readable or writable.
+ *        Waiting tasks are not holding any thread; they are submitted to
+ *        their executors once the channel state changes.
+ *
+ */
+class ChannelWaiterList
+{
+public:
+	ChannelWaiterList() :
+		m_head(nullptr)
+	{}
+
+	ChannelWaiterList(const ChannelWaiterList&) = delete;
+	ChannelWaiterList& operator=(const ChannelWaiterList&) = delete;
+
+	// LCOV_EXCL_START
+	~ChannelWaiterList()
+	{
+		// waiters that were never woken up are dropped without running
+		Node* node = m_head.exchange(nullptr);
+		while (node != nullptr)
+		{
+			Node* next = node->m_next;
+			delete node;
+			node = next;
+		}
+	}
+	// LCOV_EXCL_STOP
+
+
+	void Push(Executor& executor, std::unique_ptr<Task> task)
+	{
+		Node* node = new Node(executor, std::move(task));
+		node->m_next = m_head.load(std::memory_order_relaxed);
+		while (
+			!m_head.compare_exchange_weak(
+				node->m_next,
+				node,
+				std::memory_order_seq_cst,
+				std::memory_order_relaxed
+			)
+		)
+		{}
+	}
+
+
+	bool HasWaiters() const
+	{
+		return m_head.load(std::memory_order_relaxed) != nullptr;
+	}
+
+
+	/**
+	 * @brief Submit all waiting tasks to their executors.
+	 *        Each waiter is taken by exactly one caller, so concurrent
+	 *        calls never submit the same task twice.
+	 *
+	 */
+	void WakeAll()
+	{
+		Node* node = m_head.exchange(nullptr, std::memory_order_acq_rel);
+		while (node != nullptr)
+		{
+			std::unique_ptr<Node> curr(node);
+			node = node->m_next;
+
+			curr->m_executor->AddTask(std::move(curr->m_task));
+		}
+	}
+
+
+private:
+
+	struct Node
+	{
+		Node(Executor& executor, std::unique_ptr<Task> task) :
+			m_executor(&executor),
+			m_task(std::move(task)),
+			m_next(nullptr)
+		{}
+
+		Executor* m_executor;
+		std::unique_ptr<Task> m_task;
+		Node* m_next;
+	}; // struct Node
+
+	std::atomic<Node*> m_head;
+
+}; // class ChannelWaiterList
+
+
+class ChannelBase
+{
+public:
+
+	static size_t RoundUpCapacity(size_t capacity)
+	{
+		if (capacity == 0)
+		{
+			throw std::invalid_argument(
+				"The capacity of a channel must be greater than zero"
+			);
+		}
+
+		size_t res = 1;
+		while (res < capacity)
+		{
+			res <<= 1;
+		}
+		return res;
+	}
+
+
+public:
+	ChannelBase(const ChannelBase&) = delete;
+	ChannelBase& operator=(const ChannelBase&) = delete;
+
+	// LCOV_EXCL_START
+	virtual ~ChannelBase() = default;
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Close the channel, so that no more value can be sent.
+	 *        Values that are already in the channel can still be received.
+	 *        All waiting tasks are woken up.
+	 *        NOTE: this should be called after all producers have finished
+	 *        sending; otherwise, a concurrent send may still be delivered.
+	 *
+	 */
+	void Close()
+	{
+		m_isClosed.store(true, std::memory_order_seq_cst);
+		m_readWaiters.WakeAll();
+		m_writeWaiters.WakeAll();
+	}
+
+
+	bool IsClosed() const
+	{
+		return m_isClosed.load(std::memory_order_seq_cst);
+	}
+
+
+	/**
+	 * @brief Check if the channel is closed and there is nothing left to be
+	 *        received.
+	 *        NOTE: only the consumer should call this function.
+	 *
+	 */
+	bool IsDrained() const
+	{
+		// the closed flag must be checked first, so that values sent
+		// before the channel was closed are visible to the check below
+		return IsClosed() && !HasValueToReceive();
+	}
+
+
+	/**
+	 * @brief Submit `task` to `executor` once there is a value to receive,
+	 *        or once the channel is closed.
+	 *        This allows a consumer task to give its worker back to the pool
+	 *        instead of blocking the thread on an empty channel.
+	 *        NOTE: only the consumer should call this function.
+	 *
+	 */
+	void WhenReadable(Executor& executor, std::unique_ptr<Task> task)
+	{
+		if (HasValueToReceive() || IsClosed())
+		{
+			executor.AddTask(std::move(task));
+			return;
+		}
+
+		m_readWaiters.Push(executor, std::move(task));
+
+		// a value may be sent between the check above and the push,
+		// in which case the producer may have missed our waiter
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (HasValueToReceive() || IsClosed())
+		{
+			m_readWaiters.WakeAll();
+		}
+	}
+
+
+	/**
+	 * @brief Submit `task` to `executor` once there is room to send a value,
+	 *        or once the channel is closed.
+	 *
+	 */
+	void WhenWritable(Executor& executor, std::unique_ptr<Task> task)
+	{
+		if (HasRoomToSend() || IsClosed())
+		{
+			executor.AddTask(std::move(task));
+			return;
+		}
+
+		m_writeWaiters.Push(executor, std::move(task));
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (HasRoomToSend() || IsClosed())
+		{
+			m_writeWaiters.WakeAll();
+		}
+	}
+
+
+protected:
+
+	ChannelBase() :
+		m_isClosed(false),
+		m_readWaiters(),
+		m_writeWaiters()
+	{}
+
+
+	virtual bool HasValueToReceive() const = 0;
+
+
+	virtual bool HasRoomToSend() const = 0;
+
+
+	void NotifyReadable()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_readWaiters.HasWaiters())
+		{
+			m_readWaiters.WakeAll();
+		}
+	}
+
+
+	void NotifyWritable()
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		if (m_writeWaiters.HasWaiters())
+		{
+			m_writeWaiters.WakeAll();
+		}
+	}
+
+
+private:
+
+	std::atomic_bool m_isClosed;
+	ChannelWaiterList m_readWaiters;
+	ChannelWaiterList m_writeWaiters;
+
+}; // class ChannelBase
+
+
+/**
+ * @brief A bounded, lock-free, single-producer single-consumer channel.
+ *
+ * @tparam _ValType The type of the values passed through the channel;
+ *                  its move constructor must not throw.
+ */
+template<typename _ValType>
+class SpscChannel :
+	public ChannelBase,
+	public CacheLineAligned
+{
+public: // static members:
+
+	static_assert(
+		std::is_nothrow_move_constructible<_ValType>::value,
+		"The move constructor of the channel value type must not throw"
+	);
+
+	using ValueType = _ValType;
+
+
+public:
+
+	explicit SpscChannel(size_t capacity) :
+		ChannelBase(),
+		m_capacity(RoundUpCapacity(capacity)),
+		m_mask(m_capacity - 1),
+		m_buffer(new Storage[m_capacity]),
+		m_producer(),
+		m_consumer()
+	{}
+
+	// LCOV_EXCL_START
+	virtual ~SpscChannel()
+	{
+		size_t head = m_consumer.m_value.m_pos.load();
+		size_t tail = m_producer.m_value.m_pos.load();
+		for (; head != tail; ++head)
+		{
+			SlotPtr(head)->~_ValType();
+		}
+	}
+	// LCOV_EXCL_STOP
+
+
+	size_t GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+
+	/**
+	 * @brief Get the number of values in the channel; the result is only
+	 *        exact when neither end is active.
+	 *
+	 */
+	size_t GetSize() const
+	{
+		size_t head = m_consumer.m_value.m_pos.load(std::memory_order_acquire);
+		size_t tail = m_producer.m_value.m_pos.load(std::memory_order_acquire);
+		return tail - head;
+	}
+
+
+	bool TrySend(_ValType&& val)
+	{
+		return TrySendBatch(&val, &val + 1) == 1;
+	}
+
+
+	bool TrySend(const _ValType& val)
+	{
+		_ValType tmp(val);
+		return TrySend(std::move(tmp));
+	}
+
+
+	/**
+	 * @brief Send as many values from [first, last) as there is room for,
+	 *        publishing all of them at once.
+	 *        Values that are sent are moved out of the input range.
+	 *
+	 * @return The number of values sent, which are always the leading ones
+	 *         in the input range.
+	 */
+	template<typename _InputIt>
+	size_t TrySendBatch(_InputIt first, _InputIt last)
+	{
+		if (IsClosed())
+		{
+			return 0;
+		}
+
+		EndState& self = m_producer.m_value;
+		const size_t begin = self.m_pos.load(std::memory_order_relaxed);
+		size_t tail = begin;
+		for (; first != last; ++first, ++tail)
+		{
+			if (tail - self.m_cachedOtherPos == m_capacity)
+			{
+				// only refresh the consumer position when the cached one
+				// says the channel is full
+				self.m_cachedOtherPos =
+					m_consumer.m_value.m_pos.load(std::memory_order_acquire);
+				if (tail - self.m_cachedOtherPos == m_capacity)
+				{
+					break;
+				}
+			}
+			new (SlotPtr(tail)) _ValType(std::move(*first));
+		}
+
+		if (tail != begin)
+		{
+			self.m_pos.store(tail, std::memory_order_release);
+			NotifyReadable();
+		}
+		return tail - begin;
+	}
+
+
+	bool TryReceive(_ValType& out)
+	{
+		return TryReceiveBatch(&out, 1) == 1;
+	}
+
+
+	/**
+	 * @brief Receive up to `maxCount` values into `out`, releasing all of
+	 *        their slots at once.
+	 *
+	 * @return The number of values received.
+	 */
+	template<typename _OutputIt>
+	size_t TryReceiveBatch(_OutputIt out, size_t maxCount)
+	{
+		EndState& self = m_consumer.m_value;
+		const size_t head = self.m_pos.load(std::memory_order_relaxed);
+		if (self.m_cachedOtherPos - head < maxCount)
+		{
+			self.m_cachedOtherPos =
+				m_producer.m_value.m_pos.load(std::memory_order_acquire);
+		}
+
+		size_t count = self.m_cachedOtherPos - head;
+		count = count < maxCount ? count : maxCount;
+		for (size_t i = 0; i < count; ++i, ++out)
+		{
+			_ValType* valPtr = SlotPtr(head + i);
+			*out = std::move(*valPtr);
+			valPtr->~_ValType();
+		}
+
+		if (count > 0)
+		{
+			self.m_pos.store(head + count, std::memory_order_release);
+			NotifyWritable();
+		}
+		return count;
+	}
+
+
+protected:
+
+	virtual bool HasValueToReceive() const override
+	{
+		return
+			m_producer.m_value.m_pos.load(std::memory_order_acquire) !=
+			m_consumer.m_value.m_pos.load(std::memory_order_relaxed);
+	}
+
+
+	virtual bool HasRoomToSend() const override
+	{
+		return
+			(m_producer.m_value.m_pos.load(std::memory_order_relaxed) -
+				m_consumer.m_value.m_pos.load(std::memory_order_acquire)) <
+			m_capacity;
+	}
+
+
+private:
+
+	using Storage = typename std::aligned_storage<
+		sizeof(_ValType),
+		alignof(_ValType)
+	>::type;
+
+	struct EndState
+	{
+		EndState() :
+			m_pos(0),
+			m_cachedOtherPos(0)
+		{}
+
+		// the position owned by this end
+		std::atomic<size_t> m_pos;
+		// the last known position of the other end, only accessed by
+		// the thread owning this end
+		size_t m_cachedOtherPos;
+	}; // struct EndState
+
+
+	_ValType* SlotPtr(size_t pos)
+	{
+		return reinterpret_cast<_ValType*>(&m_buffer[pos & m_mask]);
+	}
+
+
+	const size_t m_capacity;
+	const size_t m_mask;
+	std::unique_ptr<Storage[]> m_buffer;
+	CacheLinePadded<EndState> m_producer;
+	CacheLinePadded<EndState> m_consumer;
+
+}; // class SpscChannel
+
+
+/**
+ * @brief A bounded, lock-free, multi-producer single-consumer channel.
+ *        Producers claim slots with a single CAS, so a batch of values is
+ *        claimed at once as well.
+ *
+ * @tparam _ValType The type of the values passed through the channel;
+ *                  its move constructor must not throw.
+ */
+template<typename _ValType>
+class MpscChannel :
+	public ChannelBase,
+	public CacheLineAligned
+{
+public: // static members:
+
+	static_assert(
+		std::is_nothrow_move_constructible<_ValType>::value,
+		"The move constructor of the channel value type must not throw"
+	);
+
+	using ValueType = _ValType;
+
+
+public:
+
+	explicit MpscChannel(size_t capacity) :
+		ChannelBase(),
+		m_capacity(RoundUpCapacity(capacity)),
+		m_mask(m_capacity - 1),
+		m_slots(new Slot[m_capacity]),
+		m_head(0),
+		m_tail(0)
+	{
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			m_slots[i].m_seq.store(0, std::memory_order_relaxed);
+		}
+	}
+
+	// LCOV_EXCL_START
+	virtual ~MpscChannel()
+	{
+		size_t head = m_head.m_value.load();
+		size_t tail = m_tail.m_value.load();
+		for (; head != tail; ++head)
+		{
+			SlotPtr(head)->~_ValType();
+		}
+	}
+	// LCOV_EXCL_STOP
+
+
+	size_t GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+
+	/**
+	 * @brief Get the number of values in the channel; the result is only
+	 *        exact when neither end is active.
+	 *
+	 */
+	size_t GetSize() const
+	{
+		size_t head = m_head.m_value.load(std::memory_order_acquire);
+		size_t tail = m_tail.m_value.load(std::memory_order_acquire);
+		return tail - head;
+	}
+
+
+	bool TrySend(_ValType&& val)
+	{
+		return TrySendBatch(&val, &val + 1) == 1;
+	}
+
+
+	bool TrySend(const _ValType& val)
+	{
+		_ValType tmp(val);
+		return TrySend(std::move(tmp));
+	}
+
+
+	/**
+	 * @brief Send as many values from [first, last) as there is room for.
+	 *        Values that are sent are moved out of the input range.
+	 *
+	 * @tparam _InputIt A forward iterator type.
+	 *
+	 * @return The number of values sent, which are always the leading ones
+	 *         in the input range.
+	 */
+	template<typename _InputIt>
+	size_t TrySendBatch(_InputIt first, _InputIt last)
+	{
+		const size_t wanted = static_cast<size_t>(std::distance(first, last));
+		if (wanted == 0 || IsClosed())
+		{
+			return 0;
+		}
+
+		// claim a range of slots
+		size_t begin = m_tail.m_value.load(std::memory_order_relaxed);
+		size_t count = 0;
+		while (true)
+		{
+			size_t head = m_head.m_value.load(std::memory_order_acquire);
+			size_t used = begin - head;
+			if (used > m_capacity)
+			{
+				// our tail is older than the head we just read
+				begin = m_tail.m_value.load(std::memory_order_relaxed);
+				continue;
+			}
+
+			count = m_capacity - used;
+			if (count == 0)
+			{
+				return 0;
+			}
+			count = count < wanted ? count : wanted;
+
+			if (
+				m_tail.m_value.compare_exchange_weak(
+					begin,
+					begin + count,
+					std::memory_order_relaxed,
+					std::memory_order_relaxed
+				)
+			)
+			{
+				break;
+			}
+		}
+
+		// fill and publish the claimed slots
+		for (size_t i = 0; i < count; ++i, ++first)
+		{
+			const size_t pos = begin + i;
+			new (SlotPtr(pos)) _ValType(std::move(*first));
+			m_slots[pos & m_mask].m_seq.store(pos + 1, std::memory_order_release);
+		}
+
+		NotifyReadable();
+		return count;
+	}
+
+
+	bool TryReceive(_ValType& out)
+	{
+		return TryReceiveBatch(&out, 1) == 1;
+	}
+
+
+	/**
+	 * @brief Receive up to `maxCount` values into `out`, releasing all of
+	 *        their slots at once.
+	 *        Values are received in the order their slots were claimed; a
+	 *        claimed but not yet published slot stops the batch.
+	 *
+	 * @return The number of values received.
+	 */
+	template<typename _OutputIt>
+	size_t TryReceiveBatch(_OutputIt out, size_t maxCount)
+	{
+		const size_t head = m_head.m_value.load(std::memory_order_relaxed);
+
+		size_t count = 0;
+		for (; count < maxCount; ++count, ++out)
+		{
+			const size_t pos = head + count;
+			if (
+				m_slots[pos & m_mask].m_seq.load(std::memory_order_acquire) !=
+				pos + 1
+			)
+			{
+				break;
+			}
+
+			_ValType* valPtr = SlotPtr(pos);
+			*out = std::move(*valPtr);
+			valPtr->~_ValType();
+		}
+
+		if (count > 0)
+		{
+			m_head.m_value.store(head + count, std::memory_order_release);
+			NotifyWritable();
+		}
+		return count;
+	}
+
+
+protected:
+
+	virtual bool HasValueToReceive() const override
+	{
+		const size_t head = m_head.m_value.load(std::memory_order_relaxed);
+		return
+			m_slots[head & m_mask].m_seq.load(std::memory_order_acquire) ==
+			head + 1;
+	}
+
+
+	virtual bool HasRoomToSend() const override
+	{
+		return
+			(m_tail.m_value.load(std::memory_order_relaxed) -
+				m_head.m_value.load(std::memory_order_acquire)) <
+			m_capacity;
+	}
+
+
+private:
+
+	using Storage = typename std::aligned_storage<
+		sizeof(_ValType),
+		alignof(_ValType)
+	>::type;
+
+	struct Slot
+	{
+		// `pos + 1` once the value for position `pos` is published
+		std::atomic<size_t> m_seq;
+		Storage m_storage;
+	}; // struct Slot
+
+
+	_ValType* SlotPtr(size_t pos)
+	{
+		return reinterpret_cast<_ValType*>(&(m_slots[pos & m_mask].m_storage));
+	}
+
+
+	const size_t m_capacity;
+	const size_t m_mask;
+	std::unique_ptr<Slot[]> m_slots;
+	CacheLinePadded<std::atomic<size_t> > m_head;
+	CacheLinePadded<std::atomic<size_t> > m_tail;
+
+}; // class MpscChannel
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,586 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+
+#include "Executor.hpp"
+#include "IntrusiveTaskQueue.hpp"
+#include "IntrusiveTaskStack.hpp"
+#include "SyncPrimitives.hpp"
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A task that calls the `Finishing` function of another task,
+ *        so that it can be run by an executor.
+ *
+ */
+class FinishingTask :
+	public Task
+{
+public:
+	FinishingTask(std::unique_ptr<Task> task) :
+		m_task(std::move(task))
+	{}
+
+	// LCOV_EXCL_START
+	virtual ~FinishingTask() = default;
+	// LCOV_EXCL_STOP
+
+
+	virtual void Run() override
+	{
+		m_task->Finishing();
+	}
+
+
+	virtual void Terminate() override
+	{}
+
+
+	virtual void OnException(std::exception_ptr ePtr) override
+	{
+		m_task->OnException(ePtr);
+	}
+
+
+private:
+
+	std::unique_ptr<Task> m_task;
+
+}; // class FinishingTask
+
+
+/**
+ * @brief The completion policy of `BasicThreadPool`, which supports all
+ *        completion modes, chosen per pool and per task at run time
+ *        (see `CompletionMode`).
+ *        A completion policy is a base class of the pool, so its public
+ *        functions are part of the interface of the pool; it provides
+ *        `Update()` and `GetNumOfFinishedTasks()`, and to the pool:
+ *        - `OnTaskSubmitted(task)`, called when a task is added
+ *        - `CompleteTask(task)`, called when a task has run
+ *        - `StopCompletion()`, called when the pool terminates
+ *
+ */
+class DefaultCompletionPolicy
+{
+public:
+	DefaultCompletionPolicy() :
+		m_finishedTasksInbox(),
+		m_finishTasksQueueMutex(),
+		m_finishTasksQueue(),
+		m_routedFinishTasks(),
+		m_finishTasksQueueSize(0),
+		m_updatingThreadsSize(0),
+
+		m_completionMode(CompletionMode::Update),
+		m_completionExecutor(nullptr),
+		m_completionThreadMutex(),
+		m_completionThreadCV(),
+		m_completionThread(),
+		m_completionThreadQueue(),
+		m_isCompletionThreadStarted(false),
+		m_isCompletionThreadStopping(false)
+	{}
+
+
+protected:
+
+	// only destroyed as a base of the pool, so it is not virtual
+	~DefaultCompletionPolicy() = default;
+
+
+public:
+
+
+	/**
+	 * @brief Call the `Finishing` functions of the finished tasks.
+	 *        This can be called by multiple threads at once; each call
+	 *        takes a fair share of the finished tasks at a time, plus all
+	 *        tasks routed to the calling thread
+	 *        (see `CompletionMode::UpdateOnSubmitter`).
+	 *        If a `Finishing` function throws, the exception is propagated,
+	 *        and the tasks not finished yet are put back.
+	 *
+	 */
+	void Update()
+	{
+		UpdatingThreadGuard guard(m_updatingThreadsSize);
+
+		const std::thread::id threadId = std::this_thread::get_id();
+		IntrusiveTaskQueue tasks;
+
+		// check if there are any finished tasks
+		while (m_finishTasksQueueSize > 0)
+		{
+			// Fetch a batch of finished tasks
+			FetchFinishedTasks(threadId, tasks);
+			if (tasks.IsEmpty())
+			{
+				// the rest are taken by, or routed to, other threads
+				break;
+			}
+
+			// call finishing functions
+			while (!tasks.IsEmpty())
+			{
+				std::unique_ptr<Task> task = tasks.PopFront();
+				try
+				{
+					task->Finishing();
+				}
+				catch(...)
+				{
+					ReturnFinishedTasks(threadId, tasks);
+					throw;
+				}
+			}
+		}
+	}
+
+
+	/**
+	 * @brief Choose where the `Finishing` functions of tasks are called,
+	 *        unless a task chooses otherwise.
+	 *        The default is `CompletionMode::Update`.
+	 *
+	 */
+	void SetCompletionMode(CompletionMode mode)
+	{
+		if (mode == CompletionMode::UsePoolDefault)
+		{
+			throw std::invalid_argument(
+				"The pool must have a concrete completion mode"
+			);
+		}
+		if (mode == CompletionMode::OnExecutor && m_completionExecutor == nullptr)
+		{
+			throw std::invalid_argument(
+				"The completion executor must be set first"
+			);
+		}
+		m_completionMode = mode;
+	}
+
+
+	CompletionMode GetCompletionMode() const
+	{
+		return m_completionMode;
+	}
+
+
+	/**
+	 * @brief Set the executor for `CompletionMode::OnExecutor`, and make it
+	 *        the completion mode of the pool.
+	 *        Tasks choosing `CompletionMode::OnExecutor` fall back to
+	 *        `CompletionMode::Update` if this is never called.
+	 *
+	 */
+	void SetCompletionExecutor(Executor& executor)
+	{
+		m_completionExecutor = &executor;
+		m_completionMode = CompletionMode::OnExecutor;
+	}
+
+
+	/**
+	 * @brief Get the number of finished tasks waiting for `Update`.
+	 *
+	 */
+	size_t GetNumOfFinishedTasks() const
+	{
+		// it may be briefly negative, see `PushTaskToFinishQueue`
+		int64_t size = m_finishTasksQueueSize;
+		return size > 0 ? static_cast<size_t>(size) : 0;
+	}
+
+
+protected:
+
+
+	void OnTaskSubmitted(Task& task)
+	{
+		if (GetEffectiveCompletionMode(task) == CompletionMode::UpdateOnSubmitter)
+		{
+			task.SetSubmitterThreadId(std::this_thread::get_id());
+		}
+	}
+
+
+	void CompleteTask(std::unique_ptr<Task> task)
+	{
+		CompletionMode mode = GetEffectiveCompletionMode(*task);
+
+		Executor* completionExecutor = m_completionExecutor;
+		switch (mode)
+		{
+		case CompletionMode::Inline:
+			RunFinishingCaught(*task);
+			break;
+
+		case CompletionMode::DedicatedThread:
+			PushTaskToCompletionThread(std::move(task));
+			break;
+
+		case CompletionMode::OnExecutor:
+			if (completionExecutor != nullptr)
+			{
+				completionExecutor->AddTask(
+					std::unique_ptr<Task>(new FinishingTask(std::move(task)))
+				);
+				break;
+			}
+			// no executor is given, fall back to the default mode
+			PushTaskToFinishQueue(std::move(task), false);
+			break;
+
+		case CompletionMode::UpdateOnSubmitter:
+			PushTaskToFinishQueue(std::move(task), true);
+			break;
+
+		case CompletionMode::UsePoolDefault:
+		case CompletionMode::Update:
+		default:
+			PushTaskToFinishQueue(std::move(task), false);
+			break;
+		}
+	}
+
+
+	void StopCompletion()
+	{
+		StopCompletionThread();
+	}
+
+
+	static void RunFinishingCaught(Task& task)
+	{
+		try
+		{
+			task.Finishing();
+		}
+		catch(...)
+		{
+			task.OnException(std::current_exception());
+		}
+	}
+
+
+private: // private types:
+
+
+	struct UpdatingThreadGuard
+	{
+		UpdatingThreadGuard(std::atomic<size_t>& counter) :
+			m_counter(counter)
+		{
+			++m_counter;
+		}
+
+		~UpdatingThreadGuard()
+		{
+			--m_counter;
+		}
+
+		std::atomic<size_t>& m_counter;
+	}; // struct UpdatingThreadGuard
+
+
+private: // private functions:
+
+
+	void PushTaskToFinishQueue(std::unique_ptr<Task> task, bool isRouted)
+	{
+		// a task keeps its submitter only if it is routed back to it
+		if (!isRouted)
+		{
+			task->SetSubmitterThreadId(std::thread::id());
+		}
+
+		// workers don't take any lock here; the tasks are sorted out by
+		// the threads calling `Update`.
+		// the size goes up after the push, so a task counted is always
+		// there to be taken, but it may be taken before being counted
+		m_finishedTasksInbox.Push(std::move(task));
+		++m_finishTasksQueueSize;
+	}
+
+
+	void SortInboxNonLocking()
+	{
+		IntrusiveTaskQueue newTasks = m_finishedTasksInbox.PopAll();
+		while (!newTasks.IsEmpty())
+		{
+			std::unique_ptr<Task> task = newTasks.PopFront();
+			std::thread::id submitterId = task->GetSubmitterThreadId();
+			if (submitterId != std::thread::id())
+			{
+				m_routedFinishTasks[submitterId].PushBack(std::move(task));
+			}
+			else
+			{
+				m_finishTasksQueue.PushBack(std::move(task));
+			}
+		}
+	}
+
+
+	void FetchFinishedTasks(
+		std::thread::id threadId,
+		IntrusiveTaskQueue& tasks
+	)
+	{
+		std::lock_guard<Mutex> lock(m_finishTasksQueueMutex);
+		SortInboxNonLocking();
+
+		// tasks routed to this thread are not shared with others;
+		// the emptied queue is kept, so routing more tasks to this thread
+		// doesn't insert into the map again
+		auto it = m_routedFinishTasks.find(threadId);
+		if (it != m_routedFinishTasks.end())
+		{
+			tasks.SpliceBack(it->second);
+		}
+
+		// take a fair share of the shared queue
+		size_t numOfThreads = m_updatingThreadsSize;
+		numOfThreads = numOfThreads > 0 ? numOfThreads : 1;
+		size_t share =
+			(m_finishTasksQueue.Size() + numOfThreads - 1) / numOfThreads;
+		for (size_t i = 0; i < share; ++i)
+		{
+			tasks.PushBack(m_finishTasksQueue.PopFront());
+		}
+
+		m_finishTasksQueueSize -= static_cast<int64_t>(tasks.Size());
+	}
+
+
+	void ReturnFinishedTasks(
+		std::thread::id threadId,
+		IntrusiveTaskQueue& tasks
+	)
+	{
+		// the tasks routed to this thread go back to it, so no other
+		// thread finishes them
+		IntrusiveTaskQueue routedTasks;
+		IntrusiveTaskQueue sharedTasks;
+		while (!tasks.IsEmpty())
+		{
+			std::unique_ptr<Task> task = tasks.PopFront();
+			if (task->GetSubmitterThreadId() == threadId)
+			{
+				routedTasks.PushBack(std::move(task));
+			}
+			else
+			{
+				sharedTasks.PushBack(std::move(task));
+			}
+		}
+
+		std::lock_guard<Mutex> lock(m_finishTasksQueueMutex);
+
+		// put them back to the front, so they are still the first ones
+		m_finishTasksQueueSize += static_cast<int64_t>(
+			routedTasks.Size() + sharedTasks.Size()
+		);
+		if (!routedTasks.IsEmpty())
+		{
+			m_routedFinishTasks[threadId].SpliceFront(routedTasks);
+		}
+		m_finishTasksQueue.SpliceFront(sharedTasks);
+	}
+
+
+	CompletionMode GetEffectiveCompletionMode(const Task& task) const
+	{
+		CompletionMode mode = task.GetCompletionMode();
+		return mode == CompletionMode::UsePoolDefault ?
+			m_completionMode.load() : mode;
+	}
+
+
+	void CompletionThreadRunner()
+	{
+		while (true)
+		{
+			std::unique_ptr<Task> task;
+			{
+				std::unique_lock<Mutex> lock(m_completionThreadMutex);
+				m_completionThreadCV.wait(
+					lock,
+					[this]()
+					{
+						return
+							!m_completionThreadQueue.IsEmpty() ||
+							m_isCompletionThreadStopping;
+					}
+				);
+
+				// finish the remaining tasks before stopping
+				if (m_completionThreadQueue.IsEmpty())
+				{
+					return;
+				}
+				task = m_completionThreadQueue.PopFront();
+			}
+
+			try
+			{
+				RunFinishingCaught(*task);
+			}
+			catch(...)
+			{
+				// there is nobody to rethrow to in this thread
+			}
+		}
+	}
+
+
+	void PushTaskToCompletionThread(std::unique_ptr<Task> task)
+	{
+		{
+			std::lock_guard<Mutex> lock(m_completionThreadMutex);
+			if (!m_isCompletionThreadStarted)
+			{
+				// the thread is started on first use
+				m_completionThread = Thread(
+					[this]()
+					{
+						CompletionThreadRunner();
+					}
+				);
+				m_isCompletionThreadStarted = true;
+			}
+			m_completionThreadQueue.PushBack(std::move(task));
+		}
+		m_completionThreadCV.notify_one();
+	}
+
+
+	void StopCompletionThread()
+	{
+		{
+			std::lock_guard<Mutex> lock(m_completionThreadMutex);
+			if (!m_isCompletionThreadStarted)
+			{
+				return;
+			}
+			m_isCompletionThreadStopping = true;
+		}
+		m_completionThreadCV.notify_all();
+
+		m_completionThread.join();
+
+		std::lock_guard<Mutex> lock(m_completionThreadMutex);
+		m_isCompletionThreadStarted = false;
+		m_isCompletionThreadStopping = false;
+	}
+
+
+private:
+
+	// finished tasks pushed by the workers, lock-free
+	IntrusiveTaskStack m_finishedTasksInbox;
+	// finished tasks taken from the inbox, guarded by the mutex, which
+	// is only taken by the threads calling `Update`
+	mutable Mutex m_finishTasksQueueMutex;
+	IntrusiveTaskQueue m_finishTasksQueue;
+	std::unordered_map<std::thread::id, IntrusiveTaskQueue> m_routedFinishTasks;
+	std::atomic<int64_t> m_finishTasksQueueSize;
+	std::atomic<size_t> m_updatingThreadsSize;
+
+	std::atomic<CompletionMode> m_completionMode;
+	std::atomic<Executor*> m_completionExecutor;
+	mutable Mutex m_completionThreadMutex;
+	mutable ConditionVariable m_completionThreadCV;
+	Thread m_completionThread;
+	IntrusiveTaskQueue m_completionThreadQueue;
+	bool m_isCompletionThreadStarted;
+	bool m_isCompletionThreadStopping;
+
+}; // class DefaultCompletionPolicy
+
+
+/**
+ * @brief The completion policy of `BasicThreadPool` where the `Finishing`
+ *        function of every task is called by its worker right after `Run`,
+ *        whatever completion mode the task chooses; there is no finished
+ *        task queue, and `Update` does nothing.
+ *
+ */
+class InlineCompletionPolicy
+{
+public:
+	InlineCompletionPolicy() = default;
+
+
+protected:
+
+	~InlineCompletionPolicy() = default;
+
+
+public:
+
+
+	void Update()
+	{}
+
+
+	size_t GetNumOfFinishedTasks() const
+	{
+		return 0;
+	}
+
+
+protected:
+
+
+	void OnTaskSubmitted(Task&)
+	{}
+
+
+	void CompleteTask(std::unique_ptr<Task> task)
+	{
+		try
+		{
+			task->Finishing();
+		}
+		catch(...)
+		{
+			task->OnException(std::current_exception());
+		}
+	}
+
+
+	void StopCompletion()
+	{}
+
+}; // class InlineCompletionPolicy
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,401 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <condition_variable>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#ifdef __linux__
+#include <sched.h>
+#endif // __linux__
+
+#include "ThreadPoolBase.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief Finds out how many CPUs this process can actually use, from its
+ *        affinity mask and its cgroup (v1 or v2) CPU quota, rather than
+ *        the number of CPUs of the host, which, in a container, leads to
+ *        more busy workers than the quota allows, and so CFS throttling.
+ *
+ */
+class CpuQuota
+{
+public: // static members:
+
+
+	/**
+	 * @brief Parse the content of a cgroup v2 `cpu.max` file,
+	 *        e.g., "150000 100000".
+	 *
+	 * @return The quota in CPUs, or 0 if there is no limit.
+	 */
+	static double ParseCpuMax(const std::string& content)
+	{
+		std::istringstream iss(content);
+		std::string quota;
+		int64_t periodUs = 0;
+		if (!(iss >> quota >> periodUs) || quota == "max")
+		{
+			return 0.0;
+		}
+
+		std::istringstream quotaIss(quota);
+		int64_t quotaUs = 0;
+		if (!(quotaIss >> quotaUs))
+		{
+			return 0.0;
+		}
+		return ParseCfsQuota(quotaUs, periodUs);
+	}
+
+
+	/**
+	 * @brief Get the quota from the values of cgroup v1
+	 *        `cpu.cfs_quota_us` and `cpu.cfs_period_us`.
+	 *
+	 * @return The quota in CPUs, or 0 if there is no limit.
+	 */
+	static double ParseCfsQuota(int64_t quotaUs, int64_t periodUs)
+	{
+		if (quotaUs <= 0 || periodUs <= 0)
+		{
+			// -1 means no limit
+			return 0.0;
+		}
+		return static_cast<double>(quotaUs) / static_cast<double>(periodUs);
+	}
+
+
+	/**
+	 * @brief Get the CPU quota of the cgroup of this process, which is the
+	 *        tightest one along its path, as the limits of the parents
+	 *        apply too.
+	 *
+	 * @param procCgroupPath The file listing the cgroups of the process.
+	 * @param cgroupRoot Where the cgroup file systems are mounted.
+	 * @return The quota in CPUs, or 0 if there is no limit, or it can't
+	 *         be read.
+	 */
+	static double GetCgroupCpuQuota(
+		const std::string& procCgroupPath = "/proc/self/cgroup",
+		const std::string& cgroupRoot = "/sys/fs/cgroup"
+	)
+	{
+		std::ifstream procFile(procCgroupPath);
+		std::string line;
+		double quota = 0.0;
+		while (std::getline(procFile, line))
+		{
+			// "<hierarchy ID>:<controllers>:<path>"
+			size_t first = line.find(':');
+			size_t second =
+				first == std::string::npos ? first : line.find(':', first + 1);
+			if (second == std::string::npos)
+			{
+				continue;
+			}
+			std::string controllers = line.substr(first + 1, second - first - 1);
+			std::string path = line.substr(second + 1);
+
+			if (controllers.empty())
+			{
+				// v2, with all controllers in one hierarchy
+				quota = TighterQuota(
+					quota, GetQuotaAlongPath(cgroupRoot, path, true)
+				);
+			}
+			else if (HasController(controllers, "cpu"))
+			{
+				// v1, usually mounted at "cpu,cpuacct", with a "cpu" link
+				quota = TighterQuota(
+					quota,
+					GetQuotaAlongPath(cgroupRoot + "/" + controllers, path, false)
+				);
+				quota = TighterQuota(
+					quota, GetQuotaAlongPath(cgroupRoot + "/cpu", path, false)
+				);
+			}
+		}
+		return quota;
+	}
+
+
+	/**
+	 * @brief Get the number of CPUs in the affinity mask of this process.
+	 *
+	 */
+	static size_t GetNumOfAffinityCpus()
+	{
+#ifdef __linux__
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		if (sched_getaffinity(0, sizeof(cpuSet), &cpuSet) == 0)
+		{
+			int numOfCpus = CPU_COUNT(&cpuSet);
+			if (numOfCpus > 0)
+			{
+				return static_cast<size_t>(numOfCpus);
+			}
+		}
+#endif // __linux__
+		unsigned int numOfCpus = std::thread::hardware_concurrency();
+		return numOfCpus > 0 ? numOfCpus : 1;
+	}
+
+
+	/**
+	 * @brief Get the pool size that keeps the CPUs this process can use
+	 *        busy, without going over its quota; a fraction of a CPU is
+	 *        rounded down, since an extra worker would be throttled.
+	 *        E.g., `ThreadPool pool(CpuQuota::GetDefaultPoolSize());`.
+	 *
+	 */
+	static size_t GetDefaultPoolSize()
+	{
+		size_t numOfCpus = GetNumOfAffinityCpus();
+
+		double quota = GetCgroupCpuQuota();
+		if (quota > 0.0)
+		{
+			size_t quotaCpus = static_cast<size_t>(quota);
+			quotaCpus = quotaCpus > 0 ? quotaCpus : 1;
+			numOfCpus = quotaCpus < numOfCpus ? quotaCpus : numOfCpus;
+		}
+		return numOfCpus;
+	}
+
+
+private: // private functions:
+
+
+	static double TighterQuota(double a, double b)
+	{
+		if (a <= 0.0)
+		{
+			return b;
+		}
+		if (b <= 0.0)
+		{
+			return a;
+		}
+		return a < b ? a : b;
+	}
+
+
+	static bool HasController(
+		const std::string& controllers,
+		const std::string& controller
+	)
+	{
+		std::istringstream iss(controllers);
+		std::string item;
+		while (std::getline(iss, item, ','))
+		{
+			if (item == controller)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	static std::string ReadFile(const std::string& path)
+	{
+		std::ifstream file(path);
+		std::stringstream ss;
+		ss << file.rdbuf();
+		return ss.str();
+	}
+
+
+	static double ReadQuota(const std::string& dir, bool isV2)
+	{
+		if (isV2)
+		{
+			return ParseCpuMax(ReadFile(dir + "/cpu.max"));
+		}
+
+		int64_t quotaUs = 0;
+		int64_t periodUs = 0;
+		std::istringstream quotaIss(ReadFile(dir + "/cpu.cfs_quota_us"));
+		std::istringstream periodIss(ReadFile(dir + "/cpu.cfs_period_us"));
+		if (!(quotaIss >> quotaUs) || !(periodIss >> periodUs))
+		{
+			return 0.0;
+		}
+		return ParseCfsQuota(quotaUs, periodUs);
+	}
+
+
+	static double GetQuotaAlongPath(
+		const std::string& mountDir,
+		std::string path,
+		bool isV2
+	)
+	{
+		// from the cgroup of the process up to the root; in a container
+		// without a cgroup namespace, the path of the process is not under
+		// the mount, but the root of the mount is the cgroup of the
+		// container, so it is still found
+		double quota = 0.0;
+		while (true)
+		{
+			quota = TighterQuota(
+				quota, ReadQuota(path == "/" ? mountDir : mountDir + path, isV2)
+			);
+
+			size_t pos = path.rfind('/');
+			if (pos == std::string::npos || path == "/")
+			{
+				return quota;
+			}
+			path = pos == 0 ? "/" : path.substr(0, pos);
+		}
+	}
+
+}; // class CpuQuota
+
+
+/**
+ * @brief Keeps the size of a pool following the CPUs the process can use,
+ *        by checking them periodically in a thread of its own, so that the
+ *        pool shrinks and grows with a changed CPU quota.
+ *
+ */
+class CpuQuotaWatcher
+{
+public:
+
+	using Sizer = std::function<size_t()>;
+
+
+	/**
+	 * @param pool The pool to resize.
+	 * @param interval How often to check.
+	 * @param sizer The function giving the pool size; by default,
+	 *              `CpuQuota::GetDefaultPoolSize`.
+	 */
+	CpuQuotaWatcher(
+		ThreadPoolBase& pool,
+		std::chrono::milliseconds interval,
+		Sizer sizer = &CpuQuota::GetDefaultPoolSize
+	) :
+		m_pool(pool),
+		m_interval(interval),
+		m_sizer(std::move(sizer)),
+		m_mutex(),
+		m_cv(),
+		m_isStopping(false),
+		m_thread()
+	{
+		m_thread = std::thread(
+			[this]()
+			{
+				WatcherRunner();
+			}
+		);
+	}
+
+
+	CpuQuotaWatcher(const CpuQuotaWatcher&) = delete;
+
+	CpuQuotaWatcher& operator=(const CpuQuotaWatcher&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~CpuQuotaWatcher()
+	{
+		Stop();
+	}
+	// LCOV_EXCL_STOP
+
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isStopping = true;
+		}
+		m_cv.notify_all();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+
+private: // private functions:
+
+
+	void WatcherRunner()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_isStopping)
+		{
+			try
+			{
+				size_t poolSize = m_sizer();
+				if (poolSize > 0 && poolSize != m_pool.GetPoolSize())
+				{
+					m_pool.SetPoolSize(poolSize);
+				}
+			}
+			catch(...)
+			{
+				// keep the current size
+			}
+
+			m_cv.wait_for(
+				lock,
+				m_interval,
+				[this]()
+				{
+					return m_isStopping;
+				}
+			);
+		}
+	}
+
+
+private:
+
+	ThreadPoolBase& m_pool;
+	std::chrono::milliseconds m_interval;
+	Sizer m_sizer;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_isStopping;
+	std::thread m_thread;
+
+}; // class CpuQuotaWatcher
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
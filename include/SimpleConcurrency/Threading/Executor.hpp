@@ -0,0 +1,45 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <memory>
+
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+class Executor
+{
+public:
+	Executor() = default;
+
+	// LCOV_EXCL_START
+	virtual ~Executor() = default;
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Submit a task to be executed by this executor.
+	 *
+	 */
+	virtual void AddTask(std::unique_ptr<Task> task) = 0;
+
+
+}; // class Executor
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
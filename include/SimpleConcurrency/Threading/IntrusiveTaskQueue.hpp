@@ -0,0 +1,242 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include <memory>
+#include <utility>
+
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A double-ended queue of tasks linked through the hooks in the
+ *        tasks themselves, so that queuing a task never allocates.
+ *        It owns the tasks in it; a task can only be in one queue at a
+ *        time, which owning it makes sure of.
+ *        It is not thread-safe.
+ *
+ */
+class IntrusiveTaskQueue
+{
+public:
+	IntrusiveTaskQueue() :
+		m_front(nullptr),
+		m_back(nullptr),
+		m_size(0)
+	{}
+
+
+	IntrusiveTaskQueue(IntrusiveTaskQueue&& other) :
+		m_front(other.m_front),
+		m_back(other.m_back),
+		m_size(other.m_size)
+	{
+		other.m_front = nullptr;
+		other.m_back = nullptr;
+		other.m_size = 0;
+	}
+
+
+	IntrusiveTaskQueue(const IntrusiveTaskQueue&) = delete;
+
+	IntrusiveTaskQueue& operator=(const IntrusiveTaskQueue&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~IntrusiveTaskQueue()
+	{
+		Clear();
+	}
+	// LCOV_EXCL_STOP
+
+
+	bool IsEmpty() const
+	{
+		return m_front == nullptr;
+	}
+
+
+	size_t Size() const
+	{
+		return m_size;
+	}
+
+
+	void PushBack(std::unique_ptr<Task> task)
+	{
+		Task* taskPtr = task.release();
+		taskPtr->m_queuePrev = m_back;
+		taskPtr->m_queueNext = nullptr;
+		if (m_back != nullptr)
+		{
+			m_back->m_queueNext = taskPtr;
+		}
+		else
+		{
+			m_front = taskPtr;
+		}
+		m_back = taskPtr;
+		++m_size;
+	}
+
+
+	void PushFront(std::unique_ptr<Task> task)
+	{
+		Task* taskPtr = task.release();
+		taskPtr->m_queuePrev = nullptr;
+		taskPtr->m_queueNext = m_front;
+		if (m_front != nullptr)
+		{
+			m_front->m_queuePrev = taskPtr;
+		}
+		else
+		{
+			m_back = taskPtr;
+		}
+		m_front = taskPtr;
+		++m_size;
+	}
+
+
+	/**
+	 * @brief Pop the front task, or return `nullptr` if it is empty.
+	 *
+	 */
+	std::unique_ptr<Task> PopFront()
+	{
+		Task* taskPtr = m_front;
+		if (taskPtr == nullptr)
+		{
+			return nullptr;
+		}
+
+		m_front = taskPtr->m_queueNext;
+		if (m_front != nullptr)
+		{
+			m_front->m_queuePrev = nullptr;
+		}
+		else
+		{
+			m_back = nullptr;
+		}
+		--m_size;
+		return Unlink(taskPtr);
+	}
+
+
+	/**
+	 * @brief Pop the back task, or return `nullptr` if it is empty.
+	 *
+	 */
+	std::unique_ptr<Task> PopBack()
+	{
+		Task* taskPtr = m_back;
+		if (taskPtr == nullptr)
+		{
+			return nullptr;
+		}
+
+		m_back = taskPtr->m_queuePrev;
+		if (m_back != nullptr)
+		{
+			m_back->m_queueNext = nullptr;
+		}
+		else
+		{
+			m_front = nullptr;
+		}
+		--m_size;
+		return Unlink(taskPtr);
+	}
+
+
+	/**
+	 * @brief Move all tasks of `other` to the back of this queue, in order.
+	 *
+	 */
+	void SpliceBack(IntrusiveTaskQueue& other)
+	{
+		if (other.IsEmpty())
+		{
+			return;
+		}
+
+		if (IsEmpty())
+		{
+			m_front = other.m_front;
+		}
+		else
+		{
+			m_back->m_queueNext = other.m_front;
+			other.m_front->m_queuePrev = m_back;
+		}
+		m_back = other.m_back;
+		m_size += other.m_size;
+
+		other.m_front = nullptr;
+		other.m_back = nullptr;
+		other.m_size = 0;
+	}
+
+
+	/**
+	 * @brief Move all tasks of `other` to the front of this queue, in order.
+	 *
+	 */
+	void SpliceFront(IntrusiveTaskQueue& other)
+	{
+		other.SpliceBack(*this);
+		std::swap(m_front, other.m_front);
+		std::swap(m_back, other.m_back);
+		std::swap(m_size, other.m_size);
+	}
+
+
+	/**
+	 * @brief Delete all tasks in the queue.
+	 *
+	 */
+	void Clear()
+	{
+		while (!IsEmpty())
+		{
+			PopFront();
+		}
+	}
+
+
+private:
+
+	static std::unique_ptr<Task> Unlink(Task* taskPtr)
+	{
+		taskPtr->m_queuePrev = nullptr;
+		taskPtr->m_queueNext = nullptr;
+		return std::unique_ptr<Task>(taskPtr);
+	}
+
+
+	Task* m_front;
+	Task* m_back;
+	size_t m_size;
+
+}; // class IntrusiveTaskQueue
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
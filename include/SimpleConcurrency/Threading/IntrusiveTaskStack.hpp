@@ -0,0 +1,107 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include <atomic>
+#include <memory>
+
+#include "IntrusiveTaskQueue.hpp"
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A lock-free multi-producer stack of tasks (a Treiber stack),
+ *        linked through the hooks in the tasks, like `IntrusiveTaskQueue`.
+ *        Any thread can push to it, and the consumer takes all tasks at
+ *        once with a single atomic exchange, in the order they were pushed.
+ *        Since tasks are never popped one by one, there is no ABA problem.
+ *
+ */
+class IntrusiveTaskStack
+{
+public:
+	IntrusiveTaskStack() :
+		m_top(nullptr)
+	{}
+
+
+	IntrusiveTaskStack(const IntrusiveTaskStack&) = delete;
+
+	IntrusiveTaskStack& operator=(const IntrusiveTaskStack&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~IntrusiveTaskStack()
+	{
+		// the tasks left are deleted with the returned queue
+		PopAll();
+	}
+	// LCOV_EXCL_STOP
+
+
+	bool IsEmpty() const
+	{
+		return m_top.load(std::memory_order_relaxed) == nullptr;
+	}
+
+
+	void Push(std::unique_ptr<Task> task)
+	{
+		Task* taskPtr = task.release();
+		taskPtr->m_queuePrev = nullptr;
+
+		Task* top = m_top.load(std::memory_order_relaxed);
+		do
+		{
+			taskPtr->m_queueNext = top;
+		} while (!m_top.compare_exchange_weak(
+			top, taskPtr, std::memory_order_release, std::memory_order_relaxed
+		));
+	}
+
+
+	/**
+	 * @brief Take all tasks, in the order they were pushed.
+	 *
+	 */
+	IntrusiveTaskQueue PopAll()
+	{
+		Task* taskPtr = m_top.exchange(nullptr, std::memory_order_acquire);
+
+		// the stack is newest first, so reverse it
+		IntrusiveTaskQueue tasks;
+		while (taskPtr != nullptr)
+		{
+			Task* next = taskPtr->m_queueNext;
+			tasks.PushFront(std::unique_ptr<Task>(taskPtr));
+			taskPtr = next;
+		}
+		return tasks;
+	}
+
+
+private:
+
+	std::atomic<Task*> m_top;
+
+}; // class IntrusiveTaskStack
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,528 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#ifdef __linux__
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <cerrno>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "Executor.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief Waits for file descriptors to become ready, and then posts the
+ *        waiting tasks to an executor, so that waiting on I/O does not
+ *        occupy any worker.
+ *        A waiting task is posted once; the descriptor should be
+ *        non-blocking, and the task should retry the I/O and wait again
+ *        if it is still not ready.
+ *        Regular files are always ready, so their waiting tasks are posted
+ *        right away.
+ *
+ */
+class IoReactor
+{
+public: // static members:
+
+	static constexpr size_t sk_maxEventsPerPoll = 64;
+
+
+public:
+
+	IoReactor(Executor& executor) :
+		m_executor(executor),
+		m_epollFd(-1),
+		m_wakeFd(-1),
+		m_mutex(),
+		m_waiters(),
+		m_numOfWaiters(0),
+		m_thread(),
+		m_isStopping(false),
+		m_threadError()
+	{
+		m_epollFd = epoll_create1(EPOLL_CLOEXEC);
+		if (m_epollFd < 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "epoll_create1");
+		}
+
+		m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+		if (m_wakeFd < 0)
+		{
+			int err = errno;
+			close(m_epollFd);
+			throw std::system_error(err, std::generic_category(), "eventfd");
+		}
+
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.fd = m_wakeFd;
+		if (epoll_ctl(m_epollFd, EPOLL_CTL_ADD, m_wakeFd, &event) != 0)
+		{
+			int err = errno;
+			close(m_wakeFd);
+			close(m_epollFd);
+			throw std::system_error(err, std::generic_category(), "epoll_ctl");
+		}
+	}
+
+
+	IoReactor(const IoReactor&) = delete;
+
+	IoReactor& operator=(const IoReactor&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~IoReactor()
+	{
+		Stop();
+		close(m_wakeFd);
+		close(m_epollFd);
+	}
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Post the task to the executor once `fd` is readable,
+	 *        or has hung up or failed.
+	 *
+	 */
+	void WhenReadable(int fd, std::unique_ptr<Task> task)
+	{
+		AddWaiter(fd, EPOLLIN, std::move(task));
+	}
+
+
+	/**
+	 * @brief Post the task to the executor once `fd` is writable,
+	 *        or has hung up or failed.
+	 *
+	 */
+	void WhenWritable(int fd, std::unique_ptr<Task> task)
+	{
+		AddWaiter(fd, EPOLLOUT, std::move(task));
+	}
+
+
+	/**
+	 * @brief Stop watching `fd`, and drop the tasks waiting on it;
+	 *        this must be called before `fd` is closed.
+	 *
+	 */
+	void Deregister(int fd)
+	{
+		Waiters dropped;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			auto it = m_waiters.find(fd);
+			if (it == m_waiters.end())
+			{
+				return;
+			}
+			dropped = std::move(it->second);
+			m_waiters.erase(it);
+			m_numOfWaiters -=
+				dropped.m_readTasks.size() + dropped.m_writeTasks.size();
+
+			epoll_ctl(m_epollFd, EPOLL_CTL_DEL, fd, nullptr);
+		}
+		// the dropped tasks are destroyed here, without holding the lock
+	}
+
+
+	/**
+	 * @brief Wait up to `timeoutMs` milliseconds (-1 for no limit) for
+	 *        ready descriptors, and post their waiting tasks.
+	 *        This is only needed when the reactor is not started.
+	 *        If the executor fails to take a task, the task is lost, but
+	 *        the rest are still posted, and then the first error is
+	 *        rethrown.
+	 *
+	 * @return The number of tasks posted.
+	 */
+	size_t Poll(int timeoutMs)
+	{
+		std::vector<std::unique_ptr<Task> > readyTasks;
+		WaitForReadyTasks(timeoutMs, readyTasks);
+		return PostTasks(readyTasks);
+	}
+
+
+	/**
+	 * @brief Start a thread that keeps polling, until `Stop` is called.
+	 *        The thread keeps polling when the executor fails to take a
+	 *        task; if polling itself fails, the thread stops, and the
+	 *        error can be found with `GetThreadError`.
+	 *
+	 */
+	void Start()
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (m_thread.joinable())
+		{
+			return;
+		}
+
+		m_isStopping = false;
+		m_threadError = nullptr;
+		m_thread = std::thread(
+			[this]()
+			{
+				PollerRunner();
+			}
+		);
+	}
+
+
+	void Stop()
+	{
+		std::thread thread;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			thread.swap(m_thread);
+			m_isStopping = true;
+		}
+
+		if (thread.joinable())
+		{
+			Wake();
+			thread.join();
+		}
+	}
+
+
+	/**
+	 * @brief Get the number of tasks waiting for their descriptors.
+	 *
+	 */
+	size_t GetNumOfWaiters() const
+	{
+		return m_numOfWaiters;
+	}
+
+
+	/**
+	 * @brief Get the error that stopped the thread started by `Start`,
+	 *        if any; only valid after `Stop`.
+	 *
+	 */
+	std::exception_ptr GetThreadError() const
+	{
+		return m_threadError;
+	}
+
+
+private: // private types:
+
+
+	struct Waiters
+	{
+		Waiters() :
+			m_readTasks(),
+			m_writeTasks(),
+			m_isRegistered(false)
+		{}
+
+		uint32_t GetEvents() const
+		{
+			uint32_t events = 0;
+			events |= m_readTasks.empty() ? 0 : static_cast<uint32_t>(EPOLLIN);
+			events |= m_writeTasks.empty() ? 0 : static_cast<uint32_t>(EPOLLOUT);
+			return events;
+		}
+
+		std::deque<std::unique_ptr<Task> > m_readTasks;
+		std::deque<std::unique_ptr<Task> > m_writeTasks;
+		bool m_isRegistered;
+	}; // struct Waiters
+
+
+private: // private functions:
+
+
+	void WaitForReadyTasks(
+		int timeoutMs,
+		std::vector<std::unique_ptr<Task> >& readyTasks
+	)
+	{
+		epoll_event events[sk_maxEventsPerPoll];
+		int numOfEvents = epoll_wait(
+			m_epollFd,
+			events,
+			static_cast<int>(sk_maxEventsPerPoll),
+			timeoutMs
+		);
+		if (numOfEvents < 0)
+		{
+			if (errno == EINTR)
+			{
+				return;
+			}
+			throw std::system_error(errno, std::generic_category(), "epoll_wait");
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (int i = 0; i < numOfEvents; ++i)
+		{
+			if (events[i].data.fd == m_wakeFd)
+			{
+				uint64_t val = 0;
+				ssize_t ret = read(m_wakeFd, &val, sizeof(val));
+				(void)ret;
+				continue;
+			}
+			CollectReadyNonLocking(
+				events[i].data.fd,
+				events[i].events,
+				readyTasks
+			);
+		}
+	}
+
+
+	size_t PostTasks(std::vector<std::unique_ptr<Task> >& readyTasks)
+	{
+		std::exception_ptr exception;
+		for (auto& task : readyTasks)
+		{
+			try
+			{
+				m_executor.AddTask(std::move(task));
+			}
+			catch(...)
+			{
+				if (!exception)
+				{
+					exception = std::current_exception();
+				}
+			}
+		}
+
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+		return readyTasks.size();
+	}
+
+
+	void PollerRunner()
+	{
+		while (!m_isStopping)
+		{
+			std::vector<std::unique_ptr<Task> > readyTasks;
+			try
+			{
+				WaitForReadyTasks(-1, readyTasks);
+			}
+			catch(...)
+			{
+				// it would fail again, e.g., with the epoll descriptor
+				// gone; the waiting tasks stay until deregistered
+				m_threadError = std::current_exception();
+				return;
+			}
+
+			try
+			{
+				PostTasks(readyTasks);
+			}
+			catch(...)
+			{
+				// only the task the executor failed to take is lost
+			}
+		}
+	}
+
+
+	void Wake()
+	{
+		uint64_t val = 1;
+		ssize_t ret = write(m_wakeFd, &val, sizeof(val));
+		(void)ret;
+	}
+
+
+	bool ArmNonLocking(int fd, Waiters& waiters)
+	{
+		epoll_event event = {};
+		event.events = waiters.GetEvents() | EPOLLONESHOT;
+		event.data.fd = fd;
+
+		int op = waiters.m_isRegistered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+		if (epoll_ctl(m_epollFd, op, fd, &event) != 0)
+		{
+			if (errno == EPERM)
+			{
+				// the file does not support polling, e.g., a regular file,
+				// which is always ready
+				return false;
+			}
+			throw std::system_error(errno, std::generic_category(), "epoll_ctl");
+		}
+		waiters.m_isRegistered = true;
+		return true;
+	}
+
+
+	void AddWaiter(int fd, uint32_t event, std::unique_ptr<Task> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			Waiters& waiters = m_waiters[fd];
+			std::deque<std::unique_ptr<Task> >& tasks =
+				(event == EPOLLIN) ? waiters.m_readTasks : waiters.m_writeTasks;
+			tasks.push_back(std::move(task));
+
+			bool isArmed = false;
+			try
+			{
+				isArmed = ArmNonLocking(fd, waiters);
+			}
+			catch(...)
+			{
+				task = std::move(tasks.back());
+				tasks.pop_back();
+				if (!waiters.m_isRegistered)
+				{
+					m_waiters.erase(fd);
+				}
+				throw;
+			}
+
+			if (isArmed)
+			{
+				++m_numOfWaiters;
+				return;
+			}
+
+			// always ready
+			task = std::move(tasks.back());
+			tasks.pop_back();
+			if (!waiters.m_isRegistered)
+			{
+				m_waiters.erase(fd);
+			}
+		}
+
+		m_executor.AddTask(std::move(task));
+	}
+
+
+	void CollectReadyNonLocking(
+		int fd,
+		uint32_t events,
+		std::vector<std::unique_ptr<Task> >& readyTasks
+	)
+	{
+		auto it = m_waiters.find(fd);
+		if (it == m_waiters.end())
+		{
+			// deregistered in the meantime
+			return;
+		}
+		Waiters& waiters = it->second;
+
+		// errors and hang-ups wake up both sides, so they can see them
+		const uint32_t errorEvents = EPOLLERR | EPOLLHUP;
+		if (events & (EPOLLIN | errorEvents))
+		{
+			MoveTasks(waiters.m_readTasks, readyTasks);
+		}
+		if (events & (EPOLLOUT | errorEvents))
+		{
+			MoveTasks(waiters.m_writeTasks, readyTasks);
+		}
+
+		// a one-shot registration is disabled once fired,
+		// so re-arm it for the side that is still waiting
+		if (waiters.GetEvents() != 0)
+		{
+			bool isArmed = false;
+			try
+			{
+				isArmed = ArmNonLocking(fd, waiters);
+			}
+			catch(...)
+			{
+				// e.g., closed without being deregistered
+			}
+			if (!isArmed)
+			{
+				// let the tasks find out the error by themselves
+				MoveTasks(waiters.m_readTasks, readyTasks);
+				MoveTasks(waiters.m_writeTasks, readyTasks);
+			}
+		}
+	}
+
+
+	void MoveTasks(
+		std::deque<std::unique_ptr<Task> >& tasks,
+		std::vector<std::unique_ptr<Task> >& readyTasks
+	)
+	{
+		m_numOfWaiters -= tasks.size();
+		for (auto& task : tasks)
+		{
+			readyTasks.push_back(std::move(task));
+		}
+		tasks.clear();
+	}
+
+
+private:
+
+	Executor& m_executor;
+	int m_epollFd;
+	int m_wakeFd;
+
+	std::mutex m_mutex;
+	std::unordered_map<int, Waiters> m_waiters;
+	std::atomic<size_t> m_numOfWaiters;
+
+	std::thread m_thread;
+	std::atomic_bool m_isStopping;
+	// only accessed by the thread, or while it is not running
+	std::exception_ptr m_threadError;
+
+}; // class IoReactor
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
+
+
+#endif // __linux__
@@ -0,0 +1,612 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "TaskGroup.hpp"
+#include "ThreadPool.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief Inputs no larger than this are processed serially by default,
+ *        and parallel work is split into pieces no smaller than this.
+ *
+ */
+static constexpr size_t sk_defaultParallelSerialThreshold = 4096;
+
+
+/**
+ * @brief Whether `_ItType` is a random access iterator; the algorithms
+ *        below jump to the start of each chunk, so they require one.
+ *
+ */
+template<typename _ItType>
+struct IsRandomAccessIterator :
+	public std::is_base_of<
+		std::random_access_iterator_tag,
+		typename std::iterator_traits<_ItType>::iterator_category
+	>
+{}; // struct IsRandomAccessIterator
+
+
+/**
+ * @brief Get the number of chunks `[0, size)` is split into for the
+ *        workers of `pool`; a few per worker, so the load is still
+ *        balanced when some chunks take longer.
+ *
+ * @return At least 1, which is when `size` is not larger than
+ *         `serialThreshold`.
+ */
+inline size_t GetNumOfParallelChunks(
+	const ThreadPoolBase& pool,
+	size_t size,
+	size_t serialThreshold
+)
+{
+	serialThreshold = serialThreshold > 0 ? serialThreshold : 1;
+
+	size_t numOfChunks = size / serialThreshold;
+	size_t maxNumOfChunks = pool.GetPoolSize() * 4;
+	numOfChunks = std::min(numOfChunks, maxNumOfChunks);
+	return numOfChunks > 0 ? numOfChunks : 1;
+}
+
+
+/**
+ * @brief Split `[0, size)` into exactly `numOfChunks` chunks, and call
+ *        `func(chunkIdx, begin, end)` for each of them in parallel on the
+ *        workers of `pool`; the first chunk is run by the calling thread.
+ *        Passes that index per-chunk state use this with the same
+ *        `numOfChunks`, so their chunks are split the same way, even if
+ *        the pool is resized in between.
+ *
+ */
+template<typename _FuncType>
+void ParallelForNumOfChunks(
+	ThreadPoolBase& pool,
+	size_t size,
+	size_t numOfChunks,
+	_FuncType func
+)
+{
+	if (numOfChunks <= 1)
+	{
+		func(static_cast<size_t>(0), static_cast<size_t>(0), size);
+		return;
+	}
+
+	TaskGroup group(pool);
+	for (size_t i = 1; i < numOfChunks; ++i)
+	{
+		size_t begin = size * i / numOfChunks;
+		size_t end = size * (i + 1) / numOfChunks;
+		group.Spawn(
+			[&func, i, begin, end]()
+			{
+				func(i, begin, end);
+			}
+		);
+	}
+
+	// if this throws, the group still waits for the other chunks,
+	// which refer to `func`, before it is gone
+	func(static_cast<size_t>(0), static_cast<size_t>(0), size / numOfChunks);
+	group.Wait();
+}
+
+
+/**
+ * @brief Split `[0, size)` into chunks for the workers of `pool`,
+ *        and call `func(chunkIdx, begin, end)` for each of them in
+ *        parallel; the first chunk is run by the calling thread.
+ *
+ * @return The number of chunks, which is 1 when `size` is not larger
+ *         than `serialThreshold`.
+ */
+template<typename _FuncType>
+size_t ParallelForChunks(
+	ThreadPoolBase& pool,
+	size_t size,
+	size_t serialThreshold,
+	_FuncType func
+)
+{
+	size_t numOfChunks = GetNumOfParallelChunks(pool, size, serialThreshold);
+	ParallelForNumOfChunks(pool, size, numOfChunks, std::move(func));
+	return numOfChunks;
+}
+
+
+/**
+ * @brief The same as `std::transform`, with the elements split among the
+ *        workers of `pool`.
+ *
+ */
+template<typename _InIt, typename _OutIt, typename _UnaryOp>
+_OutIt ParallelTransform(
+	ThreadPoolBase& pool,
+	_InIt first,
+	_InIt last,
+	_OutIt out,
+	_UnaryOp op,
+	size_t serialThreshold = sk_defaultParallelSerialThreshold
+)
+{
+	static_assert(
+		IsRandomAccessIterator<_InIt>::value,
+		"A random access iterator is required"
+	);
+	static_assert(
+		IsRandomAccessIterator<_OutIt>::value,
+		"A random access iterator is required"
+	);
+
+	size_t size = static_cast<size_t>(std::distance(first, last));
+	ParallelForChunks(
+		pool,
+		size,
+		serialThreshold,
+		[first, out, &op](size_t, size_t begin, size_t end)
+		{
+			std::transform(first + begin, first + end, out + begin, op);
+		}
+	);
+	return out + size;
+}
+
+
+/**
+ * @brief The same as the binary `std::transform`, with the elements split
+ *        among the workers of `pool`.
+ *        (`_BinaryOp` can't be an integer, so a unary transform with a
+ *        threshold does not resolve to this one.)
+ *
+ */
+template<
+	typename _InIt1,
+	typename _InIt2,
+	typename _OutIt,
+	typename _BinaryOp,
+	typename std::enable_if<!std::is_integral<_BinaryOp>::value, int>::type = 0
+>
+_OutIt ParallelTransform(
+	ThreadPoolBase& pool,
+	_InIt1 first1,
+	_InIt1 last1,
+	_InIt2 first2,
+	_OutIt out,
+	_BinaryOp op,
+	size_t serialThreshold = sk_defaultParallelSerialThreshold
+)
+{
+	static_assert(
+		IsRandomAccessIterator<_InIt1>::value,
+		"A random access iterator is required"
+	);
+	static_assert(
+		IsRandomAccessIterator<_InIt2>::value,
+		"A random access iterator is required"
+	);
+	static_assert(
+		IsRandomAccessIterator<_OutIt>::value,
+		"A random access iterator is required"
+	);
+
+	size_t size = static_cast<size_t>(std::distance(first1, last1));
+	ParallelForChunks(
+		pool,
+		size,
+		serialThreshold,
+		[first1, first2, out, &op](size_t, size_t begin, size_t end)
+		{
+			std::transform(
+				first1 + begin,
+				first1 + end,
+				first2 + begin,
+				out + begin,
+				op
+			);
+		}
+	);
+	return out + size;
+}
+
+
+/**
+ * @brief Scan the chunks of `[first, last)` in parallel; the first pass
+ *        reduces each chunk, and the second pass scans each chunk again,
+ *        starting from the reduction of the chunks before it.
+ *        `out` may be `first`.
+ *
+ */
+template<typename _InIt, typename _OutIt, typename _ValType, typename _BinaryOp>
+_OutIt ParallelScanImpl(
+	ThreadPoolBase& pool,
+	_InIt first,
+	_InIt last,
+	_OutIt out,
+	bool isInclusive,
+	bool hasInit,
+	const _ValType& init,
+	_BinaryOp op,
+	size_t serialThreshold
+)
+{
+	static_assert(
+		IsRandomAccessIterator<_InIt>::value,
+		"A random access iterator is required"
+	);
+	static_assert(
+		IsRandomAccessIterator<_OutIt>::value,
+		"A random access iterator is required"
+	);
+
+	size_t size = static_cast<size_t>(std::distance(first, last));
+	if (size == 0)
+	{
+		return out;
+	}
+
+	// reduce each chunk; the number of chunks is fixed here, so both
+	// passes split them the same way
+	size_t numOfChunks = GetNumOfParallelChunks(pool, size, serialThreshold);
+	std::vector<_ValType> chunkSums;
+	if (numOfChunks > 1)
+	{
+		chunkSums.assign(numOfChunks, *first);
+		ParallelForNumOfChunks(
+			pool,
+			size,
+			numOfChunks,
+			[first, &chunkSums, &op](size_t chunkIdx, size_t begin, size_t end)
+			{
+				_ValType sum = *(first + begin);
+				for (size_t i = begin + 1; i < end; ++i)
+				{
+					sum = op(sum, *(first + i));
+				}
+				chunkSums[chunkIdx] = sum;
+			}
+		);
+	}
+
+	// the starting value of each chunk
+	std::vector<_ValType> chunkStarts;
+	chunkStarts.reserve(numOfChunks);
+	chunkStarts.push_back(init);
+	for (size_t i = 1; i < numOfChunks; ++i)
+	{
+		if (i == 1 && !hasInit)
+		{
+			chunkStarts.push_back(chunkSums[0]);
+		}
+		else
+		{
+			chunkStarts.push_back(op(chunkStarts[i - 1], chunkSums[i - 1]));
+		}
+	}
+
+	ParallelForNumOfChunks(
+		pool,
+		size,
+		numOfChunks,
+		[&](size_t chunkIdx, size_t begin, size_t end)
+		{
+			size_t i = begin;
+			_ValType sum = chunkStarts[chunkIdx];
+			if (chunkIdx == 0 && !hasInit)
+			{
+				// there is nothing to start from
+				sum = *(first + i);
+				*(out + i) = sum;
+				++i;
+			}
+			for (; i < end; ++i)
+			{
+				if (isInclusive)
+				{
+					sum = op(sum, *(first + i));
+					*(out + i) = sum;
+				}
+				else
+				{
+					// read it before it is overwritten, in case of in-place
+					_ValType val = *(first + i);
+					*(out + i) = sum;
+					sum = op(sum, val);
+				}
+			}
+		}
+	);
+
+	return out + size;
+}
+
+
+/**
+ * @brief The same as `std::inclusive_scan` (or `std::partial_sum`),
+ *        with the elements split among the workers of `pool`;
+ *        `op` must be associative.
+ *
+ */
+template<typename _InIt, typename _OutIt, typename _BinaryOp>
+_OutIt ParallelInclusiveScan(
+	ThreadPoolBase& pool,
+	_InIt first,
+	_InIt last,
+	_OutIt out,
+	_BinaryOp op,
+	size_t serialThreshold = sk_defaultParallelSerialThreshold
+)
+{
+	using _ValType = typename std::iterator_traits<_InIt>::value_type;
+	if (first == last)
+	{
+		return out;
+	}
+	_ValType unused = *first;
+	return ParallelScanImpl(
+		pool, first, last, out, true, false, unused, op, serialThreshold
+	);
+}
+
+
+template<typename _InIt, typename _OutIt>
+_OutIt ParallelInclusiveScan(
+	ThreadPoolBase& pool,
+	_InIt first,
+	_InIt last,
+	_OutIt out
+)
+{
+	using _ValType = typename std::iterator_traits<_InIt>::value_type;
+	return ParallelInclusiveScan(pool, first, last, out, std::plus<_ValType>());
+}
+
+
+/**
+ * @brief The same as `std::exclusive_scan`, with the elements split among
+ *        the workers of `pool`; `op` must be associative.
+ *
+ */
+template<typename _InIt, typename _OutIt, typename _ValType, typename _BinaryOp>
+_OutIt ParallelExclusiveScan(
+	ThreadPoolBase& pool,
+	_InIt first,
+	_InIt last,
+	_OutIt out,
+	_ValType init,
+	_BinaryOp op,
+	size_t serialThreshold = sk_defaultParallelSerialThreshold
+)
+{
+	return ParallelScanImpl(
+		pool, first, last, out, false, true, init, op, serialThreshold
+	);
+}
+
+
+template<typename _InIt, typename _OutIt, typename _ValType>
+_OutIt ParallelExclusiveScan(
+	ThreadPoolBase& pool,
+	_InIt first,
+	_InIt last,
+	_OutIt out,
+	_ValType init
+)
+{
+	return ParallelExclusiveScan(
+		pool, first, last, out, init, std::plus<_ValType>()
+	);
+}
+
+
+/**
+ * @brief Merge the sorted ranges into `out` by moving the elements;
+ *        large ranges are split at the middle of the longer one, and the
+ *        two halves are merged in parallel.
+ *
+ */
+template<typename _InIt, typename _OutIt, typename _Compare>
+void ParallelMoveMerge(
+	ThreadPoolBase& pool,
+	_InIt first1,
+	_InIt last1,
+	_InIt first2,
+	_InIt last2,
+	_OutIt out,
+	_Compare& comp,
+	size_t serialThreshold
+)
+{
+	size_t size1 = static_cast<size_t>(last1 - first1);
+	size_t size2 = static_cast<size_t>(last2 - first2);
+	if (size1 + size2 <= serialThreshold)
+	{
+		std::merge(
+			std::make_move_iterator(first1),
+			std::make_move_iterator(last1),
+			std::make_move_iterator(first2),
+			std::make_move_iterator(last2),
+			out,
+			comp
+		);
+		return;
+	}
+
+	if (size1 < size2)
+	{
+		std::swap(first1, first2);
+		std::swap(last1, last2);
+		std::swap(size1, size2);
+	}
+
+	// everything before `mid2` in the second range goes before `*mid1`
+	_InIt mid1 = first1 + size1 / 2;
+	_InIt mid2 = std::lower_bound(first2, last2, *mid1, comp);
+	_OutIt outMid = out + (mid1 - first1) + (mid2 - first2);
+	*outMid = std::move(*mid1);
+
+	TaskGroup group(pool);
+	group.Spawn(
+		[&pool, first1, mid1, first2, mid2, out, &comp, serialThreshold]()
+		{
+			ParallelMoveMerge(
+				pool, first1, mid1, first2, mid2, out, comp, serialThreshold
+			);
+		}
+	);
+	ParallelMoveMerge(
+		pool, mid1 + 1, last1, mid2, last2, outMid + 1, comp, serialThreshold
+	);
+	group.Wait();
+}
+
+
+/**
+ * @brief The same as `std::sort`, using a parallel merge sort on the
+ *        workers of `pool`: the chunks are sorted in parallel, and then
+ *        merged pair by pair, with each merge split among the workers
+ *        as well.
+ *        The elements must be default constructible, as an extra buffer
+ *        of the same size is used; like `std::sort`, it is not stable.
+ *
+ */
+template<typename _RandIt, typename _Compare>
+void ParallelSort(
+	ThreadPoolBase& pool,
+	_RandIt first,
+	_RandIt last,
+	_Compare comp,
+	size_t serialThreshold = sk_defaultParallelSerialThreshold
+)
+{
+	static_assert(
+		IsRandomAccessIterator<_RandIt>::value,
+		"A random access iterator is required"
+	);
+	using _ValType = typename std::iterator_traits<_RandIt>::value_type;
+
+	size_t size = static_cast<size_t>(last - first);
+	serialThreshold = serialThreshold > 0 ? serialThreshold : 1;
+
+	// sort each chunk, and remember where they are; the chunks are split
+	// the same way as the bounds, even if the pool is resized meanwhile
+	std::vector<size_t> bounds;
+	size_t numOfChunks = GetNumOfParallelChunks(pool, size, serialThreshold);
+	if (numOfChunks <= 1)
+	{
+		std::sort(first, last, comp);
+		return;
+	}
+	for (size_t i = 0; i <= numOfChunks; ++i)
+	{
+		bounds.push_back(size * i / numOfChunks);
+	}
+	ParallelForNumOfChunks(
+		pool,
+		size,
+		numOfChunks,
+		[first, &comp](size_t, size_t begin, size_t end)
+		{
+			std::sort(first + begin, first + end, comp);
+		}
+	);
+
+	// merge the neighboring runs, moving between the input and the buffer,
+	// until there is only one left
+	std::vector<_ValType> buffer(size);
+	bool isInBuffer = false;
+	while (bounds.size() > 2)
+	{
+		std::vector<size_t> mergedBounds;
+		TaskGroup group(pool);
+		for (size_t i = 0; i + 1 < bounds.size(); i += 2)
+		{
+			size_t begin = bounds[i];
+			size_t mid = bounds[i + 1];
+			size_t end = (i + 2 < bounds.size()) ? bounds[i + 2] : mid;
+			mergedBounds.push_back(begin);
+
+			auto bufferBegin = buffer.begin();
+			group.Spawn(
+				[&pool, first, bufferBegin, begin, mid, end, isInBuffer, &comp, serialThreshold]()
+				{
+					if (isInBuffer)
+					{
+						ParallelMoveMerge(
+							pool,
+							bufferBegin + begin, bufferBegin + mid,
+							bufferBegin + mid, bufferBegin + end,
+							first + begin,
+							comp, serialThreshold
+						);
+					}
+					else
+					{
+						ParallelMoveMerge(
+							pool,
+							first + begin, first + mid,
+							first + mid, first + end,
+							bufferBegin + begin,
+							comp, serialThreshold
+						);
+					}
+				}
+			);
+		}
+		mergedBounds.push_back(size);
+		group.Wait();
+
+		bounds.swap(mergedBounds);
+		isInBuffer = !isInBuffer;
+	}
+
+	if (isInBuffer)
+	{
+		auto bufferBegin = buffer.begin();
+		ParallelForChunks(
+			pool,
+			size,
+			serialThreshold,
+			[first, bufferBegin](size_t, size_t begin, size_t end)
+			{
+				std::move(bufferBegin + begin, bufferBegin + end, first + begin);
+			}
+		);
+	}
+}
+
+
+template<typename _RandIt>
+void ParallelSort(ThreadPoolBase& pool, _RandIt first, _RandIt last)
+{
+	using _ValType = typename std::iterator_traits<_RandIt>::value_type;
+	ParallelSort(pool, first, last, std::less<_ValType>());
+}
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
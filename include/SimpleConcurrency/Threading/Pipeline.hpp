@@ -0,0 +1,1222 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "Executor.hpp"
+#include "LambdaTask.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+enum class PipelineStageOrder
+{
+	/**
+	 * @brief Items are processed and passed on as soon as possible.
+	 *
+	 */
+	Unordered,
+
+	/**
+	 * @brief Items leave the stage in the order they entered the pipeline.
+	 *        A serial ordered stage also processes them in that order.
+	 *
+	 */
+	Ordered,
+}; // enum class PipelineStageOrder
+
+
+struct PipelineStageConfig
+{
+	static PipelineStageConfig Serial(
+		PipelineStageOrder order,
+		size_t bufferCapacity
+	)
+	{
+		return PipelineStageConfig(1, order, bufferCapacity);
+	}
+
+
+	static PipelineStageConfig Parallel(
+		size_t parallelism,
+		PipelineStageOrder order,
+		size_t bufferCapacity
+	)
+	{
+		return PipelineStageConfig(parallelism, order, bufferCapacity);
+	}
+
+
+	PipelineStageConfig(
+		size_t parallelism,
+		PipelineStageOrder order,
+		size_t bufferCapacity
+	) :
+		m_parallelism(parallelism),
+		m_order(order),
+		m_bufferCapacity(bufferCapacity)
+	{
+		if (m_parallelism == 0 || m_bufferCapacity == 0)
+		{
+			throw std::invalid_argument(
+				"Stage parallelism and buffer capacity must be greater than 0"
+			);
+		}
+	}
+
+
+	bool IsSerial() const
+	{
+		return m_parallelism == 1;
+	}
+
+
+	bool IsOrdered() const
+	{
+		return m_order == PipelineStageOrder::Ordered;
+	}
+
+
+	// the max number of batches of this stage being processed at once
+	size_t m_parallelism;
+	PipelineStageOrder m_order;
+	// the max number of items waiting in front of this stage;
+	// NOTE: a serial ordered stage must be able to buffer any item that
+	// arrives early, so its buffer is only bounded by the pipeline's
+	// in-flight limit
+	size_t m_bufferCapacity;
+}; // struct PipelineStageConfig
+
+
+template<typename _ValType>
+struct PipelineItem
+{
+	PipelineItem(uint64_t seq, _ValType val) :
+		m_seq(seq),
+		m_val(std::move(val))
+	{}
+
+	// the position of the item in the pipeline input
+	uint64_t m_seq;
+	_ValType m_val;
+}; // struct PipelineItem
+
+
+class PipelineNode
+{
+public:
+	PipelineNode() = default;
+
+	// LCOV_EXCL_START
+	virtual ~PipelineNode() = default;
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Called after items are taken out of the input buffer of the
+	 *        downstream stage, so that this node may produce more.
+	 *
+	 */
+	virtual void OnDownstreamRoom() = 0;
+
+
+	/**
+	 * @brief Called when any stage has failed; all items buffered in
+	 *        this node should be dropped.
+	 *
+	 */
+	virtual void OnPipelineFailed() = 0;
+
+
+}; // class PipelineNode
+
+
+template<typename _ValType>
+class PipelineStageInput
+{
+public:
+	PipelineStageInput() = default;
+
+	// LCOV_EXCL_START
+	virtual ~PipelineStageInput() = default;
+	// LCOV_EXCL_STOP
+
+
+	virtual bool HasRoom() const = 0;
+
+
+	/**
+	 * @brief Reserve room in the input buffer for up to `numOfItems`
+	 *        items, which are pushed later without checking for room again.
+	 *
+	 * @return The number of items there is room reserved for.
+	 */
+	virtual size_t ReserveRoom(size_t numOfItems) = 0;
+
+
+	/**
+	 * @brief Give back the room reserved for items that are not pushed
+	 *        after all, e.g., dropped after a failure.
+	 *
+	 */
+	virtual void ReleaseRoom(size_t numOfItems) = 0;
+
+
+	/**
+	 * @brief Push items there is room reserved for.
+	 *
+	 */
+	virtual void PushBatch(std::vector<PipelineItem<_ValType> >& items) = 0;
+
+
+}; // class PipelineStageInput
+
+
+template<typename _ValType>
+class PipelineStageOutput
+{
+public:
+	PipelineStageOutput() = default;
+
+	// LCOV_EXCL_START
+	virtual ~PipelineStageOutput() = default;
+	// LCOV_EXCL_STOP
+
+
+	virtual void SetNext(PipelineStageInput<_ValType>* next) = 0;
+
+
+}; // class PipelineStageOutput
+
+
+/**
+ * @brief The states shared by all stages of a pipeline.
+ *
+ */
+class PipelineControl
+{
+public:
+	PipelineControl(
+		Executor& executor,
+		size_t maxInFlight,
+		size_t batchSize
+	) :
+		m_executor(executor),
+		m_maxInFlight(maxInFlight),
+		m_batchSize(batchSize),
+		m_mutex(),
+		m_cv(),
+		m_inFlight(0),
+		m_activeTasks(0),
+		m_isFailed(false),
+		m_exception(),
+		m_nodes()
+	{
+		if (m_maxInFlight == 0 || m_batchSize == 0)
+		{
+			throw std::invalid_argument(
+				"The in-flight limit and batch size must be greater than 0"
+			);
+		}
+	}
+
+	// LCOV_EXCL_START
+	~PipelineControl() = default;
+	// LCOV_EXCL_STOP
+
+
+	Executor& GetExecutor()
+	{
+		return m_executor;
+	}
+
+
+	size_t GetBatchSize() const
+	{
+		return m_batchSize;
+	}
+
+
+	bool IsFailed() const
+	{
+		return m_isFailed;
+	}
+
+
+	void AddNode(std::unique_ptr<PipelineNode> node)
+	{
+		m_nodes.push_back(std::move(node));
+	}
+
+
+	void OnTaskStart()
+	{
+		++m_activeTasks;
+	}
+
+
+	void OnTaskExit()
+	{
+		// notify while holding the lock, so the pipeline can't be
+		// destroyed before this task stops touching it
+		std::lock_guard<std::mutex> lock(m_mutex);
+		--m_activeTasks;
+		m_cv.notify_all();
+	}
+
+
+	void OnItemsRetired(size_t numOfItems)
+	{
+		if (numOfItems == 0)
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_inFlight -= numOfItems;
+		m_cv.notify_all();
+	}
+
+
+	void Fail(std::exception_ptr ePtr)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!m_exception)
+			{
+				m_exception = ePtr;
+			}
+			m_isFailed = true;
+		}
+
+		for (auto& node : m_nodes)
+		{
+			node->OnPipelineFailed();
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_cv.notify_all();
+	}
+
+
+private:
+
+	template<typename _SrcType>
+	friend class Pipeline;
+
+	Executor& m_executor;
+	const size_t m_maxInFlight;
+	const size_t m_batchSize;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	size_t m_inFlight;
+	std::atomic<size_t> m_activeTasks;
+	std::atomic_bool m_isFailed;
+	std::exception_ptr m_exception;
+
+	std::vector<std::unique_ptr<PipelineNode> > m_nodes;
+
+}; // class PipelineControl
+
+
+/**
+ * @brief The input buffer and the scheduling logic of a stage.
+ *        Worker tasks are only submitted to the executor while there are
+ *        items to process and there is room downstream, and each of them
+ *        keeps taking batches until one of these is no longer true.
+ *
+ */
+template<typename _InType>
+class PipelineStageBase :
+	public PipelineNode,
+	public PipelineStageInput<_InType>
+{
+public:
+	using InItemType = PipelineItem<_InType>;
+
+
+public:
+	PipelineStageBase(
+		PipelineControl& control,
+		const PipelineStageConfig& config
+	) :
+		m_control(control),
+		m_config(config),
+		m_upstream(nullptr),
+		m_mutex(),
+		m_queue(),
+		m_orderedQueue(),
+		m_nextSeq(0),
+		m_numOfActive(0),
+		m_numOfReserved(0)
+	{}
+
+	// LCOV_EXCL_START
+	virtual ~PipelineStageBase() = default;
+	// LCOV_EXCL_STOP
+
+
+	void SetUpstream(PipelineNode* upstream)
+	{
+		m_upstream = upstream;
+	}
+
+
+	virtual bool HasRoom() const override
+	{
+		if (IsInOrder())
+		{
+			return true;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return GetRoomNonLocking() > 0;
+	}
+
+
+	virtual size_t ReserveRoom(size_t numOfItems) override
+	{
+		if (IsInOrder())
+		{
+			return numOfItems;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		size_t room = GetRoomNonLocking();
+		numOfItems = numOfItems < room ? numOfItems : room;
+		m_numOfReserved += numOfItems;
+		return numOfItems;
+	}
+
+
+	virtual void ReleaseRoom(size_t numOfItems) override
+	{
+		if (IsInOrder())
+		{
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		ReleaseRoomNonLocking(numOfItems);
+	}
+
+
+	virtual void PushBatch(std::vector<InItemType>& items) override
+	{
+		size_t numOfDropped = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (!IsInOrder())
+			{
+				ReleaseRoomNonLocking(items.size());
+			}
+
+			if (m_control.IsFailed())
+			{
+				numOfDropped = items.size();
+			}
+			else if (IsInOrder())
+			{
+				for (auto& item : items)
+				{
+					m_orderedQueue.insert(
+						std::make_pair(item.m_seq, std::move(item.m_val))
+					);
+				}
+			}
+			else
+			{
+				for (auto& item : items)
+				{
+					m_queue.push_back(std::move(item));
+				}
+			}
+		}
+		items.clear();
+
+		m_control.OnItemsRetired(numOfDropped);
+		TrySchedule();
+	}
+
+
+	virtual void OnDownstreamRoom() override
+	{
+		TrySchedule();
+	}
+
+
+	virtual void OnPipelineFailed() override
+	{
+		size_t numOfDropped = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			numOfDropped = m_queue.size() + m_orderedQueue.size();
+			m_queue.clear();
+			m_orderedQueue.clear();
+		}
+		m_control.OnItemsRetired(numOfDropped);
+	}
+
+
+protected:
+
+	virtual bool DownstreamHasRoom() const = 0;
+
+
+	virtual size_t ReserveDownstreamRoom(size_t numOfItems) = 0;
+
+
+	virtual void ReleaseDownstreamRoom(size_t numOfItems) = 0;
+
+
+	/**
+	 * @brief Process a batch of items and pass the results on.
+	 *        Every item in the batch must be either passed on or retired.
+	 *
+	 */
+	virtual void ProcessBatch(std::vector<InItemType>& batch) = 0;
+
+
+	const PipelineStageConfig& GetConfig() const
+	{
+		return m_config;
+	}
+
+
+	PipelineControl& m_control;
+
+
+private:
+
+	bool IsInOrder() const
+	{
+		return m_config.IsSerial() && m_config.IsOrdered();
+	}
+
+
+	size_t GetRoomNonLocking() const
+	{
+		size_t numOfTaken = m_queue.size() + m_numOfReserved;
+		return numOfTaken < m_config.m_bufferCapacity ?
+			m_config.m_bufferCapacity - numOfTaken : 0;
+	}
+
+
+	void ReleaseRoomNonLocking(size_t numOfItems)
+	{
+		// the reservations are shared by all upstream workers, since items
+		// of one worker may be pushed by another one in order
+		m_numOfReserved -=
+			numOfItems < m_numOfReserved ? numOfItems : m_numOfReserved;
+	}
+
+
+	size_t NumOfReadyNonLocking() const
+	{
+		if (!IsInOrder())
+		{
+			return m_queue.size();
+		}
+
+		return
+			(!m_orderedQueue.empty() &&
+				m_orderedQueue.begin()->first == m_nextSeq) ? 1 : 0;
+	}
+
+
+	bool TakeBatchNonLocking(std::vector<InItemType>& batch)
+	{
+		// only take as many items as there is room for downstream, so
+		// the results can be passed on without overfilling its buffer
+		size_t maxBatchSize = m_control.GetBatchSize();
+		if (!IsInOrder())
+		{
+			// leave some items to the other workers of this stage
+			size_t share = m_queue.size() / m_config.m_parallelism;
+			share = share > 0 ? share : 1;
+			maxBatchSize = share < maxBatchSize ? share : maxBatchSize;
+		}
+
+		size_t numOfReserved = ReserveDownstreamRoom(maxBatchSize);
+		if (numOfReserved == 0)
+		{
+			return false;
+		}
+
+		if (IsInOrder())
+		{
+			while (
+				batch.size() < numOfReserved &&
+				!m_orderedQueue.empty() &&
+				m_orderedQueue.begin()->first == m_nextSeq
+			)
+			{
+				auto it = m_orderedQueue.begin();
+				batch.emplace_back(it->first, std::move(it->second));
+				m_orderedQueue.erase(it);
+				++m_nextSeq;
+			}
+		}
+		else
+		{
+			while (batch.size() < numOfReserved && !m_queue.empty())
+			{
+				batch.push_back(std::move(m_queue.front()));
+				m_queue.pop_front();
+			}
+		}
+
+		if (batch.size() < numOfReserved)
+		{
+			ReleaseDownstreamRoom(numOfReserved - batch.size());
+		}
+		return !batch.empty();
+	}
+
+
+	void TrySchedule()
+	{
+		size_t numToStart = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			size_t numOfReady = NumOfReadyNonLocking();
+			if (numOfReady == 0 || !DownstreamHasRoom())
+			{
+				return;
+			}
+
+			while (
+				m_numOfActive < m_config.m_parallelism &&
+				numToStart < numOfReady
+			)
+			{
+				++m_numOfActive;
+				++numToStart;
+				m_control.OnTaskStart();
+			}
+		}
+
+		for (size_t i = 0; i < numToStart; ++i)
+		{
+			m_control.GetExecutor().AddTask(
+				MakeLambdaTask(
+					[this](const std::atomic_bool&)
+					{
+						RunWorker();
+					}
+				)
+			);
+		}
+	}
+
+
+	void RunWorker()
+	{
+		std::vector<InItemType> batch;
+		batch.reserve(m_control.GetBatchSize());
+
+		while (true)
+		{
+			batch.clear();
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				if (!TakeBatchNonLocking(batch))
+				{
+					--m_numOfActive;
+					break;
+				}
+			}
+
+			if (m_upstream != nullptr && !IsInOrder())
+			{
+				m_upstream->OnDownstreamRoom();
+			}
+
+			ProcessBatch(batch);
+		}
+
+		m_control.OnTaskExit();
+	}
+
+
+	const PipelineStageConfig m_config;
+	PipelineNode* m_upstream;
+
+	mutable std::mutex m_mutex;
+	std::deque<InItemType> m_queue;
+	// only used by serial ordered stages
+	std::map<uint64_t, _InType> m_orderedQueue;
+	uint64_t m_nextSeq;
+	size_t m_numOfActive;
+	// the room reserved by upstream for items not pushed yet
+	size_t m_numOfReserved;
+
+}; // class PipelineStageBase
+
+
+template<typename _InType, typename _OutType, typename _FuncType>
+class PipelineTransformStage :
+	public PipelineStageBase<_InType>,
+	public PipelineStageOutput<_OutType>
+{
+public:
+	using Base = PipelineStageBase<_InType>;
+	using InItemType = typename Base::InItemType;
+	using OutItemType = PipelineItem<_OutType>;
+
+
+public:
+	PipelineTransformStage(
+		PipelineControl& control,
+		const PipelineStageConfig& config,
+		_FuncType func
+	) :
+		Base(control, config),
+		m_func(std::move(func)),
+		m_next(nullptr),
+		m_releaseMutex(),
+		m_reorderBuffer(),
+		m_nextReleaseSeq(0)
+	{}
+
+	// LCOV_EXCL_START
+	virtual ~PipelineTransformStage() = default;
+	// LCOV_EXCL_STOP
+
+
+	virtual void SetNext(PipelineStageInput<_OutType>* next) override
+	{
+		m_next = next;
+	}
+
+
+	virtual void OnPipelineFailed() override
+	{
+		Base::OnPipelineFailed();
+
+		size_t numOfDropped = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_releaseMutex);
+			numOfDropped = m_reorderBuffer.size();
+			m_reorderBuffer.clear();
+		}
+		this->m_control.OnItemsRetired(numOfDropped);
+	}
+
+
+protected:
+
+	virtual bool DownstreamHasRoom() const override
+	{
+		return m_next->HasRoom();
+	}
+
+
+	virtual size_t ReserveDownstreamRoom(size_t numOfItems) override
+	{
+		return m_next->ReserveRoom(numOfItems);
+	}
+
+
+	virtual void ReleaseDownstreamRoom(size_t numOfItems) override
+	{
+		m_next->ReleaseRoom(numOfItems);
+	}
+
+
+	virtual void ProcessBatch(std::vector<InItemType>& batch) override
+	{
+		std::vector<OutItemType> outputs;
+		outputs.reserve(batch.size());
+
+		try
+		{
+			for (auto& item : batch)
+			{
+				if (this->m_control.IsFailed())
+				{
+					break;
+				}
+				outputs.emplace_back(item.m_seq, m_func(std::move(item.m_val)));
+			}
+		}
+		catch (...)
+		{
+			this->m_control.Fail(std::current_exception());
+		}
+
+		size_t numOfDropped = batch.size() - outputs.size();
+
+		if (this->GetConfig().IsOrdered() && !this->GetConfig().IsSerial())
+		{
+			// release results in the pipeline input order
+			std::lock_guard<std::mutex> lock(m_releaseMutex);
+
+			if (this->m_control.IsFailed())
+			{
+				numOfDropped += outputs.size();
+			}
+			else
+			{
+				for (auto& output : outputs)
+				{
+					m_reorderBuffer.insert(
+						std::make_pair(output.m_seq, std::move(output.m_val))
+					);
+				}
+
+				outputs.clear();
+				auto it = m_reorderBuffer.begin();
+				while (
+					it != m_reorderBuffer.end() &&
+					it->first == m_nextReleaseSeq
+				)
+				{
+					outputs.emplace_back(it->first, std::move(it->second));
+					it = m_reorderBuffer.erase(it);
+					++m_nextReleaseSeq;
+				}
+
+				if (!outputs.empty())
+				{
+					m_next->PushBatch(outputs);
+				}
+			}
+		}
+		else if (!outputs.empty())
+		{
+			m_next->PushBatch(outputs);
+		}
+
+		if (numOfDropped > 0)
+		{
+			m_next->ReleaseRoom(numOfDropped);
+		}
+		this->m_control.OnItemsRetired(numOfDropped);
+	}
+
+
+private:
+
+	_FuncType m_func;
+	PipelineStageInput<_OutType>* m_next;
+
+	// only used by parallel ordered stages
+	std::mutex m_releaseMutex;
+	std::map<uint64_t, _OutType> m_reorderBuffer;
+	uint64_t m_nextReleaseSeq;
+
+}; // class PipelineTransformStage
+
+
+template<typename _InType, typename _FuncType>
+class PipelineSinkStage :
+	public PipelineStageBase<_InType>
+{
+public:
+	using Base = PipelineStageBase<_InType>;
+	using InItemType = typename Base::InItemType;
+
+
+public:
+	PipelineSinkStage(
+		PipelineControl& control,
+		const PipelineStageConfig& config,
+		_FuncType func
+	) :
+		Base(control, config),
+		m_func(std::move(func))
+	{}
+
+	// LCOV_EXCL_START
+	virtual ~PipelineSinkStage() = default;
+	// LCOV_EXCL_STOP
+
+
+protected:
+
+	virtual bool DownstreamHasRoom() const override
+	{
+		return true;
+	}
+
+
+	virtual size_t ReserveDownstreamRoom(size_t numOfItems) override
+	{
+		return numOfItems;
+	}
+
+
+	virtual void ReleaseDownstreamRoom(size_t) override
+	{}
+
+
+	virtual void ProcessBatch(std::vector<InItemType>& batch) override
+	{
+		try
+		{
+			for (auto& item : batch)
+			{
+				if (this->m_control.IsFailed())
+				{
+					break;
+				}
+				m_func(std::move(item.m_val));
+			}
+		}
+		catch (...)
+		{
+			this->m_control.Fail(std::current_exception());
+		}
+
+		this->m_control.OnItemsRetired(batch.size());
+	}
+
+
+private:
+
+	_FuncType m_func;
+
+}; // class PipelineSinkStage
+
+
+/**
+ * @brief A chain of stages running on one executor, linked by bounded
+ *        buffers.
+ *        Each stage maps one input item to exactly one output item.
+ *        When a stage falls behind, its input buffer fills up, which stops
+ *        the stages in front of it, until the number of items in the
+ *        pipeline reaches the in-flight limit and `Push` stops admitting
+ *        new items.
+ *        If any stage throws, the pipeline fails: all items in it are
+ *        dropped, and the exception is rethrown by `Push` and `Wait`.
+ *
+ */
+template<typename _SrcType>
+class Pipeline :
+	public PipelineNode,
+	public PipelineStageOutput<_SrcType>
+{
+public:
+	Pipeline(
+		Executor& executor,
+		size_t maxInFlight,
+		size_t batchSize
+	) :
+		m_control(executor, maxInFlight, batchSize),
+		m_head(nullptr),
+		m_nextSeq(0)
+	{}
+
+	// LCOV_EXCL_START
+	virtual ~Pipeline()
+	{
+		std::unique_lock<std::mutex> lock(m_control.m_mutex);
+		m_control.m_cv.wait(
+			lock,
+			[this]()
+			{
+				return
+					(m_control.m_inFlight == 0) &&
+					(m_control.m_activeTasks == 0);
+			}
+		);
+	}
+	// LCOV_EXCL_STOP
+
+
+	PipelineControl& GetControl()
+	{
+		return m_control;
+	}
+
+
+	virtual void SetNext(PipelineStageInput<_SrcType>* next) override
+	{
+		m_head = next;
+	}
+
+
+	virtual void OnDownstreamRoom() override
+	{
+		std::lock_guard<std::mutex> lock(m_control.m_mutex);
+		m_control.m_cv.notify_all();
+	}
+
+
+	virtual void OnPipelineFailed() override
+	{}
+
+
+	/**
+	 * @brief Add an item to the pipeline, if the in-flight limit is not
+	 *        reached and the first stage has room for it.
+	 *
+	 * @return true if the item is taken by the pipeline; otherwise, the
+	 *         item is left untouched.
+	 */
+	bool TryPush(_SrcType&& item)
+	{
+		uint64_t seq = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_control.m_mutex);
+			ThrowIfFailedNonLocking();
+			if (!CanPushNonLocking())
+			{
+				return false;
+			}
+			seq = AdmitNonLocking();
+		}
+		PushAdmitted(seq, std::move(item));
+		return true;
+	}
+
+
+	/**
+	 * @brief Add an item to the pipeline, blocking the calling thread until
+	 *        the pipeline can take it.
+	 *        NOTE: this should not be called by a worker of the executor
+	 *        running the pipeline.
+	 *
+	 */
+	void Push(_SrcType item)
+	{
+		uint64_t seq = 0;
+		{
+			std::unique_lock<std::mutex> lock(m_control.m_mutex);
+			m_control.m_cv.wait(
+				lock,
+				[this]()
+				{
+					return m_control.m_isFailed || CanPushNonLocking();
+				}
+			);
+			ThrowIfFailedNonLocking();
+			seq = AdmitNonLocking();
+		}
+		PushAdmitted(seq, std::move(item));
+	}
+
+
+	/**
+	 * @brief Block the calling thread until all items pushed so far have
+	 *        left the pipeline.
+	 *
+	 */
+	void Wait()
+	{
+		std::unique_lock<std::mutex> lock(m_control.m_mutex);
+		m_control.m_cv.wait(
+			lock,
+			[this]()
+			{
+				return m_control.m_inFlight == 0;
+			}
+		);
+		ThrowIfFailedNonLocking();
+	}
+
+
+	size_t GetInFlightCount() const
+	{
+		std::lock_guard<std::mutex> lock(m_control.m_mutex);
+		return m_control.m_inFlight;
+	}
+
+
+private:
+
+	bool CanPushNonLocking() const
+	{
+		return
+			(m_control.m_inFlight < m_control.m_maxInFlight) &&
+			m_head->HasRoom();
+	}
+
+
+	void ThrowIfFailedNonLocking() const
+	{
+		if (m_control.m_exception)
+		{
+			std::rethrow_exception(m_control.m_exception);
+		}
+	}
+
+
+	/**
+	 * @brief Count an item in, and reserve its room in the first stage;
+	 *        as only the pipeline pushes to that stage, and it does so
+	 *        while holding the lock, there is room after `HasRoom`.
+	 *
+	 * @return The sequence number of the item.
+	 */
+	uint64_t AdmitNonLocking()
+	{
+		m_head->ReserveRoom(1);
+		++m_control.m_inFlight;
+		return m_nextSeq++;
+	}
+
+
+	/**
+	 * @brief Push an admitted item, without holding the lock, since the
+	 *        first stage may submit a task to the executor, which may run
+	 *        it right away in the calling thread.
+	 *
+	 */
+	void PushAdmitted(uint64_t seq, _SrcType&& item)
+	{
+		std::vector<PipelineItem<_SrcType> > batch;
+		batch.emplace_back(seq, std::move(item));
+		m_head->PushBatch(batch);
+	}
+
+
+	mutable PipelineControl m_control;
+	PipelineStageInput<_SrcType>* m_head;
+	uint64_t m_nextSeq;
+
+}; // class Pipeline
+
+
+template<typename _SrcType, typename _CurrType>
+class PipelineBuilder
+{
+public:
+	PipelineBuilder(
+		std::unique_ptr<Pipeline<_SrcType> > pipeline,
+		PipelineStageOutput<_CurrType>* tail,
+		PipelineNode* tailNode
+	) :
+		m_pipeline(std::move(pipeline)),
+		m_tail(tail),
+		m_tailNode(tailNode)
+	{}
+
+
+	/**
+	 * @brief Append a stage that maps each `_CurrType` item to an
+	 *        `_OutType` item by calling `func`.
+	 *
+	 */
+	template<typename _OutType, typename _FuncType>
+	PipelineBuilder<_SrcType, _OutType> AddStage(
+		const PipelineStageConfig& config,
+		_FuncType func
+	)
+	{
+		using _StageType =
+			PipelineTransformStage<_CurrType, _OutType, _FuncType>;
+
+		std::unique_ptr<_StageType> stage(
+			new _StageType(m_pipeline->GetControl(), config, std::move(func))
+		);
+		_StageType* stagePtr = stage.get();
+		Link(stagePtr);
+		m_pipeline->GetControl().AddNode(std::move(stage));
+
+		return PipelineBuilder<_SrcType, _OutType>(
+			std::move(m_pipeline),
+			stagePtr,
+			stagePtr
+		);
+	}
+
+
+	/**
+	 * @brief Append the last stage, which consumes each item by calling
+	 *        `func`, and finish building the pipeline.
+	 *        NOTE: a parallel sink stage can't be ordered, since the items
+	 *        don't leave it.
+	 *
+	 */
+	template<typename _FuncType>
+	std::unique_ptr<Pipeline<_SrcType> > AddSink(
+		const PipelineStageConfig& config,
+		_FuncType func
+	)
+	{
+		using _StageType = PipelineSinkStage<_CurrType, _FuncType>;
+
+		std::unique_ptr<_StageType> stage(
+			new _StageType(m_pipeline->GetControl(), config, std::move(func))
+		);
+		Link(stage.get());
+		m_pipeline->GetControl().AddNode(std::move(stage));
+
+		return std::move(m_pipeline);
+	}
+
+
+private:
+
+	void Link(PipelineStageBase<_CurrType>* stage)
+	{
+		m_tail->SetNext(stage);
+		stage->SetUpstream(m_tailNode);
+	}
+
+
+	std::unique_ptr<Pipeline<_SrcType> > m_pipeline;
+	PipelineStageOutput<_CurrType>* m_tail;
+	PipelineNode* m_tailNode;
+
+}; // class PipelineBuilder
+
+
+/**
+ * @brief Start building a pipeline taking `_SrcType` items, whose stages
+ *        run on `executor`.
+ *
+ * @param maxInFlight The max number of items in the pipeline at once.
+ * @param batchSize   The max number of items a stage processes at once.
+ */
+template<typename _SrcType>
+PipelineBuilder<_SrcType, _SrcType> MakePipelineBuilder(
+	Executor& executor,
+	size_t maxInFlight,
+	size_t batchSize
+)
+{
+	std::unique_ptr<Pipeline<_SrcType> > pipeline(
+		new Pipeline<_SrcType>(executor, maxInFlight, batchSize)
+	);
+	Pipeline<_SrcType>* pipelinePtr = pipeline.get();
+
+	return PipelineBuilder<_SrcType, _SrcType>(
+		std::move(pipeline),
+		pipelinePtr,
+		pipelinePtr
+	);
+}
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,328 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+#include "CacheLine.hpp"
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief The statistics of one type of tasks, reported by
+ *        `ProfilingStatsPolicy`.
+ *
+ */
+struct TaskTypeProfile
+{
+	/**
+	 * @brief The tag of the tasks, or the name of their type given by
+	 *        `std::type_info::name` if they have no tag.
+	 *
+	 */
+	std::string m_name;
+
+	uint64_t m_numOfRuns;
+	uint64_t m_numOfExceptions;
+	std::chrono::nanoseconds m_runTime;
+	std::chrono::nanoseconds m_queueTime;
+}; // struct TaskTypeProfile
+
+
+/**
+ * @brief The statistics policy of `BasicThreadPool` that attributes the
+ *        run time, queue time, and the numbers of runs and exceptions to
+ *        each type of tasks.
+ *        Tasks are grouped by their tags (see `Task::SetTag`), or by their
+ *        dynamic types if they have no tag; since `MakeLambdaTask` creates
+ *        a type for each lambda, every lambda task is accounted for
+ *        separately.
+ *        The types are kept in a lock-free hash table of a fixed capacity,
+ *        and the counters are updated with relaxed atomics, so workers do
+ *        not contend on a lock; types beyond the capacity are accounted
+ *        for together as "(other)".
+ *
+ * @tparam _MaxNumOfTypes The capacity of the table; must be a power of two.
+ */
+template<size_t _MaxNumOfTypes = 256>
+class ProfilingStatsPolicy
+{
+public: // static members:
+
+	static_assert(
+		_MaxNumOfTypes >= 1 && (_MaxNumOfTypes & (_MaxNumOfTypes - 1)) == 0,
+		"The max number of types must be a power of two"
+	);
+
+	static constexpr size_t sk_maxNumOfTypes = _MaxNumOfTypes;
+
+	static constexpr bool sk_isTimingTasks = true;
+
+	static constexpr bool sk_isTrackingRunningTasks = true;
+
+
+public:
+	ProfilingStatsPolicy() :
+		m_entries(new EntryTable()),
+		m_otherEntry()
+	{
+		m_otherEntry.m_name = "(other)";
+	}
+
+
+protected:
+
+	~ProfilingStatsPolicy() = default;
+
+
+public:
+
+
+	/**
+	 * @brief Get the profiles of all task types run so far.
+	 *
+	 */
+	std::vector<TaskTypeProfile> GetTaskTypeProfiles() const
+	{
+		std::vector<TaskTypeProfile> profiles;
+		for (size_t i = 0; i < sk_maxNumOfTypes; ++i)
+		{
+			AppendProfile(m_entries->m_entries[i].m_value, profiles);
+		}
+		AppendProfile(m_otherEntry, profiles);
+		return profiles;
+	}
+
+
+	/**
+	 * @brief Get the profiles of the task types that have used the most
+	 *        run time, in descending order.
+	 *
+	 */
+	std::vector<TaskTypeProfile> GetTopTaskTypes(size_t maxNum) const
+	{
+		std::vector<TaskTypeProfile> profiles = GetTaskTypeProfiles();
+		auto byRunTime =
+			[](const TaskTypeProfile& a, const TaskTypeProfile& b)
+			{
+				return a.m_runTime > b.m_runTime;
+			};
+
+		if (profiles.size() > maxNum)
+		{
+			std::partial_sort(
+				profiles.begin(),
+				profiles.begin() + maxNum,
+				profiles.end(),
+				byRunTime
+			);
+			profiles.resize(maxNum);
+		}
+		else
+		{
+			std::sort(profiles.begin(), profiles.end(), byRunTime);
+		}
+		return profiles;
+	}
+
+
+private: // private types:
+
+
+	struct Entry
+	{
+		Entry() :
+			m_key(nullptr),
+			m_name(nullptr),
+			m_numOfRuns(0),
+			m_numOfExceptions(0),
+			m_runTimeNs(0),
+			m_queueTimeNs(0)
+		{}
+
+		std::atomic<const void*> m_key;
+		// set right after the key is claimed
+		std::atomic<const char*> m_name;
+
+		std::atomic<uint64_t> m_numOfRuns;
+		std::atomic<uint64_t> m_numOfExceptions;
+		std::atomic<uint64_t> m_runTimeNs;
+		std::atomic<uint64_t> m_queueTimeNs;
+	}; // struct Entry
+
+
+	// each entry on cache lines of its own, as the workers running
+	// different types of tasks update them at the same time
+	struct EntryTable :
+		public CacheLineAligned
+	{
+		CacheLinePadded<Entry> m_entries[sk_maxNumOfTypes];
+	}; // struct EntryTable
+
+
+protected: // types:
+
+
+	struct RunContext
+	{
+		RunContext() :
+			m_beginTime(),
+			m_entry(nullptr)
+		{}
+
+		Task::TimePoint m_beginTime;
+		Entry* m_entry;
+	}; // struct RunContext
+
+
+protected:
+
+
+	void OnTaskAdded(const Task&)
+	{}
+
+
+	RunContext OnTaskRunBegin(const Task& task)
+	{
+		RunContext context;
+		context.m_entry = &FindEntry(task);
+		context.m_beginTime = Task::Clock::now();
+
+		AddNs(
+			context.m_entry->m_queueTimeNs,
+			context.m_beginTime - task.GetEnqueueTime()
+		);
+		return context;
+	}
+
+
+	void OnTaskRunEnd(const Task&, const RunContext& context, bool hasThrown)
+	{
+		Entry& entry = *(context.m_entry);
+		AddNs(entry.m_runTimeNs, Task::Clock::now() - context.m_beginTime);
+		entry.m_numOfRuns.fetch_add(1, std::memory_order_relaxed);
+		if (hasThrown)
+		{
+			entry.m_numOfExceptions.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+
+
+private: // private functions:
+
+
+	static void AddNs(std::atomic<uint64_t>& counter, Task::Clock::duration time)
+	{
+		int64_t timeNs =
+			std::chrono::duration_cast<std::chrono::nanoseconds>(time).count();
+		if (timeNs > 0)
+		{
+			counter.fetch_add(
+				static_cast<uint64_t>(timeNs), std::memory_order_relaxed
+			);
+		}
+	}
+
+
+	static void AppendProfile(
+		const Entry& entry,
+		std::vector<TaskTypeProfile>& profiles
+	)
+	{
+		const char* name = entry.m_name.load();
+		uint64_t numOfRuns = entry.m_numOfRuns.load();
+		if (name == nullptr || numOfRuns == 0)
+		{
+			return;
+		}
+
+		TaskTypeProfile profile;
+		profile.m_name = name;
+		profile.m_numOfRuns = numOfRuns;
+		profile.m_numOfExceptions = entry.m_numOfExceptions.load();
+		profile.m_runTime = std::chrono::nanoseconds(entry.m_runTimeNs.load());
+		profile.m_queueTime =
+			std::chrono::nanoseconds(entry.m_queueTimeNs.load());
+		profiles.push_back(profile);
+	}
+
+
+	Entry& FindEntry(const Task& task)
+	{
+		const char* tag = task.GetTag();
+		const void* key = tag;
+		const char* name = tag;
+		if (tag == nullptr)
+		{
+			// `type_info` objects live as long as the program
+			const std::type_info& type = typeid(task);
+			key = &type;
+			name = type.name();
+		}
+
+		// open addressing with linear probing; entries are never removed
+		uintptr_t hash = reinterpret_cast<uintptr_t>(key);
+		hash = (hash >> 4) * static_cast<uintptr_t>(0x9E3779B97F4A7C15ULL);
+		size_t idx = static_cast<size_t>(hash >> 16) & (sk_maxNumOfTypes - 1);
+		for (size_t i = 0; i < sk_maxNumOfTypes; ++i)
+		{
+			Entry& entry =
+				m_entries->m_entries[(idx + i) & (sk_maxNumOfTypes - 1)].m_value;
+			const void* entryKey = entry.m_key.load(std::memory_order_acquire);
+			if (entryKey == key)
+			{
+				return entry;
+			}
+			else if (entryKey == nullptr)
+			{
+				if (entry.m_key.compare_exchange_strong(entryKey, key))
+				{
+					entry.m_name = name;
+					return entry;
+				}
+				else if (entryKey == key)
+				{
+					// claimed by another thread for the same type
+					return entry;
+				}
+			}
+		}
+
+		// the table is full
+		return m_otherEntry;
+	}
+
+
+private:
+
+	std::unique_ptr<EntryTable> m_entries;
+	Entry m_otherEntry;
+
+}; // class ProfilingStatsPolicy
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,325 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "CacheLine.hpp"
+#include "IntrusiveTaskQueue.hpp"
+#include "SyncPrimitives.hpp"
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief The queue policy of `BasicThreadPool`; the pending tasks are kept
+ *        in an intrusive queue guarded by a mutex, so that queuing a task
+ *        doesn't allocate.
+ *        A queue policy is thread-safe, and provides:
+ *        - `Push(task)`
+ *        - `TryPop(task)`, which moves the front task into `task`, and
+ *          returns whether there was one
+ *        - `TryPopBatch(maxNum, func)`, which pops up to `maxNum` tasks,
+ *          passes them to `func` one by one, and returns the number popped
+ *        - `Size()`
+ *
+ */
+class LockedQueuePolicy
+{
+public:
+	LockedQueuePolicy() :
+		m_mutex(),
+		m_tasks(),
+		m_size(0)
+	{}
+
+
+	void Push(std::unique_ptr<Task> task)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+		m_tasks.PushBack(std::move(task));
+		++m_size;
+	}
+
+
+	bool TryPop(std::unique_ptr<Task>& task)
+	{
+		return TryPopBatch(
+			1,
+			[&task](std::unique_ptr<Task> poppedTask)
+			{
+				task = std::move(poppedTask);
+			}
+		) > 0;
+	}
+
+
+	template<typename _FuncType>
+	size_t TryPopBatch(size_t maxNum, _FuncType func)
+	{
+		if (m_size == 0)
+		{
+			return 0;
+		}
+
+		std::lock_guard<Mutex> lock(m_mutex);
+		size_t num = m_tasks.Size() < maxNum ? m_tasks.Size() : maxNum;
+		for (size_t i = 0; i < num; ++i)
+		{
+			func(m_tasks.PopFront());
+		}
+		m_size -= num;
+		return num;
+	}
+
+
+	size_t Size() const
+	{
+		return m_size;
+	}
+
+
+private:
+
+	Mutex m_mutex;
+	IntrusiveTaskQueue m_tasks;
+	std::atomic<size_t> m_size;
+
+}; // class LockedQueuePolicy
+
+
+/**
+ * @brief The queue policy of `BasicThreadPool` where the pending tasks are
+ *        kept in a bounded lock-free ring buffer (a Vyukov MPMC queue), so
+ *        that pushing and popping do not take a lock.
+ *        When the ring is full, the tasks overflow into an intrusive queue
+ *        guarded by a mutex, and keep going there until it is drained, so that the
+ *        tasks are still mostly in FIFO order.
+ *
+ * @tparam _Capacity The capacity of the ring; must be a power of two.
+ */
+template<size_t _Capacity = 1024>
+class LockFreeQueuePolicy :
+	public CacheLineAligned
+{
+public: // static members:
+
+	static_assert(
+		_Capacity >= 2 && (_Capacity & (_Capacity - 1)) == 0,
+		"The capacity must be a power of two"
+	);
+
+	static constexpr size_t sk_capacity = _Capacity;
+
+
+public:
+	LockFreeQueuePolicy() :
+		m_cells(new Cell[sk_capacity]),
+		m_pushPos(0),
+		m_popPos(0),
+		m_size(0),
+		m_overflowMutex(),
+		m_overflowTasks(),
+		m_overflowSize(0)
+	{
+		for (size_t i = 0; i < sk_capacity; ++i)
+		{
+			m_cells[i].m_seq.store(i, std::memory_order_relaxed);
+			m_cells[i].m_task = nullptr;
+		}
+	}
+
+
+	LockFreeQueuePolicy(const LockFreeQueuePolicy&) = delete;
+
+	LockFreeQueuePolicy& operator=(const LockFreeQueuePolicy&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~LockFreeQueuePolicy()
+	{
+		std::unique_ptr<Task> task;
+		while (TryPopFromRing(task))
+		{
+			task.reset();
+		}
+	}
+	// LCOV_EXCL_STOP
+
+
+	void Push(std::unique_ptr<Task> task)
+	{
+		++m_size;
+		if (m_overflowSize > 0 || !TryPushToRing(task))
+		{
+			std::lock_guard<Mutex> lock(m_overflowMutex);
+			m_overflowTasks.PushBack(std::move(task));
+			++m_overflowSize;
+		}
+	}
+
+
+	bool TryPop(std::unique_ptr<Task>& task)
+	{
+		if (m_size == 0)
+		{
+			return false;
+		}
+
+		if (TryPopFromRing(task))
+		{
+			--m_size;
+			return true;
+		}
+
+		if (m_overflowSize > 0)
+		{
+			std::lock_guard<Mutex> lock(m_overflowMutex);
+			if (!m_overflowTasks.IsEmpty())
+			{
+				task = m_overflowTasks.PopFront();
+				--m_overflowSize;
+				--m_size;
+				return true;
+			}
+		}
+		return false;
+	}
+
+
+	template<typename _FuncType>
+	size_t TryPopBatch(size_t maxNum, _FuncType func)
+	{
+		size_t num = 0;
+		std::unique_ptr<Task> task;
+		while (num < maxNum && TryPop(task))
+		{
+			func(std::move(task));
+			++num;
+		}
+		return num;
+	}
+
+
+	size_t Size() const
+	{
+		return m_size;
+	}
+
+
+private: // private types:
+
+
+	struct Cell
+	{
+		std::atomic<size_t> m_seq;
+		Task* m_task;
+	}; // struct Cell
+
+
+private: // private functions:
+
+
+	bool TryPushToRing(std::unique_ptr<Task>& task)
+	{
+		size_t pos = m_pushPos.m_value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = m_cells[pos & (sk_capacity - 1)];
+			size_t seq = cell.m_seq.load(std::memory_order_acquire);
+			intptr_t diff =
+				static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (m_pushPos.m_value.compare_exchange_weak(
+					pos, pos + 1, std::memory_order_relaxed
+				))
+				{
+					cell.m_task = task.release();
+					cell.m_seq.store(pos + 1, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// the ring is full
+				return false;
+			}
+			else
+			{
+				pos = m_pushPos.m_value.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+
+	bool TryPopFromRing(std::unique_ptr<Task>& task)
+	{
+		size_t pos = m_popPos.m_value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			Cell& cell = m_cells[pos & (sk_capacity - 1)];
+			size_t seq = cell.m_seq.load(std::memory_order_acquire);
+			intptr_t diff =
+				static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_popPos.m_value.compare_exchange_weak(
+					pos, pos + 1, std::memory_order_relaxed
+				))
+				{
+					task.reset(cell.m_task);
+					cell.m_task = nullptr;
+					cell.m_seq.store(
+						pos + sk_capacity, std::memory_order_release
+					);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// the ring is empty
+				return false;
+			}
+			else
+			{
+				pos = m_popPos.m_value.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+
+private:
+
+	std::unique_ptr<Cell[]> m_cells;
+	CacheLinePadded<std::atomic<size_t> > m_pushPos;
+	CacheLinePadded<std::atomic<size_t> > m_popPos;
+	std::atomic<size_t> m_size;
+
+	Mutex m_overflowMutex;
+	IntrusiveTaskQueue m_overflowTasks;
+	std::atomic<size_t> m_overflowSize;
+
+}; // class LockFreeQueuePolicy
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,301 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "Executor.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief An executor that passes tasks on to another executor (e.g., a
+ *        `ThreadPool`) no faster than a given rate, e.g., for tasks
+ *        calling a service that is capped at a number of requests per
+ *        second.
+ *        It keeps a token bucket, which fills up at the given rate and
+ *        holds up to the burst size; each task takes a token. Tasks
+ *        without tokens wait in its own queue, in FIFO order, rather than
+ *        in a worker, so no worker ever sleeps for throttling; a thread of
+ *        its own, started on first use, releases them as tokens come.
+ *
+ */
+class RateLimitedExecutor :
+	public Executor
+{
+public:
+
+	/**
+	 * @param executor The executor to run the tasks.
+	 * @param ratePerSecond The number of tasks released per second.
+	 * @param burstSize The max number of tokens saved up, i.e., the max
+	 *                  number of tasks released at once.
+	 */
+	RateLimitedExecutor(
+		Executor& executor,
+		double ratePerSecond,
+		size_t burstSize
+	) :
+		m_executor(executor),
+		m_ratePerSecond(ratePerSecond),
+		m_burstSize(static_cast<double>(burstSize)),
+		m_mutex(),
+		m_cv(),
+		m_pendingTasks(),
+		m_numOfTokens(static_cast<double>(burstSize)),
+		m_lastRefillTime(Clock::now()),
+		m_isReleasing(false),
+		m_releaseThread(),
+		m_isReleaseThreadStarted(false),
+		m_isTerminated(false),
+		m_terminateOnce()
+	{
+		if (!(ratePerSecond > 0.0) || burstSize == 0)
+		{
+			throw std::invalid_argument(
+				"The rate and the burst size must be greater than 0"
+			);
+		}
+	}
+
+
+	RateLimitedExecutor(const RateLimitedExecutor&) = delete;
+
+	RateLimitedExecutor& operator=(const RateLimitedExecutor&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~RateLimitedExecutor()
+	{
+		Terminate();
+	}
+	// LCOV_EXCL_STOP
+
+
+	virtual void AddTask(std::unique_ptr<Task> task) override
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		if (m_isTerminated)
+		{
+			// the same as a terminated `ThreadPool`, the task never runs
+			return;
+		}
+
+		m_pendingTasks.push_back(std::move(task));
+		ReleaseTasks(lock);
+
+		if (!m_pendingTasks.empty() && !m_isTerminated)
+		{
+			if (!m_isReleaseThreadStarted)
+			{
+				m_releaseThread = std::thread(
+					[this]()
+					{
+						ReleaseThreadRunner();
+					}
+				);
+				m_isReleaseThreadStarted = true;
+			}
+			m_cv.notify_one();
+		}
+	}
+
+
+	/**
+	 * @brief Get the number of tasks waiting for tokens.
+	 *
+	 */
+	size_t GetNumOfPendingTasks() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_pendingTasks.size();
+	}
+
+
+	/**
+	 * @brief Stop releasing tasks; the tasks still waiting for tokens are
+	 *        dropped, and the tasks added afterwards never run.
+	 *        It can be called by many threads at once; each returns once
+	 *        the release thread is gone.
+	 *
+	 */
+	void Terminate()
+	{
+		std::call_once(
+			m_terminateOnce,
+			[this]()
+			{
+				std::deque<std::unique_ptr<Task> > droppedTasks;
+				{
+					std::lock_guard<std::mutex> lock(m_mutex);
+					m_isTerminated = true;
+					droppedTasks.swap(m_pendingTasks);
+				}
+				m_cv.notify_all();
+
+				if (m_releaseThread.joinable())
+				{
+					m_releaseThread.join();
+				}
+			}
+		);
+	}
+
+
+private: // private types:
+
+	using Clock = std::chrono::steady_clock;
+
+
+private: // private functions:
+
+
+	void RefillNonLocking(Clock::time_point now)
+	{
+		std::chrono::duration<double> elapsed = now - m_lastRefillTime;
+		m_lastRefillTime = now;
+
+		m_numOfTokens += elapsed.count() * m_ratePerSecond;
+		if (m_numOfTokens > m_burstSize)
+		{
+			m_numOfTokens = m_burstSize;
+		}
+	}
+
+
+	/**
+	 * @brief Release the tasks there are tokens for; they are taken out
+	 *        under the lock, and passed on without it, so the lock is not
+	 *        held while the other executor takes them.
+	 *        Only one thread releases at a time, so they stay in order;
+	 *        the others leave their tasks to it.
+	 *
+	 */
+	void ReleaseTasks(std::unique_lock<std::mutex>& lock)
+	{
+		if (m_isReleasing)
+		{
+			return;
+		}
+		m_isReleasing = true;
+
+		std::vector<std::unique_ptr<Task> > tasks;
+		while (true)
+		{
+			RefillNonLocking(Clock::now());
+			while (
+				!m_isTerminated &&
+				!m_pendingTasks.empty() &&
+				m_numOfTokens >= 1.0
+			)
+			{
+				m_numOfTokens -= 1.0;
+				tasks.push_back(std::move(m_pendingTasks.front()));
+				m_pendingTasks.pop_front();
+			}
+			if (tasks.empty())
+			{
+				break;
+			}
+
+			lock.unlock();
+			try
+			{
+				for (std::unique_ptr<Task>& task : tasks)
+				{
+					m_executor.AddTask(std::move(task));
+				}
+			}
+			catch(...)
+			{
+				lock.lock();
+				m_isReleasing = false;
+				throw;
+			}
+			tasks.clear();
+			lock.lock();
+		}
+
+		m_isReleasing = false;
+		if (!m_pendingTasks.empty())
+		{
+			// the release thread may have left them to this one
+			m_cv.notify_all();
+		}
+	}
+
+
+	void ReleaseThreadRunner()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_isTerminated)
+		{
+			if (m_pendingTasks.empty() || m_isReleasing)
+			{
+				m_cv.wait(lock);
+				continue;
+			}
+
+			// wait until the next token is due
+			std::chrono::duration<double> timeToToken(
+				(1.0 - m_numOfTokens) / m_ratePerSecond
+			);
+			m_cv.wait_until(
+				lock,
+				m_lastRefillTime +
+					std::chrono::duration_cast<Clock::duration>(timeToToken)
+			);
+
+			if (!m_isTerminated)
+			{
+				ReleaseTasks(lock);
+			}
+		}
+	}
+
+
+private:
+
+	Executor& m_executor;
+	double m_ratePerSecond;
+	double m_burstSize;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_cv;
+	std::deque<std::unique_ptr<Task> > m_pendingTasks;
+	double m_numOfTokens;
+	Clock::time_point m_lastRefillTime;
+	bool m_isReleasing;
+
+	std::thread m_releaseThread;
+	bool m_isReleaseThreadStarted;
+	bool m_isTerminated;
+	std::once_flag m_terminateOnce;
+
+}; // class RateLimitedExecutor
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
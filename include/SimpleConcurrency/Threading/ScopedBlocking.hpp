@@ -0,0 +1,77 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include "ThreadPoolBase.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief Declare that the current task is about to block, e.g., on I/O or
+ *        on a lock held outside the pool, for the lifetime of this object.
+ *        While it is held, the pool of the calling worker may run a
+ *        compensating worker beyond its pool size, so the pending tasks
+ *        are not stalled; the extra worker is retired afterwards.
+ *        It does nothing when the calling thread is not a pool worker,
+ *        and nested markers in the same thread count once.
+ *
+ */
+class ScopedBlocking
+{
+public:
+	ScopedBlocking() :
+		m_pool(BlockingDepth()++ == 0 ? ThreadPoolBase::GetCurrent() : nullptr)
+	{
+		if (m_pool != nullptr)
+		{
+			m_pool->BeginBlocking();
+		}
+	}
+
+	ScopedBlocking(const ScopedBlocking&) = delete;
+
+	ScopedBlocking& operator=(const ScopedBlocking&) = delete;
+
+	// LCOV_EXCL_START
+	~ScopedBlocking()
+	{
+		if (m_pool != nullptr)
+		{
+			m_pool->EndBlocking();
+		}
+		--BlockingDepth();
+	}
+	// LCOV_EXCL_STOP
+
+
+private:
+
+	static size_t& BlockingDepth()
+	{
+		static thread_local size_t s_depth = 0;
+		return s_depth;
+	}
+
+
+	ThreadPoolBase* m_pool;
+
+}; // class ScopedBlocking
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,314 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <memory>
+#include <new>
+#include <vector>
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A bump-pointer allocator for short-lived allocations;
+ *        nothing is freed one by one, instead the whole arena is reset at
+ *        once, and its memory blocks are kept for reuse.
+ *        It is not thread-safe; each worker of a pool has its own
+ *        (see `ThreadPool::GetCurrentScratchArena`).
+ *
+ */
+class ScratchArena
+{
+public: // static members:
+
+	static constexpr size_t sk_defaultBlockSize = 64 * 1024;
+
+
+public: // types:
+
+	/**
+	 * @brief A position in the arena, to rewind to later.
+	 *
+	 */
+	struct Marker
+	{
+		size_t m_blockIdx;
+		size_t m_offset;
+	}; // struct Marker
+
+
+public:
+
+	ScratchArena(size_t blockSize = sk_defaultBlockSize) :
+		m_blockSize(blockSize > 0 ? blockSize : 1),
+		m_blocks(),
+		m_blockIdx(0),
+		m_offset(0)
+	{}
+
+
+	ScratchArena(const ScratchArena&) = delete;
+
+	ScratchArena& operator=(const ScratchArena&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~ScratchArena() = default;
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Allocate `size` bytes aligned to `alignment`, which must be a
+	 *        power of two; the memory stays valid until the arena is reset
+	 *        or rewound past it.
+	 *
+	 */
+	void* Allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+	{
+		// block memory is only aligned to `std::max_align_t`, so a block
+		// for a larger alignment needs room to align its start
+		size_t padding = alignment > alignof(std::max_align_t) ?
+			alignment - 1 : 0;
+
+		while (m_blockIdx < m_blocks.size())
+		{
+			Block& block = m_blocks[m_blockIdx];
+			size_t offset = AlignUp(block.m_data.get(), m_offset, alignment);
+			if (offset <= block.m_size && size <= block.m_size - offset)
+			{
+				m_offset = offset + size;
+				return block.m_data.get() + offset;
+			}
+
+			// try the next block
+			++m_blockIdx;
+			m_offset = 0;
+
+			if (
+				m_blockIdx < m_blocks.size() &&
+				m_blocks[m_blockIdx].m_size < size + padding
+			)
+			{
+				// the next one is too small; put a large enough one before it
+				break;
+			}
+		}
+
+		size_t blockSize = size + padding;
+		blockSize = blockSize > m_blockSize ? blockSize : m_blockSize;
+		m_blocks.insert(m_blocks.begin() + m_blockIdx, Block(blockSize));
+		char* data = m_blocks[m_blockIdx].m_data.get();
+		size_t offset = AlignUp(data, 0, alignment);
+		m_offset = offset + size;
+		return data + offset;
+	}
+
+
+	/**
+	 * @brief Get a marker of the current position.
+	 *
+	 */
+	Marker GetMarker() const
+	{
+		Marker marker;
+		marker.m_blockIdx = m_blockIdx;
+		marker.m_offset = m_offset;
+		return marker;
+	}
+
+
+	/**
+	 * @brief Free everything allocated after `marker` was taken.
+	 *
+	 */
+	void RewindTo(const Marker& marker)
+	{
+		m_blockIdx = marker.m_blockIdx;
+		m_offset = marker.m_offset;
+	}
+
+
+	/**
+	 * @brief Free everything, and keep the memory blocks for reuse.
+	 *
+	 */
+	void Reset()
+	{
+		m_blockIdx = 0;
+		m_offset = 0;
+	}
+
+
+	/**
+	 * @brief Free everything, including the memory blocks.
+	 *
+	 */
+	void Release()
+	{
+		m_blocks.clear();
+		Reset();
+	}
+
+
+	/**
+	 * @brief Get the number of bytes in use, including alignment padding,
+	 *        and the unused tails of the blocks skipped over.
+	 *
+	 */
+	size_t GetNumOfBytesUsed() const
+	{
+		size_t used = 0;
+		for (size_t i = 0; i < m_blockIdx && i < m_blocks.size(); ++i)
+		{
+			used += m_blocks[i].m_size;
+		}
+		return used + m_offset;
+	}
+
+
+	/**
+	 * @brief Get the number of bytes in all memory blocks.
+	 *
+	 */
+	size_t GetCapacity() const
+	{
+		size_t capacity = 0;
+		for (const Block& block : m_blocks)
+		{
+			capacity += block.m_size;
+		}
+		return capacity;
+	}
+
+
+private: // private types:
+
+
+	struct Block
+	{
+		Block(size_t size) :
+			m_data(new char[size]),
+			m_size(size)
+		{}
+
+		std::unique_ptr<char[]> m_data;
+		size_t m_size;
+	}; // struct Block
+
+
+private: // private functions:
+
+
+	static size_t AlignUp(const char* base, size_t offset, size_t alignment)
+	{
+		uintptr_t addr = reinterpret_cast<uintptr_t>(base) + offset;
+		uintptr_t aligned = (addr + alignment - 1) & ~(uintptr_t(alignment) - 1);
+		return offset + static_cast<size_t>(aligned - addr);
+	}
+
+
+private:
+
+	size_t m_blockSize;
+	std::vector<Block> m_blocks;
+	size_t m_blockIdx;
+	size_t m_offset;
+
+}; // class ScratchArena
+
+
+/**
+ * @brief A standard allocator adapter for `ScratchArena`, so containers
+ *        can allocate from it; deallocating does nothing, the memory is
+ *        freed when the arena is reset.
+ *
+ */
+template<typename _ValType>
+class ArenaAllocator
+{
+public: // types:
+
+	using value_type = _ValType;
+
+	template<typename _OtherType>
+	struct rebind
+	{
+		using other = ArenaAllocator<_OtherType>;
+	}; // struct rebind
+
+
+public:
+
+	ArenaAllocator(ScratchArena& arena) noexcept :
+		m_arena(&arena)
+	{}
+
+
+	template<typename _OtherType>
+	ArenaAllocator(const ArenaAllocator<_OtherType>& other) noexcept :
+		m_arena(other.GetArena())
+	{}
+
+
+	_ValType* allocate(size_t n)
+	{
+		return static_cast<_ValType*>(
+			m_arena->Allocate(n * sizeof(_ValType), alignof(_ValType))
+		);
+	}
+
+
+	void deallocate(_ValType*, size_t) noexcept
+	{}
+
+
+	ScratchArena* GetArena() const noexcept
+	{
+		return m_arena;
+	}
+
+
+private:
+
+	ScratchArena* m_arena;
+
+}; // class ArenaAllocator
+
+
+template<typename _ValTypeA, typename _ValTypeB>
+bool operator==(
+	const ArenaAllocator<_ValTypeA>& a,
+	const ArenaAllocator<_ValTypeB>& b
+) noexcept
+{
+	return a.GetArena() == b.GetArena();
+}
+
+
+template<typename _ValTypeA, typename _ValTypeB>
+bool operator!=(
+	const ArenaAllocator<_ValTypeA>& a,
+	const ArenaAllocator<_ValTypeB>& b
+) noexcept
+{
+	return !(a == b);
+}
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
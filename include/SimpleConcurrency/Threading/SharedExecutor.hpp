@@ -0,0 +1,936 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Executor.hpp"
+#include "Task.hpp"
+#include "ThreadPool.hpp"
+#include "ThreadPoolBase.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief The state of a logical pool attached to a shared executor.
+ *        Everything except the finished tasks is guarded by the mutex of
+ *        the shared executor.
+ *
+ */
+struct SharedExecutorTenant
+{
+	struct RunningTask
+	{
+		Task* m_task;
+		std::thread::id m_threadId;
+		uint64_t m_runIndex;
+		Task::TimePoint m_beginTime;
+	}; // struct RunningTask
+
+	SharedExecutorTenant(
+		ThreadPoolBase& pool,
+		size_t maxConcurrency,
+		size_t weight
+	) :
+		m_pool(pool),
+		m_maxConcurrency(maxConcurrency),
+		m_weight(weight),
+		m_numOfBlocking(0),
+		m_pass(0.0),
+		m_isDetaching(false),
+		m_pendingTasks(),
+		m_pendingTasksSize(0),
+		m_runningTasks(),
+		m_runningTasksSize(0),
+		m_numOfFinishing(0),
+		m_finishTasksQueueMutex(),
+		m_finishTasksQueue(),
+		m_finishTasksQueueSize(0)
+	{}
+
+	size_t GetConcurrencyCapNonLocking() const
+	{
+		// a blocked task does not hold up the others of the same pool
+		return m_maxConcurrency + m_numOfBlocking;
+	}
+
+	bool IsRunnableNonLocking() const
+	{
+		return
+			!m_isDetaching &&
+			!m_pendingTasks.empty() &&
+			m_runningTasks.size() < GetConcurrencyCapNonLocking();
+	}
+
+	size_t GetNumOfRunnableNonLocking() const
+	{
+		size_t cap = GetConcurrencyCapNonLocking();
+		if (m_isDetaching || m_runningTasks.size() >= cap)
+		{
+			return 0;
+		}
+		return std::min(m_pendingTasks.size(), cap - m_runningTasks.size());
+	}
+
+	// the pool seen by `ThreadPoolBase::GetCurrent` in its tasks
+	ThreadPoolBase& m_pool;
+
+	std::atomic<size_t> m_maxConcurrency;
+	const size_t m_weight;
+	// the tasks of this tenant blocking (see `ScopedBlocking`)
+	size_t m_numOfBlocking;
+
+	// the virtual time of this tenant; the runnable tenant with the
+	// smallest value is served next, and it advances by `1 / weight`
+	// for each task started
+	double m_pass;
+	bool m_isDetaching;
+
+	std::deque<std::unique_ptr<Task> > m_pendingTasks;
+	std::atomic<size_t> m_pendingTasksSize;
+	std::vector<RunningTask> m_runningTasks;
+	std::atomic<size_t> m_runningTasksSize;
+	// the tasks done running, whose workers are finishing them
+	size_t m_numOfFinishing;
+
+	std::mutex m_finishTasksQueueMutex;
+	std::deque<std::unique_ptr<Task> > m_finishTasksQueue;
+	std::atomic<size_t> m_finishTasksQueueSize;
+}; // struct SharedExecutorTenant
+
+
+/**
+ * @brief A set of worker threads shared by multiple logical pools
+ *        (see `LogicalThreadPool`), so that the process does not create
+ *        more threads than it can run.
+ *        Each logical pool runs at most its max concurrency of tasks at once,
+ *        and when logical pools compete for the workers, they get them
+ *        in proportion to their weights.
+ *
+ */
+class SharedExecutor
+{
+public: // static members:
+
+	/**
+	 * @brief Get the executor shared by the whole process; it has one
+	 *        worker per hardware thread, and lives until the program exits.
+	 *        NOTE: logical pools attached to it must not outlive it,
+	 *        so don't attach static logical pools to it.
+	 *
+	 */
+	static SharedExecutor& GetGlobal()
+	{
+		static SharedExecutor s_executor(std::thread::hardware_concurrency());
+		return s_executor;
+	}
+
+
+public:
+
+	SharedExecutor(size_t numOfThreads) :
+		m_numOfThreads(numOfThreads > 0 ? numOfThreads : 1),
+		m_pool(m_numOfThreads),
+		m_mutex(),
+		m_detachCV(),
+		m_tenants(),
+		m_virtualTime(0.0),
+		m_numOfWorkers(0),
+		m_numOfBlocking(0),
+		m_terminated(false),
+		m_numOfTerminating(0)
+	{
+		// the worker loops have nothing to finish
+		m_pool.SetCompletionMode(CompletionMode::Inline);
+	}
+
+
+	// LCOV_EXCL_START
+	virtual ~SharedExecutor()
+	{
+		Terminate();
+	}
+	// LCOV_EXCL_STOP
+
+
+	size_t GetNumOfThreads() const
+	{
+		return m_numOfThreads;
+	}
+
+
+	void Attach(SharedExecutorTenant& tenant)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		tenant.m_pass = m_virtualTime;
+		m_tenants.push_back(&tenant);
+	}
+
+
+	/**
+	 * @brief Detach a tenant; its pending tasks are dropped, and its running
+	 *        tasks are terminated and waited for.
+	 *
+	 */
+	void Detach(SharedExecutorTenant& tenant)
+	{
+		std::deque<std::unique_ptr<Task> > droppedTasks;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		auto it = std::find(m_tenants.begin(), m_tenants.end(), &tenant);
+		if (it == m_tenants.end())
+		{
+			return;
+		}
+
+		tenant.m_isDetaching = true;
+		droppedTasks.swap(tenant.m_pendingTasks);
+		tenant.m_pendingTasksSize = 0;
+
+		std::vector<Task*> runningTasks;
+		AppendRunningTasksNonLocking(tenant, runningTasks);
+		TerminateTasks(lock, runningTasks);
+		m_detachCV.wait(
+			lock,
+			[&tenant]()
+			{
+				return
+					tenant.m_runningTasks.empty() &&
+					(tenant.m_numOfFinishing == 0);
+			}
+		);
+
+		m_tenants.erase(
+			std::find(m_tenants.begin(), m_tenants.end(), &tenant)
+		);
+
+		lock.unlock();
+		// the dropped tasks are destroyed here, without holding the lock
+	}
+
+
+	void AddTask(SharedExecutorTenant& tenant, std::unique_ptr<Task> task)
+	{
+		size_t numOfNewWorkers = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (tenant.m_pendingTasks.empty() && tenant.m_runningTasks.empty())
+			{
+				// an idle tenant does not save up credit for later
+				tenant.m_pass = std::max(tenant.m_pass, m_virtualTime);
+			}
+			tenant.m_pendingTasks.push_back(std::move(task));
+			++tenant.m_pendingTasksSize;
+
+			numOfNewWorkers = ReserveWorkersNonLocking();
+		}
+
+		StartWorkers(numOfNewWorkers);
+	}
+
+
+	/**
+	 * @brief Change the max number of tasks of a tenant running at once;
+	 *        when it shrinks, the tasks already running are not interrupted.
+	 *
+	 */
+	void SetMaxConcurrency(SharedExecutorTenant& tenant, size_t maxConcurrency)
+	{
+		size_t numOfNewWorkers = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			tenant.m_maxConcurrency = maxConcurrency;
+			numOfNewWorkers = ReserveWorkersNonLocking();
+		}
+
+		StartWorkers(numOfNewWorkers);
+	}
+
+
+	/**
+	 * @brief Take a pending task of a tenant, and run it in the calling
+	 *        thread, regardless of its max concurrency, as the calling thread
+	 *        is usually waiting for the tenant's tasks anyway.
+	 *
+	 * @return Whether there was a task to run.
+	 */
+	bool RunPendingTask(SharedExecutorTenant& tenant)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		if (m_terminated || tenant.m_isDetaching || tenant.m_pendingTasks.empty())
+		{
+			return false;
+		}
+
+		std::unique_ptr<Task> task = StartTaskNonLocking(tenant);
+
+		lock.unlock();
+		RunTaskCaught(*task);
+		lock.lock();
+
+		EndTask(lock, tenant, std::move(task));
+		return true;
+	}
+
+
+	/**
+	 * @brief Called by a worker running a task of a tenant before the task
+	 *        blocks; until the matching `EndBlocking`, both the tenant and
+	 *        the executor may run one more task at once.
+	 *
+	 */
+	void BeginBlocking(SharedExecutorTenant& tenant)
+	{
+		size_t numOfNewWorkers = 0;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			++tenant.m_numOfBlocking;
+			++m_numOfBlocking;
+			numOfNewWorkers = ReserveWorkersNonLocking();
+		}
+
+		// the calling thread is a worker of the underlying pool, which
+		// needs a compensating thread for the new worker too
+		m_pool.BeginBlocking();
+		StartWorkers(numOfNewWorkers);
+	}
+
+
+	void EndBlocking(SharedExecutorTenant& tenant)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			--tenant.m_numOfBlocking;
+			--m_numOfBlocking;
+			// a worker beyond the number of threads is given back once it
+			// is done with its task
+		}
+
+		m_pool.EndBlocking();
+	}
+
+
+	std::vector<RunningTaskInfo> GetRunningTasks(
+		const SharedExecutorTenant& tenant
+	) const
+	{
+		std::vector<RunningTaskInfo> infos;
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		Task::TimePoint now = Task::Clock::now();
+		for (const SharedExecutorTenant::RunningTask& running :
+			tenant.m_runningTasks)
+		{
+			RunningTaskInfo info;
+			info.m_threadId = running.m_threadId;
+			info.m_runIndex = running.m_runIndex;
+			info.m_tag = running.m_task->GetTag();
+			info.m_beginTime = running.m_beginTime;
+			info.m_runTime =
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+					now - running.m_beginTime
+				);
+			infos.push_back(info);
+		}
+		return infos;
+	}
+
+
+	/**
+	 * @brief Stop the shared workers; tasks still running are terminated,
+	 *        and pending tasks stay pending until their logical pools
+	 *        are terminated.
+	 *
+	 */
+	void Terminate()
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_terminated = true;
+			std::vector<Task*> runningTasks;
+			for (SharedExecutorTenant* tenant : m_tenants)
+			{
+				AppendRunningTasksNonLocking(*tenant, runningTasks);
+			}
+			TerminateTasks(lock, runningTasks);
+		}
+
+		m_pool.Terminate();
+	}
+
+
+private: // private types:
+
+
+	class WorkerTask :
+		public Task
+	{
+	public:
+		WorkerTask(SharedExecutor& executor) :
+			m_executor(executor)
+		{}
+
+		// LCOV_EXCL_START
+		virtual ~WorkerTask() = default;
+		// LCOV_EXCL_STOP
+
+		virtual void Run() override
+		{
+			m_executor.WorkerLoop();
+		}
+
+		virtual void Terminate() override
+		{}
+
+	private:
+		SharedExecutor& m_executor;
+	}; // class WorkerTask
+
+
+private: // private functions:
+
+
+	SharedExecutorTenant* PickTenantNonLocking()
+	{
+		SharedExecutorTenant* picked = nullptr;
+		for (SharedExecutorTenant* tenant : m_tenants)
+		{
+			if (
+				tenant->IsRunnableNonLocking() &&
+				(picked == nullptr || tenant->m_pass < picked->m_pass)
+			)
+			{
+				picked = tenant;
+			}
+		}
+		return picked;
+	}
+
+
+	size_t GetMaxNumOfWorkersNonLocking() const
+	{
+		return m_numOfThreads + m_numOfBlocking;
+	}
+
+
+	size_t ReserveWorkersNonLocking()
+	{
+		if (m_terminated)
+		{
+			return 0;
+		}
+
+		// every running task and every task that can start now needs
+		// a worker, up to the number of threads
+		size_t numOfNeeded = 0;
+		for (SharedExecutorTenant* tenant : m_tenants)
+		{
+			numOfNeeded += tenant->m_runningTasks.size();
+			numOfNeeded += tenant->GetNumOfRunnableNonLocking();
+		}
+		numOfNeeded = std::min(numOfNeeded, GetMaxNumOfWorkersNonLocking());
+
+		size_t numOfNewWorkers =
+			numOfNeeded > m_numOfWorkers ? numOfNeeded - m_numOfWorkers : 0;
+		m_numOfWorkers += numOfNewWorkers;
+		return numOfNewWorkers;
+	}
+
+
+	void StartWorkers(size_t numOfNewWorkers)
+	{
+		for (size_t i = 0; i < numOfNewWorkers; ++i)
+		{
+			m_pool.AddTask(std::unique_ptr<Task>(new WorkerTask(*this)));
+		}
+	}
+
+
+	/**
+	 * @brief Call `Terminate` on running tasks without holding the lock,
+	 *        as it is user code; meanwhile, workers wait before letting go
+	 *        of their tasks, so none of them is destroyed.
+	 *
+	 */
+	void TerminateTasks(
+		std::unique_lock<std::mutex>& lock,
+		std::vector<Task*> tasks
+	)
+	{
+		++m_numOfTerminating;
+		lock.unlock();
+
+		for (Task* task : tasks)
+		{
+			task->Terminate();
+		}
+
+		lock.lock();
+		--m_numOfTerminating;
+		m_detachCV.notify_all();
+	}
+
+
+	static void AppendRunningTasksNonLocking(
+		const SharedExecutorTenant& tenant,
+		std::vector<Task*>& tasks
+	)
+	{
+		for (const SharedExecutorTenant::RunningTask& running :
+			tenant.m_runningTasks)
+		{
+			tasks.push_back(running.m_task);
+		}
+	}
+
+
+	/**
+	 * @brief The slot of `ThreadPoolBase::GetCurrent` of the calling thread,
+	 *        which is protected; defined after `LogicalThreadPool`.
+	 *
+	 */
+	static ThreadPoolBase*& CurrentPool();
+
+
+	static uint64_t& CurrentRunIndex()
+	{
+		static thread_local uint64_t s_runIndex = 0;
+		return s_runIndex;
+	}
+
+
+	/**
+	 * @brief Take the next pending task of a tenant, to be run by the
+	 *        calling thread.
+	 *
+	 */
+	std::unique_ptr<Task> StartTaskNonLocking(SharedExecutorTenant& tenant)
+	{
+		std::unique_ptr<Task> task = std::move(tenant.m_pendingTasks.front());
+		tenant.m_pendingTasks.pop_front();
+		--tenant.m_pendingTasksSize;
+
+		SharedExecutorTenant::RunningTask running;
+		running.m_task = task.get();
+		running.m_threadId = std::this_thread::get_id();
+		running.m_runIndex = CurrentRunIndex()++;
+		running.m_beginTime = Task::Clock::now();
+		tenant.m_runningTasks.push_back(running);
+		++tenant.m_runningTasksSize;
+
+		m_virtualTime = tenant.m_pass;
+		tenant.m_pass += 1.0 / tenant.m_weight;
+
+		return task;
+	}
+
+
+	void EndTask(
+		std::unique_lock<std::mutex>& lock,
+		SharedExecutorTenant& tenant,
+		std::unique_ptr<Task> task
+	)
+	{
+		// the task may be being terminated, outside the lock
+		m_detachCV.wait(
+			lock,
+			[this]()
+			{
+				return m_numOfTerminating == 0;
+			}
+		);
+		auto it = std::find_if(
+			tenant.m_runningTasks.begin(),
+			tenant.m_runningTasks.end(),
+			[&task](const SharedExecutorTenant::RunningTask& running)
+			{
+				return running.m_task == task.get();
+			}
+		);
+		tenant.m_runningTasks.erase(it);
+		++tenant.m_numOfFinishing;
+
+		lock.unlock();
+		FinishTask(tenant, std::move(task));
+		lock.lock();
+
+		--tenant.m_numOfFinishing;
+		--tenant.m_runningTasksSize;
+		if (tenant.m_isDetaching)
+		{
+			m_detachCV.notify_all();
+		}
+	}
+
+
+	static void RunTaskCaught(Task& task)
+	{
+		try
+		{
+			task.Run();
+		}
+		catch(...)
+		{
+			task.OnException(std::current_exception());
+		}
+	}
+
+
+	static void FinishTask(
+		SharedExecutorTenant& tenant,
+		std::unique_ptr<Task> task
+	)
+	{
+		if (task->GetCompletionMode() == CompletionMode::Inline)
+		{
+			try
+			{
+				task->Finishing();
+			}
+			catch(...)
+			{
+				task->OnException(std::current_exception());
+			}
+			return;
+		}
+
+		std::lock_guard<std::mutex> lock(tenant.m_finishTasksQueueMutex);
+		tenant.m_finishTasksQueue.push_back(std::move(task));
+		++tenant.m_finishTasksQueueSize;
+	}
+
+
+	void WorkerLoop()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+
+		while (true)
+		{
+			SharedExecutorTenant* tenant =
+				m_terminated || (m_numOfWorkers > GetMaxNumOfWorkersNonLocking()) ?
+					nullptr :
+					PickTenantNonLocking();
+			if (tenant == nullptr)
+			{
+				// nothing can run now, or it is a compensating worker no
+				// longer needed; the worker is given back, and a new one is
+				// started when there is something to run again
+				--m_numOfWorkers;
+				return;
+			}
+
+			std::unique_ptr<Task> task = StartTaskNonLocking(*tenant);
+
+			// the task runs as if this thread were a worker of its logical
+			// pool, so `TaskGroup` and `ScopedBlocking` work with it
+			ThreadPoolBase*& currentPool = CurrentPool();
+			ThreadPoolBase* prevPool = currentPool;
+
+			lock.unlock();
+			currentPool = &tenant->m_pool;
+			RunTaskCaught(*task);
+			currentPool = prevPool;
+			lock.lock();
+
+			EndTask(lock, *tenant, std::move(task));
+		}
+	}
+
+
+private:
+
+	size_t m_numOfThreads;
+	ThreadPool m_pool;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_detachCV;
+	std::vector<SharedExecutorTenant*> m_tenants;
+	double m_virtualTime;
+	size_t m_numOfWorkers;
+	// the tasks blocking (see `ScopedBlocking`), each of which lets one
+	// more worker run
+	size_t m_numOfBlocking;
+	bool m_terminated;
+	// the number of threads calling `Terminate` on running tasks
+	size_t m_numOfTerminating;
+
+}; // class SharedExecutor
+
+
+/**
+ * @brief A thread pool that runs its tasks on the workers of a
+ *        `SharedExecutor`, instead of its own threads.
+ *        It has the same interface as `ThreadPool`, so it works with
+ *        `TaskGroup`, `ScopedBlocking`, `StallWatchdog`, and
+ *        `CpuQuotaWatcher`; the pool size is the max number of its tasks
+ *        running at once.
+ *
+ */
+class LogicalThreadPool :
+	public ThreadPoolBase
+{
+public:
+
+	/**
+	 * @brief Attach a logical pool to the global shared executor,
+	 *        with a weight of 1.
+	 *
+	 */
+	LogicalThreadPool(size_t poolSize) :
+		LogicalThreadPool(SharedExecutor::GetGlobal(), poolSize, 1)
+	{}
+
+
+	LogicalThreadPool(
+		SharedExecutor& executor,
+		size_t maxConcurrency,
+		size_t weight = 1
+	) :
+		m_executor(executor),
+		m_tenant(
+			*this,
+			CheckNonZero(maxConcurrency, "The max concurrency"),
+			CheckNonZero(weight, "The weight")
+		),
+		m_terminated(false)
+	{
+		m_executor.Attach(m_tenant);
+	}
+
+
+	// LCOV_EXCL_START
+	virtual ~LogicalThreadPool()
+	{
+		Terminate();
+	}
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Call the `Finishing` functions of the finished tasks.
+	 *        If a `Finishing` function throws, the exception is propagated,
+	 *        and the tasks not finished yet are put back.
+	 *
+	 */
+	void Update()
+	{
+		std::deque<std::unique_ptr<Task> > tasks;
+
+		while (m_tenant.m_finishTasksQueueSize > 0)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_tenant.m_finishTasksQueueMutex);
+				tasks.swap(m_tenant.m_finishTasksQueue);
+				m_tenant.m_finishTasksQueueSize = 0;
+			}
+
+			while (!tasks.empty())
+			{
+				try
+				{
+					tasks.front()->Finishing();
+				}
+				catch(...)
+				{
+					tasks.pop_front();
+					ReturnFinishedTasks(tasks);
+					throw;
+				}
+				tasks.pop_front();
+			}
+		}
+	}
+
+
+	virtual void AddTask(std::unique_ptr<Task> task) override
+	{
+		if (m_terminated)
+		{
+			// the same as a terminated `ThreadPool`, the task never runs
+			return;
+		}
+		m_executor.AddTask(m_tenant, std::move(task));
+	}
+
+
+	size_t GetMaxConcurrency() const
+	{
+		return m_tenant.m_maxConcurrency;
+	}
+
+
+	size_t GetWeight() const
+	{
+		return m_tenant.m_weight;
+	}
+
+
+	virtual size_t GetPoolSize() const override
+	{
+		return GetMaxConcurrency();
+	}
+
+
+	/**
+	 * @brief Change the max number of its tasks running at once; unlike
+	 *        `ThreadPool`, it must be greater than zero.
+	 *
+	 */
+	virtual void SetPoolSize(size_t poolSize) override
+	{
+		m_executor.SetMaxConcurrency(
+			m_tenant,
+			CheckNonZero(poolSize, "The max concurrency")
+		);
+	}
+
+
+	virtual bool RunPendingTask() override
+	{
+		return m_executor.RunPendingTask(m_tenant);
+	}
+
+
+	/**
+	 * @brief While its task blocks, one more of its tasks may run, on one
+	 *        more worker of the shared executor.
+	 *
+	 */
+	virtual void BeginBlocking() override
+	{
+		m_executor.BeginBlocking(m_tenant);
+	}
+
+
+	virtual void EndBlocking() override
+	{
+		m_executor.EndBlocking(m_tenant);
+	}
+
+
+	virtual std::vector<RunningTaskInfo> GetRunningTasks() const override
+	{
+		return m_executor.GetRunningTasks(m_tenant);
+	}
+
+
+	virtual bool IsTerminated() const override
+	{
+		return m_terminated;
+	}
+
+
+	size_t GetNumOfPendingTasks() const
+	{
+		return m_tenant.m_pendingTasksSize;
+	}
+
+
+	size_t GetNumOfRunningTasks() const
+	{
+		return m_tenant.m_runningTasksSize;
+	}
+
+
+	size_t GetNumOfFinishedTasks() const
+	{
+		return m_tenant.m_finishTasksQueueSize;
+	}
+
+
+	/**
+	 * @brief Drop the pending tasks, terminate the running ones, and wait
+	 *        for them to return; the shared workers keep running the tasks
+	 *        of other logical pools.
+	 *
+	 */
+	void Terminate()
+	{
+		m_terminated = true;
+		m_executor.Detach(m_tenant);
+	}
+
+
+private:
+
+	// so its workers see this pool as the current one
+	friend class SharedExecutor;
+
+
+private: // private functions:
+
+	static size_t CheckNonZero(size_t val, const char* name)
+	{
+		if (val == 0)
+		{
+			throw std::invalid_argument(
+				std::string(name) + " must be greater than zero"
+			);
+		}
+		return val;
+	}
+
+
+	void ReturnFinishedTasks(std::deque<std::unique_ptr<Task> >& tasks)
+	{
+		std::lock_guard<std::mutex> lock(m_tenant.m_finishTasksQueueMutex);
+
+		// put them back to the front, so they are still the first ones
+		while (!tasks.empty())
+		{
+			m_tenant.m_finishTasksQueue.push_front(std::move(tasks.back()));
+			tasks.pop_back();
+			++m_tenant.m_finishTasksQueueSize;
+		}
+	}
+
+
+private:
+
+	SharedExecutor& m_executor;
+	SharedExecutorTenant m_tenant;
+	std::atomic_bool m_terminated;
+
+}; // class LogicalThreadPool
+
+
+inline ThreadPoolBase*& SharedExecutor::CurrentPool()
+{
+	return LogicalThreadPool::CurrentWorkerPool();
+}
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,837 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#ifdef __linux__
+
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "CacheLine.hpp"
+#include "Executor.hpp"
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A bounded work queue in shared memory, which the processes on a
+ *        host can attach to by name, so that they can share work without
+ *        a broker or sockets.
+ *        Tasks can't cross process boundaries, so it holds task
+ *        descriptors instead, each a handler ID plus a payload of bytes;
+ *        each process turns them back into tasks with its own handlers
+ *        (see `SharedMemoryTaskDispatcher`).
+ *        It is a Vyukov MPMC ring of fixed-size cells, using lock-free
+ *        atomics in the shared memory; consumers waiting for descriptors
+ *        sleep on a futex.
+ *        The shared memory object outlives the processes, until `Remove`
+ *        is called.
+ *        NOTE: a process that dies between claiming a cell and
+ *        publishing it (in `TryPush` or `TryPop`) wedges the ring at that
+ *        cell: after a push, the consumers stop at it, and after a pop,
+ *        the producers do once they wrap around to it. The other
+ *        processes can't tell a dead process from a slow one, so the
+ *        queue must then be removed and created again.
+ *
+ */
+class SharedMemoryTaskQueue
+{
+public: // static members:
+
+	static_assert(
+		ATOMIC_INT_LOCK_FREE == 2 && ATOMIC_LLONG_LOCK_FREE == 2,
+		"Atomics in shared memory must be lock-free"
+	);
+
+	static constexpr uint32_t sk_magic = 0x53435451;
+
+	/**
+	 * @brief How long to wait for the creator to set up the queue,
+	 *        when attaching to it.
+	 *
+	 */
+	static constexpr int64_t sk_attachTimeoutMs = 1000;
+
+
+	/**
+	 * @brief Remove the shared memory object; the processes attached to it
+	 *        keep using it until they detach.
+	 *
+	 */
+	static void Remove(const std::string& name)
+	{
+		shm_unlink(name.c_str());
+	}
+
+
+public:
+
+	/**
+	 * @brief Create the queue, or attach to it if it exists; the processes
+	 *        attaching to it must give the same capacity and max payload
+	 *        size.
+	 *
+	 * @param name The name of the shared memory object, e.g., "/my_queue".
+	 * @param capacity The number of descriptors it holds; must be a power
+	 *                 of two.
+	 * @param maxPayloadSize The max size of a payload, in bytes.
+	 */
+	SharedMemoryTaskQueue(
+		const std::string& name,
+		size_t capacity,
+		size_t maxPayloadSize
+	) :
+		m_capacity(capacity),
+		m_maxPayloadSize(maxPayloadSize),
+		m_cellSize(GetCellSize(maxPayloadSize)),
+		m_mapSize(sizeof(Header) + capacity * GetCellSize(maxPayloadSize)),
+		m_map(nullptr),
+		m_header(nullptr),
+		m_cells(nullptr)
+	{
+		if (
+			capacity < 2 || (capacity & (capacity - 1)) != 0 ||
+			capacity > UINT32_MAX ||
+			maxPayloadSize == 0 || maxPayloadSize > UINT32_MAX
+		)
+		{
+			throw std::invalid_argument(
+				"The capacity must be a power of two, and the max payload"
+				" size must be greater than 0"
+			);
+		}
+
+		bool isCreator = true;
+		int fd = shm_open(
+			name.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0600
+		);
+		if (fd < 0 && errno == EEXIST)
+		{
+			isCreator = false;
+			fd = shm_open(name.c_str(), O_RDWR | O_CLOEXEC, 0);
+		}
+		if (fd < 0)
+		{
+			throw std::system_error(errno, std::generic_category(), "shm_open");
+		}
+
+		try
+		{
+			if (isCreator)
+			{
+				if (ftruncate(fd, static_cast<off_t>(m_mapSize)) != 0)
+				{
+					throw std::system_error(
+						errno, std::generic_category(), "ftruncate"
+					);
+				}
+			}
+			else
+			{
+				WaitForSize(fd);
+			}
+
+			void* map = mmap(
+				nullptr, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0
+			);
+			if (map == MAP_FAILED)
+			{
+				throw std::system_error(errno, std::generic_category(), "mmap");
+			}
+			m_map = map;
+		}
+		catch(...)
+		{
+			close(fd);
+			if (isCreator)
+			{
+				shm_unlink(name.c_str());
+			}
+			throw;
+		}
+		close(fd);
+
+		m_header = static_cast<Header*>(m_map);
+		m_cells = static_cast<char*>(m_map) + sizeof(Header);
+
+		if (isCreator)
+		{
+			Initialize();
+		}
+		else
+		{
+			try
+			{
+				WaitForInitialization();
+			}
+			catch(...)
+			{
+				munmap(m_map, m_mapSize);
+				throw;
+			}
+		}
+	}
+
+
+	SharedMemoryTaskQueue(const SharedMemoryTaskQueue&) = delete;
+
+	SharedMemoryTaskQueue& operator=(const SharedMemoryTaskQueue&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~SharedMemoryTaskQueue()
+	{
+		munmap(m_map, m_mapSize);
+	}
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Push a descriptor; returns `false` if the queue is full.
+	 *
+	 */
+	bool TryPush(uint32_t handlerId, const void* payload, size_t size)
+	{
+		if (size > m_maxPayloadSize)
+		{
+			throw std::invalid_argument("The payload is too large");
+		}
+
+		uint64_t pos = m_header->m_pushPos.m_value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			CellHeader& cell = GetCell(pos);
+			uint64_t seq = cell.m_seq.load(std::memory_order_acquire);
+			int64_t diff = static_cast<int64_t>(seq) - static_cast<int64_t>(pos);
+			if (diff == 0)
+			{
+				if (m_header->m_pushPos.m_value.compare_exchange_weak(
+					pos, pos + 1, std::memory_order_relaxed
+				))
+				{
+					cell.m_handlerId = handlerId;
+					cell.m_size = static_cast<uint32_t>(size);
+					if (size > 0)
+					{
+						std::memcpy(GetPayload(cell), payload, size);
+					}
+					cell.m_seq.store(pos + 1, std::memory_order_release);
+					break;
+				}
+			}
+			else if (diff < 0)
+			{
+				// the queue is full
+				return false;
+			}
+			else
+			{
+				pos = m_header->m_pushPos.m_value.load(std::memory_order_relaxed);
+			}
+		}
+
+		// the waiters check the number of pushes before sleeping
+		m_header->m_numOfPushes.m_value.fetch_add(1);
+		if (m_header->m_numOfWaiters.load() > 0)
+		{
+			Futex(FUTEX_WAKE, INT_MAX, nullptr);
+		}
+		return true;
+	}
+
+
+	bool TryPush(uint32_t handlerId, const std::string& payload)
+	{
+		return TryPush(handlerId, payload.data(), payload.size());
+	}
+
+
+	/**
+	 * @brief Pop a descriptor; returns `false` if the queue is empty.
+	 *
+	 */
+	bool TryPop(uint32_t& handlerId, std::string& payload)
+	{
+		uint64_t pos = m_header->m_popPos.m_value.load(std::memory_order_relaxed);
+		while (true)
+		{
+			CellHeader& cell = GetCell(pos);
+			uint64_t seq = cell.m_seq.load(std::memory_order_acquire);
+			int64_t diff =
+				static_cast<int64_t>(seq) - static_cast<int64_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_header->m_popPos.m_value.compare_exchange_weak(
+					pos, pos + 1, std::memory_order_relaxed
+				))
+				{
+					handlerId = cell.m_handlerId;
+					payload.assign(GetPayload(cell), cell.m_size);
+					cell.m_seq.store(pos + m_capacity, std::memory_order_release);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				// the queue is empty
+				return false;
+			}
+			else
+			{
+				pos = m_header->m_popPos.m_value.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+
+	/**
+	 * @brief Get the number of descriptors in the queue, across all
+	 *        processes; it is only a snapshot.
+	 *
+	 */
+	size_t Size() const
+	{
+		uint64_t popPos = m_header->m_popPos.m_value.load();
+		uint64_t pushPos = m_header->m_pushPos.m_value.load();
+		return pushPos > popPos ? static_cast<size_t>(pushPos - popPos) : 0;
+	}
+
+
+	size_t GetCapacity() const
+	{
+		return m_capacity;
+	}
+
+
+	size_t GetMaxPayloadSize() const
+	{
+		return m_maxPayloadSize;
+	}
+
+
+	/**
+	 * @brief Get the number of pushes so far, which wraps around; read it
+	 *        before trying to pop, and pass it to `WaitForPush` if there
+	 *        was nothing to pop.
+	 *
+	 */
+	uint32_t GetNumOfPushes() const
+	{
+		return m_header->m_numOfPushes.m_value.load();
+	}
+
+
+	/**
+	 * @brief Wait until a descriptor is pushed after `numOfPushes` was read,
+	 *        the timeout passes, or `WakeAll` is called.
+	 *
+	 */
+	void WaitForPush(uint32_t numOfPushes, std::chrono::nanoseconds timeout)
+	{
+		struct timespec ts;
+		ts.tv_sec = static_cast<time_t>(timeout.count() / 1000000000);
+		ts.tv_nsec = static_cast<long>(timeout.count() % 1000000000);
+
+		m_header->m_numOfWaiters.fetch_add(1);
+		// returns right away if there was a push since
+		Futex(FUTEX_WAIT, numOfPushes, &ts);
+		m_header->m_numOfWaiters.fetch_sub(1);
+	}
+
+
+	/**
+	 * @brief Wake up all waiters, in all processes.
+	 *
+	 */
+	void WakeAll()
+	{
+		Futex(FUTEX_WAKE, INT_MAX, nullptr);
+	}
+
+
+private: // private types:
+
+
+	struct Header
+	{
+		std::atomic<uint32_t> m_state;
+		uint32_t m_capacity;
+		uint32_t m_maxPayloadSize;
+		std::atomic<uint32_t> m_numOfWaiters;
+		CacheLinePadded<std::atomic<uint64_t> > m_pushPos;
+		CacheLinePadded<std::atomic<uint64_t> > m_popPos;
+		// the futex word
+		CacheLinePadded<std::atomic<uint32_t> > m_numOfPushes;
+	}; // struct Header
+
+
+	struct CellHeader
+	{
+		std::atomic<uint64_t> m_seq;
+		uint32_t m_handlerId;
+		uint32_t m_size;
+	}; // struct CellHeader
+
+
+private: // private functions:
+
+
+	static size_t GetCellSize(size_t maxPayloadSize)
+	{
+		// keep the cells 8-byte aligned
+		return (sizeof(CellHeader) + maxPayloadSize + 7) & ~size_t(7);
+	}
+
+
+	CellHeader& GetCell(uint64_t pos)
+	{
+		return *reinterpret_cast<CellHeader*>(
+			m_cells + (pos & (m_capacity - 1)) * m_cellSize
+		);
+	}
+
+
+	static char* GetPayload(CellHeader& cell)
+	{
+		return reinterpret_cast<char*>(&cell) + sizeof(CellHeader);
+	}
+
+
+	void Initialize()
+	{
+		// the memory is zeroed by `ftruncate`
+		new (m_header) Header();
+		m_header->m_capacity = static_cast<uint32_t>(m_capacity);
+		m_header->m_maxPayloadSize = static_cast<uint32_t>(m_maxPayloadSize);
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			CellHeader* cell = new (&GetCell(i)) CellHeader();
+			cell->m_seq.store(i, std::memory_order_relaxed);
+		}
+		m_header->m_state.store(sk_magic, std::memory_order_release);
+	}
+
+
+	void WaitForSize(int fd)
+	{
+		// the creator may not have set the size yet
+		auto deadline = std::chrono::steady_clock::now() +
+			std::chrono::milliseconds(static_cast<int64_t>(sk_attachTimeoutMs));
+		while (true)
+		{
+			struct stat st;
+			if (fstat(fd, &st) != 0)
+			{
+				throw std::system_error(errno, std::generic_category(), "fstat");
+			}
+			if (st.st_size != 0)
+			{
+				if (static_cast<size_t>(st.st_size) != m_mapSize)
+				{
+					throw std::invalid_argument(
+						"The queue exists with a different capacity or"
+						" max payload size"
+					);
+				}
+				return;
+			}
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				throw std::runtime_error("The queue is not set up in time");
+			}
+			std::this_thread::yield();
+		}
+	}
+
+
+	void WaitForInitialization()
+	{
+		auto deadline = std::chrono::steady_clock::now() +
+			std::chrono::milliseconds(static_cast<int64_t>(sk_attachTimeoutMs));
+		while (m_header->m_state.load(std::memory_order_acquire) != sk_magic)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+			{
+				throw std::runtime_error("The queue is not set up in time");
+			}
+			std::this_thread::yield();
+		}
+
+		if (
+			m_header->m_capacity != m_capacity ||
+			m_header->m_maxPayloadSize != m_maxPayloadSize
+		)
+		{
+			throw std::invalid_argument(
+				"The queue exists with a different capacity or"
+				" max payload size"
+			);
+		}
+	}
+
+
+	void Futex(int op, uint32_t val, const struct timespec* timeout)
+	{
+		// not `FUTEX_PRIVATE_FLAG`, since the waiters are in other
+		// processes too
+		syscall(
+			SYS_futex,
+			reinterpret_cast<uint32_t*>(&m_header->m_numOfPushes.m_value),
+			op, val, timeout, nullptr, 0
+		);
+	}
+
+
+private:
+
+	size_t m_capacity;
+	size_t m_maxPayloadSize;
+	size_t m_cellSize;
+	size_t m_mapSize;
+
+	void* m_map;
+	Header* m_header;
+	char* m_cells;
+
+}; // class SharedMemoryTaskQueue
+
+
+/**
+ * @brief Pulls task descriptors from a `SharedMemoryTaskQueue`, and runs
+ *        them on an executor of this process (e.g., a `ThreadPool`) with
+ *        the handlers registered for their IDs.
+ *        It keeps at most a given number of them in flight, i.e., taken
+ *        but not finished, so a busy process leaves the rest of the queue
+ *        to the others, which is what balances the load across processes.
+ *        Descriptors without a handler are dropped.
+ *
+ */
+class SharedMemoryTaskDispatcher
+{
+public: // static members:
+
+	using Handler = std::function<void(const std::string&)>;
+
+	/**
+	 * @brief The max time to sleep between checks of the queue; wake-ups
+	 *        normally come sooner, from the pushes.
+	 *
+	 */
+	static constexpr int64_t sk_maxWaitMs = 100;
+
+
+public:
+
+	/**
+	 * @param queue The queue to pull from.
+	 * @param executor The executor to run the tasks.
+	 * @param maxNumOfInFlight The max number of tasks in flight, usually
+	 *                         the pool size of the executor.
+	 */
+	SharedMemoryTaskDispatcher(
+		SharedMemoryTaskQueue& queue,
+		Executor& executor,
+		size_t maxNumOfInFlight
+	) :
+		m_queue(queue),
+		m_executor(executor),
+		m_maxNumOfInFlight(maxNumOfInFlight),
+		m_handlersMutex(),
+		m_handlers(),
+		m_inFlight(std::make_shared<InFlightState>()),
+		m_numOfDispatchedTasks(0),
+		m_numOfDroppedTasks(0),
+		m_thread(),
+		m_isStopping(false)
+	{
+		if (maxNumOfInFlight == 0)
+		{
+			throw std::invalid_argument(
+				"The max number of tasks in flight must be greater than 0"
+			);
+		}
+	}
+
+
+	SharedMemoryTaskDispatcher(const SharedMemoryTaskDispatcher&) = delete;
+
+	SharedMemoryTaskDispatcher& operator=(const SharedMemoryTaskDispatcher&) =
+		delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~SharedMemoryTaskDispatcher()
+	{
+		Stop();
+	}
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Register the handler for the descriptors with the given ID;
+	 *        it is called in a worker, with the payload.
+	 *
+	 */
+	void RegisterHandler(uint32_t handlerId, Handler handler)
+	{
+		std::lock_guard<std::mutex> lock(m_handlersMutex);
+		m_handlers[handlerId] = std::move(handler);
+	}
+
+
+	/**
+	 * @brief Start pulling descriptors, in a thread of its own; the handlers
+	 *        should be registered by then.
+	 *
+	 */
+	void Start()
+	{
+		if (m_thread.joinable())
+		{
+			return;
+		}
+
+		m_isStopping = false;
+		m_thread = std::thread(
+			[this]()
+			{
+				PullerRunner();
+			}
+		);
+	}
+
+
+	/**
+	 * @brief Stop pulling descriptors; the tasks in flight still run.
+	 *
+	 */
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_inFlight->m_mutex);
+			m_isStopping = true;
+		}
+		m_inFlight->m_cv.notify_all();
+		m_queue.WakeAll();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+
+	size_t GetNumOfInFlightTasks() const
+	{
+		std::lock_guard<std::mutex> lock(m_inFlight->m_mutex);
+		return m_inFlight->m_numOfInFlight;
+	}
+
+
+	uint64_t GetNumOfDispatchedTasks() const
+	{
+		return m_numOfDispatchedTasks;
+	}
+
+
+	uint64_t GetNumOfDroppedTasks() const
+	{
+		return m_numOfDroppedTasks;
+	}
+
+
+private: // private types:
+
+
+	// shared with the tasks, which may outlive the dispatcher
+	struct InFlightState
+	{
+		InFlightState() :
+			m_mutex(),
+			m_cv(),
+			m_numOfInFlight(0)
+		{}
+
+		std::mutex m_mutex;
+		std::condition_variable m_cv;
+		size_t m_numOfInFlight;
+	}; // struct InFlightState
+
+
+	class DescriptorTask :
+		public Task
+	{
+	public:
+		DescriptorTask(
+			std::shared_ptr<InFlightState> inFlight,
+			Handler handler,
+			std::string payload
+		) :
+			m_inFlight(std::move(inFlight)),
+			m_handler(std::move(handler)),
+			m_payload(std::move(payload))
+		{
+			// no `Finishing` to wait for, so it is out of flight as soon
+			// as it has run
+			SetCompletionMode(CompletionMode::Inline);
+		}
+
+		// LCOV_EXCL_START
+		virtual ~DescriptorTask()
+		{
+			// also when the task is dropped by the executor
+			{
+				std::lock_guard<std::mutex> lock(m_inFlight->m_mutex);
+				--m_inFlight->m_numOfInFlight;
+			}
+			m_inFlight->m_cv.notify_all();
+		}
+		// LCOV_EXCL_STOP
+
+		virtual void Run() override
+		{
+			m_handler(m_payload);
+		}
+
+		virtual void Terminate() override
+		{}
+
+	private:
+		std::shared_ptr<InFlightState> m_inFlight;
+		Handler m_handler;
+		std::string m_payload;
+	}; // class DescriptorTask
+
+
+private: // private functions:
+
+
+	void PullerRunner()
+	{
+		uint32_t handlerId = 0;
+		std::string payload;
+		while (true)
+		{
+			{
+				std::unique_lock<std::mutex> lock(m_inFlight->m_mutex);
+				m_inFlight->m_cv.wait(
+					lock,
+					[this]()
+					{
+						return
+							m_isStopping ||
+							m_inFlight->m_numOfInFlight < m_maxNumOfInFlight;
+					}
+				);
+				if (m_isStopping)
+				{
+					return;
+				}
+			}
+
+			uint32_t numOfPushes = m_queue.GetNumOfPushes();
+			if (!m_queue.TryPop(handlerId, payload))
+			{
+				if (!m_isStopping)
+				{
+					m_queue.WaitForPush(
+						numOfPushes,
+						std::chrono::milliseconds(static_cast<int64_t>(sk_maxWaitMs))
+					);
+				}
+				continue;
+			}
+
+			Dispatch(handlerId, std::move(payload));
+			payload.clear();
+		}
+	}
+
+
+	void Dispatch(uint32_t handlerId, std::string payload)
+	{
+		Handler handler;
+		{
+			std::lock_guard<std::mutex> lock(m_handlersMutex);
+			auto it = m_handlers.find(handlerId);
+			if (it == m_handlers.end())
+			{
+				++m_numOfDroppedTasks;
+				return;
+			}
+			handler = it->second;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_inFlight->m_mutex);
+			++m_inFlight->m_numOfInFlight;
+		}
+		m_executor.AddTask(std::unique_ptr<Task>(
+			new DescriptorTask(m_inFlight, std::move(handler), std::move(payload))
+		));
+		++m_numOfDispatchedTasks;
+	}
+
+
+private:
+
+	SharedMemoryTaskQueue& m_queue;
+	Executor& m_executor;
+	size_t m_maxNumOfInFlight;
+
+	mutable std::mutex m_handlersMutex;
+	std::unordered_map<uint32_t, Handler> m_handlers;
+
+	std::shared_ptr<InFlightState> m_inFlight;
+	std::atomic<uint64_t> m_numOfDispatchedTasks;
+	std::atomic<uint64_t> m_numOfDroppedTasks;
+
+	std::thread m_thread;
+	std::atomic_bool m_isStopping;
+
+}; // class SharedMemoryTaskDispatcher
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
+
+
+#endif // __linux__
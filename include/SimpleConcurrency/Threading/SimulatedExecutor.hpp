@@ -0,0 +1,705 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <tuple>
+#include <unordered_map>
+#include <vector>
+
+#include "Executor.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief How the simulated workers of `SimulatedExecutor` pick the next
+ *        ready task.
+ *
+ */
+enum class SimSchedulingPolicy
+{
+	/**
+	 * @brief One shared queue, in the order tasks become ready.
+	 *
+	 */
+	Fifo,
+
+	/**
+	 * @brief One shared queue, the highest priority first, and in the
+	 *        order tasks become ready among the same priority.
+	 *
+	 */
+	Priority,
+
+	/**
+	 * @brief A queue per worker; a task that becomes ready when its last
+	 *        dependency finishes goes to the worker that ran it, and an
+	 *        arriving task goes to the workers in turn. A worker runs the
+	 *        newest task of its own queue first, and when it has none,
+	 *        steals the oldest task from the longest queue.
+	 *
+	 */
+	WorkStealing,
+}; // enum class SimSchedulingPolicy
+
+
+/**
+ * @brief A task in a trace replayed by `SimulatedExecutor`.
+ *        Times are in virtual time units, e.g., the microseconds of a
+ *        recorded trace.
+ *
+ */
+struct SimTaskRecord
+{
+	uint64_t m_id;
+	uint64_t m_arrivalTime;
+	uint64_t m_cost;
+	int m_priority;
+
+	/**
+	 * @brief The IDs of the tasks that must finish before this one starts.
+	 *
+	 */
+	std::vector<uint64_t> m_dependencies;
+}; // struct SimTaskRecord
+
+
+/**
+ * @brief The results of a run of `SimulatedExecutor`, in virtual time.
+ *
+ */
+struct SimulationReport
+{
+	size_t m_numOfTasks;
+
+	/**
+	 * @brief From the first arrival to the last finish.
+	 *
+	 */
+	uint64_t m_makespan;
+
+	/**
+	 * @brief The latencies of tasks, from their arrivals to their finishes.
+	 *
+	 */
+	double m_meanLatency;
+	uint64_t m_p50Latency;
+	uint64_t m_p99Latency;
+	uint64_t m_maxLatency;
+
+	/**
+	 * @brief The fraction of the makespan the workers were busy.
+	 *
+	 */
+	double m_utilization;
+}; // struct SimulationReport
+
+
+/**
+ * @brief A deterministic executor running in virtual time, for evaluating
+ *        scheduling policies offline, without the noise of wall clock
+ *        benchmarks.
+ *        It replays traces of tasks with arrival times, costs, and
+ *        dependencies (see `SimTaskRecord`), over a number of simulated
+ *        workers; real tasks can be added as well, with given costs, and
+ *        are run by the thread calling `Run`, at their simulated start
+ *        times, so the tasks they add arrive at that virtual time.
+ *        The `Finishing` function of a task is called at its simulated
+ *        finish time.
+ *        It is not thread-safe.
+ *
+ */
+class SimulatedExecutor :
+	public Executor
+{
+public: // static members:
+
+	static constexpr uint64_t sk_defaultCost = 1;
+
+
+	/**
+	 * @brief Replay `trace` with a new executor.
+	 *
+	 */
+	static SimulationReport Replay(
+		const std::vector<SimTaskRecord>& trace,
+		size_t numOfWorkers,
+		SimSchedulingPolicy policy
+	)
+	{
+		SimulatedExecutor executor(numOfWorkers, policy);
+		for (const SimTaskRecord& record : trace)
+		{
+			executor.AddRecord(record);
+		}
+		return executor.Run();
+	}
+
+
+public:
+	SimulatedExecutor(
+		size_t numOfWorkers,
+		SimSchedulingPolicy policy = SimSchedulingPolicy::Fifo
+	) :
+		m_numOfWorkers(numOfWorkers),
+		m_policy(policy),
+		m_isRunning(false),
+		m_now(0),
+		m_nextId(0),
+		m_jobs(),
+		m_jobIdxs(),
+		m_arrivals(),
+		m_finishes(),
+		m_sharedQueue(),
+		m_priorityQueue(),
+		m_workerQueues(numOfWorkers),
+		m_isWorkerBusy(numOfWorkers, false),
+		m_numOfReady(0),
+		m_readySeq(0),
+		m_nextArrivalWorker(0),
+		m_busyTime(0)
+	{
+		if (numOfWorkers == 0)
+		{
+			throw std::invalid_argument(
+				"The number of workers must be greater than 0"
+			);
+		}
+	}
+
+
+	// LCOV_EXCL_START
+	virtual ~SimulatedExecutor() = default;
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Add a task arriving at the current virtual time, with the
+	 *        default cost.
+	 *
+	 */
+	virtual void AddTask(std::unique_ptr<Task> task) override
+	{
+		AddTask(std::move(task), sk_defaultCost);
+	}
+
+
+	/**
+	 * @brief Add a task arriving at the current virtual time.
+	 *
+	 * @return The ID of the task, for other tasks to depend on.
+	 */
+	uint64_t AddTask(
+		std::unique_ptr<Task> task,
+		uint64_t cost,
+		int priority = 0,
+		const std::vector<uint64_t>& dependencies = std::vector<uint64_t>()
+	)
+	{
+		SimTaskRecord record;
+		record.m_id = m_nextId;
+		record.m_arrivalTime = m_now;
+		record.m_cost = cost;
+		record.m_priority = priority;
+		record.m_dependencies = dependencies;
+		AddJob(record, std::move(task));
+		return record.m_id;
+	}
+
+
+	/**
+	 * @brief Add a task of a trace; its arrival time must not be in the
+	 *        past, and its ID must be unique in this run.
+	 *        Its dependencies may be added after it, before `Run`.
+	 *
+	 */
+	void AddRecord(const SimTaskRecord& record)
+	{
+		if (record.m_arrivalTime < m_now)
+		{
+			throw std::invalid_argument("The task arrives in the past");
+		}
+		AddJob(record, nullptr);
+	}
+
+
+	/**
+	 * @brief Simulate until all tasks added are finished.
+	 *
+	 * @return The results of the tasks finished in this run.
+	 */
+	SimulationReport Run()
+	{
+		try
+		{
+			for (size_t i = 0; i < m_jobs.size(); ++i)
+			{
+				ResolveDependencies(i);
+			}
+		}
+		catch(...)
+		{
+			// drop the run, rather than keep the jobs half resolved
+			ClearRun();
+			throw;
+		}
+
+		m_isRunning = true;
+		while (true)
+		{
+			ReleaseArrivals();
+			StartReadyJobs();
+
+			if (m_arrivals.empty() && m_finishes.empty())
+			{
+				break;
+			}
+
+			// advance to the next event
+			uint64_t nextTime = UINT64_MAX;
+			if (!m_arrivals.empty())
+			{
+				nextTime = std::get<0>(m_arrivals.top());
+			}
+			if (!m_finishes.empty())
+			{
+				nextTime = std::min(nextTime, std::get<0>(m_finishes.top()));
+			}
+			m_now = nextTime;
+
+			while (
+				!m_finishes.empty() &&
+				std::get<0>(m_finishes.top()) == m_now
+			)
+			{
+				size_t workerIdx = std::get<1>(m_finishes.top());
+				size_t jobIdx = std::get<2>(m_finishes.top());
+				m_finishes.pop();
+				FinishJob(workerIdx, jobIdx);
+			}
+		}
+
+		m_isRunning = false;
+
+		bool isAllFinished = std::all_of(
+			m_jobs.begin(),
+			m_jobs.end(),
+			[](const Job& job)
+			{
+				return job.m_isFinished;
+			}
+		);
+		SimulationReport report = isAllFinished ?
+			BuildReport() : SimulationReport();
+
+		// a run is over; the virtual time goes on
+		ClearRun();
+
+		if (!isAllFinished)
+		{
+			throw std::runtime_error("The dependencies of tasks are cyclic");
+		}
+		return report;
+	}
+
+
+	uint64_t GetTime() const
+	{
+		return m_now;
+	}
+
+
+private: // private types:
+
+
+	struct Job
+	{
+		SimTaskRecord m_record;
+		std::unique_ptr<Task> m_task;
+
+		bool m_isResolved;
+		bool m_isArrived;
+		bool m_isFinished;
+		size_t m_numOfUnfinishedDeps;
+		std::vector<size_t> m_dependents;
+		uint64_t m_readySeq;
+		uint64_t m_finishTime;
+	}; // struct Job
+
+
+	// (time, worker index or sequence number, job index)
+	using Event = std::tuple<uint64_t, uint64_t, size_t>;
+	using EventQueue = std::priority_queue<
+		Event,
+		std::vector<Event>,
+		std::greater<Event>
+	>;
+
+	// (-priority, ready sequence number, job index)
+	using PriorityEntry = std::tuple<int64_t, uint64_t, size_t>;
+	using PriorityQueue = std::priority_queue<
+		PriorityEntry,
+		std::vector<PriorityEntry>,
+		std::greater<PriorityEntry>
+	>;
+
+
+private: // private functions:
+
+
+	void AddJob(const SimTaskRecord& record, std::unique_ptr<Task> task)
+	{
+		if (m_jobIdxs.find(record.m_id) != m_jobIdxs.end())
+		{
+			throw std::invalid_argument("The task ID is not unique");
+		}
+		if (m_isRunning)
+		{
+			// added while running; check its dependencies before it is
+			// added, so the run goes on without it
+			for (uint64_t depId : record.m_dependencies)
+			{
+				if (m_jobIdxs.find(depId) == m_jobIdxs.end())
+				{
+					throw std::invalid_argument("The dependency is unknown");
+				}
+			}
+		}
+
+		size_t jobIdx = m_jobs.size();
+		m_jobs.emplace_back();
+		Job& job = m_jobs.back();
+		job.m_record = record;
+		job.m_task = std::move(task);
+		job.m_isResolved = false;
+		job.m_isArrived = false;
+		job.m_isFinished = false;
+		job.m_numOfUnfinishedDeps = 0;
+		job.m_readySeq = 0;
+		job.m_finishTime = 0;
+
+		m_jobIdxs[record.m_id] = jobIdx;
+		m_nextId = std::max(m_nextId, record.m_id + 1);
+		m_arrivals.emplace(record.m_arrivalTime, jobIdx, jobIdx);
+
+		if (m_isRunning)
+		{
+			// added while running; its dependencies must be known already
+			ResolveDependencies(jobIdx);
+		}
+	}
+
+
+	void ResolveDependencies(size_t jobIdx)
+	{
+		Job& job = m_jobs[jobIdx];
+		if (job.m_isResolved)
+		{
+			return;
+		}
+		job.m_isResolved = true;
+
+		for (uint64_t depId : job.m_record.m_dependencies)
+		{
+			auto it = m_jobIdxs.find(depId);
+			if (it == m_jobIdxs.end())
+			{
+				throw std::invalid_argument("The dependency is unknown");
+			}
+
+			Job& dep = m_jobs[it->second];
+			if (!dep.m_isFinished)
+			{
+				++job.m_numOfUnfinishedDeps;
+				dep.m_dependents.push_back(jobIdx);
+			}
+		}
+	}
+
+
+	void ClearRun()
+	{
+		m_jobs.clear();
+		m_jobIdxs.clear();
+		m_arrivals = EventQueue();
+		m_finishes = EventQueue();
+		m_sharedQueue.clear();
+		m_priorityQueue = PriorityQueue();
+		for (std::deque<size_t>& workerQueue : m_workerQueues)
+		{
+			workerQueue.clear();
+		}
+		std::fill(m_isWorkerBusy.begin(), m_isWorkerBusy.end(), false);
+		m_numOfReady = 0;
+		m_busyTime = 0;
+	}
+
+
+	void ReleaseArrivals()
+	{
+		while (
+			!m_arrivals.empty() &&
+			std::get<0>(m_arrivals.top()) <= m_now
+		)
+		{
+			size_t jobIdx = std::get<2>(m_arrivals.top());
+			m_arrivals.pop();
+
+			// tasks added while running are resolved already
+			ResolveDependencies(jobIdx);
+
+			Job& job = m_jobs[jobIdx];
+			job.m_isArrived = true;
+			if (job.m_numOfUnfinishedDeps == 0)
+			{
+				PushReady(jobIdx, m_nextArrivalWorker);
+				m_nextArrivalWorker = (m_nextArrivalWorker + 1) % m_numOfWorkers;
+			}
+		}
+	}
+
+
+	void PushReady(size_t jobIdx, size_t workerIdx)
+	{
+		Job& job = m_jobs[jobIdx];
+		job.m_readySeq = m_readySeq++;
+		++m_numOfReady;
+
+		switch (m_policy)
+		{
+		case SimSchedulingPolicy::Priority:
+			m_priorityQueue.emplace(
+				-static_cast<int64_t>(job.m_record.m_priority),
+				job.m_readySeq,
+				jobIdx
+			);
+			break;
+
+		case SimSchedulingPolicy::WorkStealing:
+			m_workerQueues[workerIdx].push_back(jobIdx);
+			break;
+
+		case SimSchedulingPolicy::Fifo:
+		default:
+			m_sharedQueue.push_back(jobIdx);
+			break;
+		}
+	}
+
+
+	bool PopReady(size_t workerIdx, size_t& jobIdx)
+	{
+		if (m_numOfReady == 0)
+		{
+			return false;
+		}
+
+		switch (m_policy)
+		{
+		case SimSchedulingPolicy::Priority:
+			jobIdx = std::get<2>(m_priorityQueue.top());
+			m_priorityQueue.pop();
+			break;
+
+		case SimSchedulingPolicy::WorkStealing:
+		{
+			std::deque<size_t>& ownQueue = m_workerQueues[workerIdx];
+			if (!ownQueue.empty())
+			{
+				jobIdx = ownQueue.back();
+				ownQueue.pop_back();
+				break;
+			}
+
+			size_t victimIdx = 0;
+			for (size_t i = 1; i < m_numOfWorkers; ++i)
+			{
+				if (m_workerQueues[i].size() > m_workerQueues[victimIdx].size())
+				{
+					victimIdx = i;
+				}
+			}
+			jobIdx = m_workerQueues[victimIdx].front();
+			m_workerQueues[victimIdx].pop_front();
+			break;
+		}
+
+		case SimSchedulingPolicy::Fifo:
+		default:
+			jobIdx = m_sharedQueue.front();
+			m_sharedQueue.pop_front();
+			break;
+		}
+
+		--m_numOfReady;
+		return true;
+	}
+
+
+	void StartReadyJobs()
+	{
+		for (size_t workerIdx = 0; workerIdx < m_numOfWorkers; ++workerIdx)
+		{
+			size_t jobIdx = 0;
+			if (m_isWorkerBusy[workerIdx] || !PopReady(workerIdx, jobIdx))
+			{
+				continue;
+			}
+
+			m_isWorkerBusy[workerIdx] = true;
+			uint64_t cost = m_jobs[jobIdx].m_record.m_cost;
+			m_finishes.emplace(m_now + cost, workerIdx, jobIdx);
+			m_busyTime += cost;
+
+			// the task may add more tasks, which arrive now
+			Task* task = m_jobs[jobIdx].m_task.get();
+			if (task != nullptr)
+			{
+				try
+				{
+					task->Run();
+				}
+				catch(...)
+				{
+					task->OnException(std::current_exception());
+				}
+			}
+		}
+	}
+
+
+	void FinishJob(size_t workerIdx, size_t jobIdx)
+	{
+		m_isWorkerBusy[workerIdx] = false;
+
+		Job& job = m_jobs[jobIdx];
+		job.m_isFinished = true;
+		job.m_finishTime = m_now;
+
+		if (job.m_task != nullptr)
+		{
+			try
+			{
+				job.m_task->Finishing();
+			}
+			catch(...)
+			{
+				job.m_task->OnException(std::current_exception());
+			}
+			job.m_task.reset();
+		}
+
+		for (size_t dependentIdx : m_jobs[jobIdx].m_dependents)
+		{
+			Job& dependent = m_jobs[dependentIdx];
+			--dependent.m_numOfUnfinishedDeps;
+			if (dependent.m_numOfUnfinishedDeps == 0 && dependent.m_isArrived)
+			{
+				PushReady(dependentIdx, workerIdx);
+			}
+		}
+	}
+
+
+	SimulationReport BuildReport() const
+	{
+		SimulationReport report = SimulationReport();
+		report.m_numOfTasks = m_jobs.size();
+		if (m_jobs.empty())
+		{
+			return report;
+		}
+
+		uint64_t firstArrival = UINT64_MAX;
+		uint64_t lastFinish = 0;
+		std::vector<uint64_t> latencies;
+		latencies.reserve(m_jobs.size());
+		for (const Job& job : m_jobs)
+		{
+			firstArrival = std::min(firstArrival, job.m_record.m_arrivalTime);
+			lastFinish = std::max(lastFinish, job.m_finishTime);
+			latencies.push_back(job.m_finishTime - job.m_record.m_arrivalTime);
+		}
+		std::sort(latencies.begin(), latencies.end());
+
+		double sum = 0.0;
+		for (uint64_t latency : latencies)
+		{
+			sum += static_cast<double>(latency);
+		}
+
+		report.m_makespan = lastFinish - firstArrival;
+		report.m_meanLatency = sum / static_cast<double>(latencies.size());
+		report.m_p50Latency = Percentile(latencies, 50);
+		report.m_p99Latency = Percentile(latencies, 99);
+		report.m_maxLatency = latencies.back();
+		report.m_utilization = report.m_makespan == 0 ?
+			0.0 :
+			static_cast<double>(m_busyTime) /
+				(static_cast<double>(report.m_makespan) * m_numOfWorkers);
+		return report;
+	}
+
+
+	static uint64_t Percentile(
+		const std::vector<uint64_t>& sortedVals,
+		size_t percent
+	)
+	{
+		// nearest-rank
+		size_t rank = (sortedVals.size() * percent + 99) / 100;
+		return sortedVals[rank > 0 ? rank - 1 : 0];
+	}
+
+
+private:
+
+	size_t m_numOfWorkers;
+	SimSchedulingPolicy m_policy;
+	bool m_isRunning;
+	uint64_t m_now;
+	uint64_t m_nextId;
+
+	// a deque, so tasks can be added while others are referenced
+	std::deque<Job> m_jobs;
+	std::unordered_map<uint64_t, size_t> m_jobIdxs;
+
+	EventQueue m_arrivals;
+	EventQueue m_finishes;
+
+	std::deque<size_t> m_sharedQueue;
+	PriorityQueue m_priorityQueue;
+	std::vector<std::deque<size_t> > m_workerQueues;
+	std::vector<bool> m_isWorkerBusy;
+	size_t m_numOfReady;
+	uint64_t m_readySeq;
+	size_t m_nextArrivalWorker;
+
+	uint64_t m_busyTime;
+
+}; // class SimulatedExecutor
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
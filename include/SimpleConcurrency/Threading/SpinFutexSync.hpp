@@ -0,0 +1,258 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <climits>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+#include "PollingBackoff.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+#ifdef __linux__
+
+
+/**
+ * @brief The backend of the spin-futex primitives that sleeps and wakes
+ *        with the futex syscall. Inside an enclave, a backend would make
+ *        an OCALL to do the same.
+ *        A backend provides:
+ *        - `Wait(word, expected)`, which sleeps unless `*word != expected`,
+ *          and may return spuriously
+ *        - `Wake(word, num)`, which wakes up to `num` threads sleeping on
+ *          `word`
+ *
+ */
+struct FutexSyncBackend
+{
+	static void Wait(std::atomic<uint32_t>& word, uint32_t expected)
+	{
+		syscall(
+			SYS_futex, reinterpret_cast<uint32_t*>(&word),
+			FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0
+		);
+	}
+
+
+	static void Wake(std::atomic<uint32_t>& word, int num)
+	{
+		syscall(
+			SYS_futex, reinterpret_cast<uint32_t*>(&word),
+			FUTEX_WAKE_PRIVATE, num, nullptr, nullptr, 0
+		);
+	}
+}; // struct FutexSyncBackend
+
+
+#endif // __linux__
+
+
+/**
+ * @brief A mutex that spins for a while before it sleeps, and only calls
+ *        its backend to sleep or wake when the lock is contended, so an
+ *        uncontended or briefly held lock costs no syscall (or OCALL).
+ *
+ * @tparam _Backend How to sleep and wake (see `FutexSyncBackend`).
+ */
+template<typename _Backend>
+class BasicSpinFutexMutex
+{
+public: // static members:
+
+	static constexpr size_t sk_numOfSpins = 128;
+
+
+public:
+	BasicSpinFutexMutex() :
+		m_state(sk_unlocked)
+	{}
+
+
+	BasicSpinFutexMutex(const BasicSpinFutexMutex&) = delete;
+
+	BasicSpinFutexMutex& operator=(const BasicSpinFutexMutex&) = delete;
+
+
+	void lock()
+	{
+		for (size_t i = 0; i < sk_numOfSpins; ++i)
+		{
+			if (try_lock())
+			{
+				return;
+			}
+			// not `yield`, which is a syscall (or an OCALL) too
+			PollingBackoff::CpuRelax();
+		}
+
+		// mark it as contended, so the owner wakes a sleeper on unlock
+		while (m_state.exchange(sk_contended) != sk_unlocked)
+		{
+			_Backend::Wait(m_state, sk_contended);
+		}
+	}
+
+
+	bool try_lock()
+	{
+		uint32_t expected = sk_unlocked;
+		return m_state.compare_exchange_strong(expected, sk_locked);
+	}
+
+
+	void unlock()
+	{
+		if (m_state.exchange(sk_unlocked) == sk_contended)
+		{
+			_Backend::Wake(m_state, 1);
+		}
+	}
+
+
+private: // static members:
+
+	static constexpr uint32_t sk_unlocked = 0;
+	static constexpr uint32_t sk_locked = 1;
+	static constexpr uint32_t sk_contended = 2;
+
+
+private:
+
+	std::atomic<uint32_t> m_state;
+
+}; // class BasicSpinFutexMutex
+
+
+/**
+ * @brief A condition variable that spins for a while before it sleeps,
+ *        and only calls its backend to wake when there are sleepers, so a
+ *        notification nobody sleeps for costs no syscall (or OCALL);
+ *        `notify_all` wakes all sleepers in one call.
+ *
+ * @tparam _Backend How to sleep and wake (see `FutexSyncBackend`).
+ */
+template<typename _Backend>
+class BasicSpinFutexConditionVariable
+{
+public: // static members:
+
+	static constexpr size_t sk_numOfSpins = 128;
+
+
+public:
+	BasicSpinFutexConditionVariable() :
+		m_seq(0),
+		m_numOfSleepers(0)
+	{}
+
+
+	BasicSpinFutexConditionVariable(const BasicSpinFutexConditionVariable&) =
+		delete;
+
+	BasicSpinFutexConditionVariable& operator=(
+		const BasicSpinFutexConditionVariable&
+	) = delete;
+
+
+	/**
+	 * @brief Wait for a notification; it may return spuriously.
+	 *
+	 */
+	template<typename _LockType>
+	void wait(_LockType& lock)
+	{
+		// a notification after this point changes the sequence
+		uint32_t seq = m_seq.load();
+		lock.unlock();
+
+		for (size_t i = 0; i < sk_numOfSpins && m_seq.load() == seq; ++i)
+		{
+			PollingBackoff::CpuRelax();
+		}
+
+		if (m_seq.load() == seq)
+		{
+			++m_numOfSleepers;
+			// returns right away if notified since
+			_Backend::Wait(m_seq, seq);
+			--m_numOfSleepers;
+		}
+
+		lock.lock();
+	}
+
+
+	template<typename _LockType, typename _PredType>
+	void wait(_LockType& lock, _PredType pred)
+	{
+		while (!pred())
+		{
+			wait(lock);
+		}
+	}
+
+
+	void notify_one()
+	{
+		++m_seq;
+		if (m_numOfSleepers.load() > 0)
+		{
+			_Backend::Wake(m_seq, 1);
+		}
+	}
+
+
+	void notify_all()
+	{
+		++m_seq;
+		if (m_numOfSleepers.load() > 0)
+		{
+			_Backend::Wake(m_seq, INT_MAX);
+		}
+	}
+
+
+private:
+
+	std::atomic<uint32_t> m_seq;
+	std::atomic<uint32_t> m_numOfSleepers;
+
+}; // class BasicSpinFutexConditionVariable
+
+
+#ifdef __linux__
+
+
+using SpinFutexMutex = BasicSpinFutexMutex<FutexSyncBackend>;
+
+using SpinFutexConditionVariable =
+	BasicSpinFutexConditionVariable<FutexSyncBackend>;
+
+
+#endif // __linux__
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
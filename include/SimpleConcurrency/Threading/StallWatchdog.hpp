@@ -0,0 +1,225 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ThreadPoolBase.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief Watches the tasks run by a pool in a thread of its own, and
+ *        reports each task that has been running longer than a threshold,
+ *        e.g., one hanging in its `Run` function, which otherwise silently
+ *        takes a worker away, and keeps `Terminate` from returning.
+ *        Each run of a task is reported once, when it is first found over
+ *        the threshold.
+ *        A `BasicThreadPool` only reports its running tasks if its
+ *        statistics policy tracks them (`sk_isTrackingRunningTasks`), e.g.,
+ *        `CountingStatsPolicy`.
+ *
+ */
+class StallWatchdog
+{
+public:
+
+	using Callback = std::function<void(const RunningTaskInfo&)>;
+
+
+	/**
+	 * @param pool The pool to watch.
+	 * @param threshold How long a task can run before it is reported.
+	 * @param interval How often to check.
+	 * @param callback Called in the watchdog thread for each task found
+	 *                 over the threshold.
+	 */
+	StallWatchdog(
+		const ThreadPoolBase& pool,
+		std::chrono::nanoseconds threshold,
+		std::chrono::milliseconds interval,
+		Callback callback
+	) :
+		m_pool(pool),
+		m_threshold(threshold),
+		m_interval(interval),
+		m_callback(std::move(callback)),
+		m_reportedRuns(),
+		m_numOfReports(0),
+		m_mutex(),
+		m_cv(),
+		m_isStopping(false),
+		m_thread()
+	{
+		m_thread = std::thread(
+			[this]()
+			{
+				WatchdogRunner();
+			}
+		);
+	}
+
+
+	StallWatchdog(const StallWatchdog&) = delete;
+
+	StallWatchdog& operator=(const StallWatchdog&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~StallWatchdog()
+	{
+		Stop();
+	}
+	// LCOV_EXCL_STOP
+
+
+	void Stop()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_isStopping = true;
+		}
+		m_cv.notify_all();
+
+		if (m_thread.joinable())
+		{
+			m_thread.join();
+		}
+	}
+
+
+	/**
+	 * @brief Get the tasks running longer than the threshold right now.
+	 *
+	 */
+	std::vector<RunningTaskInfo> GetStalledTasks() const
+	{
+		std::vector<RunningTaskInfo> stalledTasks;
+		for (const auto& info : m_pool.GetRunningTasks())
+		{
+			if (info.m_runTime >= m_threshold)
+			{
+				stalledTasks.push_back(info);
+			}
+		}
+		return stalledTasks;
+	}
+
+
+	/**
+	 * @brief Get the number of tasks reported so far.
+	 *
+	 */
+	uint64_t GetNumOfReports() const
+	{
+		return m_numOfReports;
+	}
+
+
+private: // private functions:
+
+
+	/**
+	 * @brief Find the stalled tasks not reported yet.
+	 *
+	 */
+	std::vector<RunningTaskInfo> Check()
+	{
+		std::vector<RunningTaskInfo> newlyStalledTasks;
+		std::map<std::thread::id, uint64_t> reportedRuns;
+		for (const auto& info : GetStalledTasks())
+		{
+			auto it = m_reportedRuns.find(info.m_threadId);
+			if (it == m_reportedRuns.end() || it->second != info.m_runIndex)
+			{
+				newlyStalledTasks.push_back(info);
+			}
+			reportedRuns[info.m_threadId] = info.m_runIndex;
+		}
+
+		// forget the tasks that are done
+		m_reportedRuns.swap(reportedRuns);
+		return newlyStalledTasks;
+	}
+
+
+	void WatchdogRunner()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		while (!m_isStopping)
+		{
+			std::vector<RunningTaskInfo> newlyStalledTasks = Check();
+
+			// the callback is user code, which may take any lock of its
+			// own, so it is not run under the lock of the watchdog
+			lock.unlock();
+			for (const auto& info : newlyStalledTasks)
+			{
+				++m_numOfReports;
+				try
+				{
+					m_callback(info);
+				}
+				catch(...)
+				{
+					// keep watching
+				}
+			}
+			lock.lock();
+
+			m_cv.wait_for(
+				lock,
+				m_interval,
+				[this]()
+				{
+					return m_isStopping;
+				}
+			);
+		}
+	}
+
+
+private:
+
+	const ThreadPoolBase& m_pool;
+	std::chrono::nanoseconds m_threshold;
+	std::chrono::milliseconds m_interval;
+	Callback m_callback;
+
+	// only accessed by the watchdog thread
+	std::map<std::thread::id, uint64_t> m_reportedRuns;
+	std::atomic<uint64_t> m_numOfReports;
+
+	std::mutex m_mutex;
+	std::condition_variable m_cv;
+	bool m_isStopping;
+	std::thread m_thread;
+
+}; // class StallWatchdog
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
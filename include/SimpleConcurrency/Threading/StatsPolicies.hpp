@@ -0,0 +1,197 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <chrono>
+
+#include "Task.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief The statistics policy of `BasicThreadPool` that collects nothing;
+ *        all of its hooks are empty, so they are compiled out.
+ *        A statistics policy is a base class of the pool, so its public
+ *        functions are part of the interface of the pool; it provides to
+ *        the pool:
+ *        - `sk_isTimingTasks`, whether the pool keeps the recent queue and
+ *          run times of the tasks, for its wait time estimate; it costs
+ *          a few more clock reads per task
+ *        - `sk_isTrackingRunningTasks`, whether the workers publish the
+ *          task they are running, for `GetRunningTasks`, e.g., for a
+ *          `StallWatchdog`; it costs a clock read and a few stores per task
+ *        - `RunContext`, the per-run state a worker keeps for it
+ *        - `OnTaskAdded(task)`, called when a task is added
+ *        - `OnTaskRunBegin(task)`, called right before a task runs, which
+ *          returns a `RunContext`
+ *        - `OnTaskRunEnd(task, runContext, hasThrown)`, called right after
+ *          a task has run, before it is completed
+ *
+ */
+class NoStatsPolicy
+{
+public: // static members:
+
+	static constexpr bool sk_isTimingTasks = false;
+
+	static constexpr bool sk_isTrackingRunningTasks = false;
+
+
+public:
+	NoStatsPolicy() = default;
+
+
+protected:
+
+	// only destroyed as a base of the pool, so it is not virtual
+	~NoStatsPolicy() = default;
+
+
+protected: // types:
+
+
+	struct RunContext
+	{}; // struct RunContext
+
+
+protected:
+
+
+	void OnTaskAdded(const Task&)
+	{}
+
+
+	RunContext OnTaskRunBegin(const Task&)
+	{
+		return RunContext();
+	}
+
+
+	void OnTaskRunEnd(const Task&, const RunContext&, bool)
+	{}
+
+}; // class NoStatsPolicy
+
+
+/**
+ * @brief The statistics policy of `BasicThreadPool` that counts the tasks
+ *        added and run, and sums up their running time.
+ *
+ */
+class CountingStatsPolicy
+{
+public: // static members:
+
+	static constexpr bool sk_isTimingTasks = true;
+
+	static constexpr bool sk_isTrackingRunningTasks = true;
+
+
+public:
+	CountingStatsPolicy() :
+		m_numOfTasksAdded(0),
+		m_numOfTasksRun(0),
+		m_totalRunTimeNs(0)
+	{}
+
+
+protected:
+
+	~CountingStatsPolicy() = default;
+
+
+public:
+
+
+	uint64_t GetNumOfTasksAdded() const
+	{
+		return m_numOfTasksAdded;
+	}
+
+
+	uint64_t GetNumOfTasksRun() const
+	{
+		return m_numOfTasksRun;
+	}
+
+
+	/**
+	 * @brief Get the total time spent in the `Run` functions of the tasks,
+	 *        over all workers.
+	 *
+	 */
+	std::chrono::nanoseconds GetTotalRunTime() const
+	{
+		return std::chrono::nanoseconds(m_totalRunTimeNs.load());
+	}
+
+
+protected: // types:
+
+
+	struct RunContext
+	{
+		std::chrono::steady_clock::time_point m_beginTime;
+	}; // struct RunContext
+
+
+protected:
+
+
+	void OnTaskAdded(const Task&)
+	{
+		m_numOfTasksAdded.fetch_add(1, std::memory_order_relaxed);
+	}
+
+
+	RunContext OnTaskRunBegin(const Task&)
+	{
+		RunContext context;
+		context.m_beginTime = std::chrono::steady_clock::now();
+		return context;
+	}
+
+
+	void OnTaskRunEnd(const Task&, const RunContext& context, bool)
+	{
+		auto runTime = std::chrono::steady_clock::now() - context.m_beginTime;
+		m_totalRunTimeNs.fetch_add(
+			static_cast<uint64_t>(
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+					runTime
+				).count()
+			),
+			std::memory_order_relaxed
+		);
+		m_numOfTasksRun.fetch_add(1, std::memory_order_relaxed);
+	}
+
+
+private:
+
+	std::atomic<uint64_t> m_numOfTasksAdded;
+	std::atomic<uint64_t> m_numOfTasksRun;
+	std::atomic<uint64_t> m_totalRunTimeNs;
+
+}; // class CountingStatsPolicy
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
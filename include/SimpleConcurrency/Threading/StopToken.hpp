@@ -0,0 +1,133 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "SyncPrimitives.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A flag telling something to stop, e.g., a thread adopted by a
+ *        pool to leave it (see `BasicThreadPool::JoinAsWorker`).
+ *        Copies share the same flag, so one token can stop many threads.
+ *        Whoever waits for the stop can register a callback to be woken.
+ *
+ */
+class StopToken
+{
+public:
+
+	using Callback = std::function<void()>;
+
+
+	StopToken() :
+		m_state(std::make_shared<State>())
+	{}
+
+
+	/**
+	 * @brief Request the stop, and call the registered callbacks;
+	 *        only the first request has an effect.
+	 *
+	 */
+	void RequestStop() const
+	{
+		std::lock_guard<Mutex> lock(m_state->m_mutex);
+		if (m_state->m_isStopRequested.exchange(true))
+		{
+			return;
+		}
+		for (auto& callback : m_state->m_callbacks)
+		{
+			callback.second();
+		}
+	}
+
+
+	bool IsStopRequested() const
+	{
+		return m_state->m_isStopRequested;
+	}
+
+
+	/**
+	 * @brief Register a callback, which is called by `RequestStop`, or
+	 *        right away if the stop is already requested.
+	 *
+	 * @return The ID to remove the callback with.
+	 */
+	uint64_t AddCallback(Callback callback) const
+	{
+		std::lock_guard<Mutex> lock(m_state->m_mutex);
+		if (m_state->m_isStopRequested)
+		{
+			callback();
+		}
+		uint64_t id = m_state->m_nextCallbackId++;
+		m_state->m_callbacks.emplace(id, std::move(callback));
+		return id;
+	}
+
+
+	/**
+	 * @brief Remove a callback; once it returns, the callback is not
+	 *        called anymore.
+	 *
+	 */
+	void RemoveCallback(uint64_t id) const
+	{
+		std::lock_guard<Mutex> lock(m_state->m_mutex);
+		m_state->m_callbacks.erase(id);
+	}
+
+
+private: // private types:
+
+
+	struct State
+	{
+		State() :
+			m_mutex(),
+			m_isStopRequested(false),
+			m_nextCallbackId(0),
+			m_callbacks()
+		{}
+
+		Mutex m_mutex;
+		std::atomic_bool m_isStopRequested;
+		uint64_t m_nextCallbackId;
+		std::map<uint64_t, Callback> m_callbacks;
+	}; // struct State
+
+
+private:
+
+	std::shared_ptr<State> m_state;
+
+}; // class StopToken
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,64 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+
+/**
+ * The mutex, condition variable, and thread types used by the thread pool
+ * (`BasicThreadPool`, its policies, and `TaskRunner`), which can be
+ * replaced by defining these macros before including any header of this
+ * library, e.g., where sleeping on a `std::mutex` is expensive, as each
+ * sleep and wake is an OCALL in an SGX enclave (see `SpinFutexSync.hpp`):
+ *
+ * - `SIMPLECONCURRENCY_CUSTOMIZED_MUTEX`: lockable by `std::unique_lock`
+ * - `SIMPLECONCURRENCY_CUSTOMIZED_CONDITION_VARIABLE`: with
+ *   `wait(std::unique_lock<Mutex>&, pred)`, `notify_one()`, and
+ *   `notify_all()`
+ * - `SIMPLECONCURRENCY_CUSTOMIZED_THREAD`: movable, constructible from a
+ *   callable, with `joinable()` and `join()`
+ *
+ * The same definitions must be used in the whole program.
+ */
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_MUTEX
+using Mutex = std::mutex;
+#else
+using Mutex = SIMPLECONCURRENCY_CUSTOMIZED_MUTEX;
+#endif
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_CONDITION_VARIABLE
+using ConditionVariable = std::condition_variable;
+#else
+using ConditionVariable = SIMPLECONCURRENCY_CUSTOMIZED_CONDITION_VARIABLE;
+#endif
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_THREAD
+using Thread = std::thread;
+#else
+using Thread = SIMPLECONCURRENCY_CUSTOMIZED_THREAD;
+#endif
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
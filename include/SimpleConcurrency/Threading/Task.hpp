@@ -6,7 +6,9 @@
 #pragma once
 
 
+#include <chrono>
 #include <exception>
+#include <thread>
 
 
 #ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
@@ -19,10 +21,76 @@ namespace Threading
 {
 
 
+/**
+ * @brief Where the `Finishing` function of a task is called.
+ *
+ */
+enum class CompletionMode
+{
+	/**
+	 * @brief Only valid for a task; use the completion mode of the pool.
+	 *
+	 */
+	UsePoolDefault,
+
+	/**
+	 * @brief In whichever thread calls `ThreadPool::Update`.
+	 *
+	 */
+	Update,
+
+	/**
+	 * @brief In the worker thread, right after the `Run` function.
+	 *
+	 */
+	Inline,
+
+	/**
+	 * @brief In the thread that submitted the task, when it calls
+	 *        `ThreadPool::Update`.
+	 *        NOTE: the task is held for that thread only; if it never calls
+	 *        `Update` again, e.g., because it has exited, the task is never
+	 *        finished, and stays counted by `GetNumOfFinishedTasks`.
+	 *
+	 */
+	UpdateOnSubmitter,
+
+	/**
+	 * @brief In a completion thread dedicated to the pool.
+	 *
+	 */
+	DedicatedThread,
+
+	/**
+	 * @brief As a task submitted to the completion executor of the pool.
+	 *
+	 */
+	OnExecutor,
+}; // enum class CompletionMode
+
+
+class IntrusiveTaskQueue;
+class IntrusiveTaskStack;
+
+
 class Task
 {
+public: // types:
+
+	using Clock = std::chrono::steady_clock;
+	using TimePoint = Clock::time_point;
+
+
 public:
-	Task() = default;
+	Task() :
+		m_completionMode(CompletionMode::UsePoolDefault),
+		m_submitterThreadId(),
+		m_enqueueTime(),
+		m_deadline(TimePoint::max()),
+		m_tag(nullptr),
+		m_queuePrev(nullptr),
+		m_queueNext(nullptr)
+	{}
 
 	// LCOV_EXCL_START
 	virtual ~Task() = default;
@@ -67,6 +135,131 @@ public:
 	{}
 
 
+	/**
+	 * @brief This function is called instead of `Run` and `Finishing`, by
+	 *        the worker about to run this task, when the deadline of the
+	 *        task has passed while it was waiting in the queue.
+	 *
+	 */
+	virtual void OnExpired()
+	{}
+
+
+	/**
+	 * @brief Choose where the `Finishing` function of this task is called,
+	 *        overriding the completion mode of the pool.
+	 *
+	 */
+	void SetCompletionMode(CompletionMode mode)
+	{
+		m_completionMode = mode;
+	}
+
+
+	CompletionMode GetCompletionMode() const
+	{
+		return m_completionMode;
+	}
+
+
+	/**
+	 * @brief Record the thread submitting this task; this is set by the
+	 *        pool when it needs to route the task back to that thread.
+	 *
+	 */
+	void SetSubmitterThreadId(std::thread::id threadId)
+	{
+		m_submitterThreadId = threadId;
+	}
+
+
+	std::thread::id GetSubmitterThreadId() const
+	{
+		return m_submitterThreadId;
+	}
+
+
+	/**
+	 * @brief Set the latest time this task may start at; if it is still
+	 *        pending by then, it is dropped, and `OnExpired` is called
+	 *        instead. By default, a task has no deadline.
+	 *
+	 */
+	void SetDeadline(TimePoint deadline)
+	{
+		m_deadline = deadline;
+	}
+
+
+	TimePoint GetDeadline() const
+	{
+		return m_deadline;
+	}
+
+
+	bool HasDeadline() const
+	{
+		return m_deadline != TimePoint::max();
+	}
+
+
+	bool IsExpired(TimePoint now) const
+	{
+		return now > m_deadline;
+	}
+
+
+	/**
+	 * @brief Record when this task is queued; this is set by the pool.
+	 *
+	 */
+	void SetEnqueueTime(TimePoint enqueueTime)
+	{
+		m_enqueueTime = enqueueTime;
+	}
+
+
+	TimePoint GetEnqueueTime() const
+	{
+		return m_enqueueTime;
+	}
+
+
+	/**
+	 * @brief Give this task a tag, so that tasks of different types can
+	 *        be grouped together, e.g., by `ProfilingStatsPolicy`.
+	 *        Tags are compared by address, so they should be string
+	 *        literals, or other strings that live as long as the program.
+	 *
+	 */
+	void SetTag(const char* tag)
+	{
+		m_tag = tag;
+	}
+
+
+	const char* GetTag() const
+	{
+		return m_tag;
+	}
+
+
+private:
+
+	friend class IntrusiveTaskQueue;
+	friend class IntrusiveTaskStack;
+
+	CompletionMode m_completionMode;
+	std::thread::id m_submitterThreadId;
+	TimePoint m_enqueueTime;
+	TimePoint m_deadline;
+	const char* m_tag;
+
+	// links of the queue holding this task, so that queuing a task
+	// doesn't allocate (see `IntrusiveTaskQueue` and `IntrusiveTaskStack`)
+	Task* m_queuePrev;
+	Task* m_queueNext;
+
 }; // class Task
 
 
@@ -0,0 +1,255 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+
+#include "ScopedBlocking.hpp"
+#include "SyncPrimitives.hpp"
+#include "ThreadPoolBase.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A group of tasks spawned on a pool, which can be waited for
+ *        together, e.g., the subtasks of a divide-and-conquer task.
+ *        When `Wait` is called on a worker of the pool, the worker runs
+ *        pending tasks until the group is done, so waiting never holds up
+ *        a worker, and recursive groups do not deadlock the pool.
+ *
+ */
+class TaskGroup
+{
+public:
+
+	TaskGroup(ThreadPoolBase& pool) :
+		m_pool(pool),
+		m_mutex(),
+		m_doneCV(),
+		m_numOfUnfinished(0),
+		m_numOfSpawned(0),
+		m_numOfHelpers(0),
+		m_exception()
+	{}
+
+
+	TaskGroup(const TaskGroup&) = delete;
+
+	TaskGroup& operator=(const TaskGroup&) = delete;
+
+
+	// LCOV_EXCL_START
+	virtual ~TaskGroup()
+	{
+		try
+		{
+			Wait();
+		}
+		catch(...)
+		{
+			// the exception is dropped if nobody waits for the group
+		}
+	}
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Run `func` on the pool, as a part of this group; if the pool
+	 *        is terminated, `func` is run right away in the calling thread
+	 *        instead, as the pool would never run it.
+	 *        NOTE: the pool must not be terminated while tasks are spawned.
+	 *
+	 */
+	template<typename _FuncType>
+	void Spawn(_FuncType func)
+	{
+		++m_numOfUnfinished;
+
+		std::unique_ptr<Task> task(new GroupTask<_FuncType>(*this, std::move(func)));
+		if (m_pool.IsTerminated())
+		{
+			task->Run();
+			return;
+		}
+
+		// nothing to finish, so don't leave it to `ThreadPool::Update`
+		task->SetCompletionMode(CompletionMode::Inline);
+		m_pool.AddTask(std::move(task));
+
+		// wake the workers waiting for this group, to help with it
+		++m_numOfSpawned;
+		if (m_numOfHelpers > 0)
+		{
+			std::lock_guard<Mutex> lock(m_mutex);
+			m_doneCV.notify_all();
+		}
+	}
+
+
+	/**
+	 * @brief Wait for all tasks spawned so far to finish; on a worker of the
+	 *        pool, pending tasks are run meanwhile.
+	 *        If any of them threw, the first exception is rethrown.
+	 *
+	 */
+	void Wait()
+	{
+		if (ThreadPoolBase::GetCurrent() == &m_pool)
+		{
+			HelpUntilDone();
+		}
+
+		std::exception_ptr exception;
+		{
+			// the last task may still be notifying; wait for it to let go
+			// of the group
+			std::unique_lock<Mutex> lock(m_mutex);
+			m_doneCV.wait(
+				lock,
+				[this]()
+				{
+					return m_numOfUnfinished == 0;
+				}
+			);
+			exception = m_exception;
+			m_exception = nullptr;
+		}
+
+		if (exception)
+		{
+			std::rethrow_exception(exception);
+		}
+	}
+
+
+	size_t GetNumOfUnfinished() const
+	{
+		return m_numOfUnfinished;
+	}
+
+
+private: // private types:
+
+
+	template<typename _FuncType>
+	class GroupTask :
+		public Task
+	{
+	public:
+		GroupTask(TaskGroup& group, _FuncType func) :
+			m_group(group),
+			m_func(std::move(func))
+		{}
+
+		// LCOV_EXCL_START
+		virtual ~GroupTask() = default;
+		// LCOV_EXCL_STOP
+
+		virtual void Run() override
+		{
+			std::exception_ptr exception;
+			try
+			{
+				m_func();
+			}
+			catch(...)
+			{
+				exception = std::current_exception();
+			}
+			m_group.OnTaskFinished(exception);
+		}
+
+		virtual void Terminate() override
+		{}
+
+	private:
+		TaskGroup& m_group;
+		_FuncType m_func;
+	}; // class GroupTask
+
+
+private: // private functions:
+
+
+	void HelpUntilDone()
+	{
+		// counted before checking for tasks, so a task spawned after the
+		// check always wakes this worker
+		++m_numOfHelpers;
+		while (m_numOfUnfinished > 0)
+		{
+			uint64_t numOfSpawned = m_numOfSpawned;
+			if (m_pool.RunPendingTask())
+			{
+				continue;
+			}
+
+			// the rest are being run by other workers; sleep until they
+			// are done, or more tasks are spawned, and let the pool run
+			// another worker meanwhile
+			ScopedBlocking blocking;
+			std::unique_lock<Mutex> lock(m_mutex);
+			m_doneCV.wait(
+				lock,
+				[this, numOfSpawned]()
+				{
+					return
+						(m_numOfUnfinished == 0) ||
+						(m_numOfSpawned != numOfSpawned);
+				}
+			);
+		}
+		--m_numOfHelpers;
+	}
+
+
+	void OnTaskFinished(std::exception_ptr exception)
+	{
+		std::lock_guard<Mutex> lock(m_mutex);
+		if (exception && !m_exception)
+		{
+			m_exception = exception;
+		}
+		if (--m_numOfUnfinished == 0)
+		{
+			m_doneCV.notify_all();
+		}
+	}
+
+
+private:
+
+	ThreadPoolBase& m_pool;
+
+	Mutex m_mutex;
+	ConditionVariable m_doneCV;
+	std::atomic<size_t> m_numOfUnfinished;
+	// tells the workers helping with the group about new tasks
+	std::atomic<uint64_t> m_numOfSpawned;
+	std::atomic<size_t> m_numOfHelpers;
+	std::exception_ptr m_exception;
+
+}; // class TaskGroup
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -7,10 +7,10 @@
 
 
 #include <atomic>
-#include <condition_variable>
 #include <memory>
 #include <mutex>
 
+#include "SyncPrimitives.hpp"
 #include "Task.hpp"
 
 
@@ -30,10 +30,12 @@ public:
 	TaskRunner() :
 		m_taskMutex(),
 		m_taskCV(),
+		m_taskPtrMutex(),
 		m_task(),
 		m_isTerminated(false),
 		m_isTerminating(false),
-		m_isThreadTaskFinished(false)
+		m_isThreadTaskFinished(false),
+		m_hasTaskThrown(false)
 	{}
 
 	// LCOV_EXCL_START
@@ -50,18 +52,22 @@ public:
 	{
 		while(!m_isTerminating)
 		{
-			// wait until there is a task to run
-			std::unique_lock<std::mutex> lock(m_taskMutex);
-			m_taskCV.wait(
-				lock,
-				[this]() {
-					return
-						(m_task != nullptr) ||
-						m_isTerminating;
-				}
-			);
+			{
+				// wait until there is a task to run
+				std::unique_lock<Mutex> lock(m_taskMutex);
+				m_taskCV.wait(
+					lock,
+					[this]() {
+						return
+							(m_task != nullptr) ||
+							m_isTerminating;
+					}
+				);
+			}
 
-			// mutex is locked again here
+			// the task is run without holding the mutex, so it may take
+			// any other lock, e.g., one the pool holds while assigning
+			// a task to another task runner
 
 			if (!m_isTerminating)
 			{
@@ -73,8 +79,13 @@ public:
 
 					// this task is finished, notify the caller,
 					// and try to get a new task
+					std::unique_ptr<Task> finishedTask;
+					{
+						std::lock_guard<Mutex> ptrLock(m_taskPtrMutex);
+						finishedTask = std::move(m_task);
+					}
 					task = finishCallback(
-						this, std::move(m_task)
+						this, std::move(finishedTask)
 					);
 				}
 				catch(...)
@@ -95,6 +106,7 @@ public:
 				// in the next loop
 				// otherwise, instead of waiting, we will run the new task
 				// in the next loop
+				std::lock_guard<Mutex> ptrLock(m_taskPtrMutex);
 				m_task = std::move(task);
 			}
 
@@ -110,9 +122,16 @@ public:
 	{
 		// first let other thread know that it's terminating
 		m_isTerminating = true;
-		// in case the other thread is waiting for a task, notify it
+		// in case the other thread is waiting for a task, notify it;
+		// taking the mutex makes sure it is either still before its check,
+		// or waiting
+		{
+			std::lock_guard<Mutex> lock(m_taskMutex);
+		}
 		m_taskCV.notify_all();
-		// in case the thread is already running the task, terminate it
+		// in case the thread is already running the task, terminate it;
+		// the task may be replaced by the other thread at the same time
+		std::lock_guard<Mutex> ptrLock(m_taskPtrMutex);
 		if (m_task)
 		{
 			m_task->Terminate();
@@ -122,12 +141,15 @@ public:
 
 	void AssignTask(std::unique_ptr<Task> task)
 	{
-		std::lock_guard<std::mutex> lock(m_taskMutex);
-		// the mutex is locked by this thread (i.e., not locked by other thread)
-		// so the other thread must be waiting for a task
+		std::lock_guard<Mutex> lock(m_taskMutex);
+		// a task is only assigned to a task runner that is not running one,
+		// so the other thread must be waiting for a task, or not started
 
 		// assign the task
-		m_task = std::move(task);
+		{
+			std::lock_guard<Mutex> ptrLock(m_taskPtrMutex);
+			m_task = std::move(task);
+		}
 
 		// notify the other thread that there is a task to run
 		m_taskCV.notify_all();
@@ -140,18 +162,33 @@ public:
 	}
 
 
+	/**
+	 * @brief Whether the `Run` function of the last task threw;
+	 *        only meaningful in the thread running the tasks.
+	 *
+	 */
+	bool HasTaskThrown() const
+	{
+		return m_hasTaskThrown;
+	}
+
+
 protected:
 
 
 	void ResetTaskNonLocking()
 	{
-		m_task.reset();
+		{
+			std::lock_guard<Mutex> ptrLock(m_taskPtrMutex);
+			m_task.reset();
+		}
 		m_isThreadTaskFinished = false;
 	}
 
 
 	void RunThreadTask()
 	{
+		m_hasTaskThrown = false;
 		if (m_task)
 		{
 			try
@@ -161,6 +198,7 @@ protected:
 			catch(...)
 			{
 				m_isThreadTaskFinished = true;
+				m_hasTaskThrown = true;
 
 				m_task->OnException(std::current_exception());
 			}
@@ -171,12 +209,16 @@ protected:
 
 private:
 
-	mutable std::mutex m_taskMutex;
-	mutable std::condition_variable m_taskCV;
+	mutable Mutex m_taskMutex;
+	mutable ConditionVariable m_taskCV;
+	// guards the task pointer only, so `TerminateTask` does not need to
+	// wait for the running task
+	mutable Mutex m_taskPtrMutex;
 	std::unique_ptr<Task> m_task;
 	std::atomic_bool m_isTerminated;
 	std::atomic_bool m_isTerminating;
 	std::atomic_bool m_isThreadTaskFinished;
+	bool m_hasTaskThrown;
 
 }; // class TaskRunner
 
@@ -0,0 +1,64 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#ifdef __linux__
+#include <sched.h>
+#endif // __linux__
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief Binds threads to CPUs; it is kept apart from `CpuQuota`, so the
+ *        pool can pin its polling workers without reading cgroup files.
+ *
+ */
+class ThreadAffinity
+{
+public: // static members:
+
+
+	/**
+	 * @brief Pin the calling thread to one CPU, e.g., one isolated from the
+	 *        scheduler with `isolcpus`, for a thread that keeps it busy.
+	 *
+	 * @return Whether it is pinned; it is not supported outside Linux.
+	 */
+	static bool PinCurrentThread(size_t cpu)
+	{
+#ifdef __linux__
+		if (cpu >= CPU_SETSIZE)
+		{
+			return false;
+		}
+		cpu_set_t cpuSet;
+		CPU_ZERO(&cpuSet);
+		CPU_SET(cpu, &cpuSet);
+		// 0 is the calling thread
+		return sched_setaffinity(0, sizeof(cpuSet), &cpuSet) == 0;
+#else
+		(void)cpu;
+		return false;
+#endif // __linux__
+	}
+
+}; // class ThreadAffinity
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
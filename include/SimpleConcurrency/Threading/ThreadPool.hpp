@@ -7,16 +7,28 @@
 
 
 #include <cstddef>
+#include <cstdint>
 
 #include <atomic>
-#include <condition_variable>
-#include <list>
+#include <chrono>
+#include <functional>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <thread>
 #include <vector>
 
+#include "CompletionPolicies.hpp"
+#include "IntrusiveTaskQueue.hpp"
+#include "PollingBackoff.hpp"
+#include "QueuePolicies.hpp"
+#include "ScratchArena.hpp"
+#include "StatsPolicies.hpp"
+#include "StopToken.hpp"
+#include "SyncPrimitives.hpp"
 #include "TaskRunner.hpp"
+#include "ThreadAffinity.hpp"
+#include "ThreadPoolBase.hpp"
+#include "WaitPolicies.hpp"
 
 
 #ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
@@ -29,219 +41,1813 @@ namespace Threading
 {
 
 
-class ThreadPool
+/**
+ * @brief A thread pool configured at compile time by its policies, so that
+ *        the machinery a configuration doesn't use is not compiled in.
+ *
+ * @tparam _QueuePolicy How the pending tasks are queued
+ *                      (see `LockedQueuePolicy`).
+ * @tparam _WaitPolicy How idle workers wait for pending tasks
+ *                     (see `BlockingWaitPolicy`).
+ * @tparam _CompletionPolicy Where the `Finishing` functions are called
+ *                           (see `DefaultCompletionPolicy`).
+ * @tparam _StatsPolicy What statistics are collected
+ *                      (see `NoStatsPolicy`).
+ */
+template<
+	typename _QueuePolicy = LockedQueuePolicy,
+	typename _WaitPolicy = BlockingWaitPolicy,
+	typename _CompletionPolicy = DefaultCompletionPolicy,
+	typename _StatsPolicy = NoStatsPolicy
+>
+class BasicThreadPool :
+	public ThreadPoolBase,
+	public _CompletionPolicy,
+	public _StatsPolicy
 {
+public: // static members:
+
+	using QueuePolicy = _QueuePolicy;
+	using WaitPolicy = _WaitPolicy;
+	using CompletionPolicy = _CompletionPolicy;
+	using StatsPolicy = _StatsPolicy;
+
+	static constexpr size_t sk_defaultMaxDequeueBatchSize = 16;
+
+	static constexpr size_t sk_defaultMaxAffinityBacklog = 8;
+
+	static constexpr size_t sk_defaultAffinityStealThreshold = 4;
+
+
+	/**
+	 * @brief Get the pool that the calling thread is a worker of,
+	 *        or `nullptr` if it is not a worker of a pool of this type.
+	 *
+	 */
+	static BasicThreadPool* GetCurrent()
+	{
+		return dynamic_cast<BasicThreadPool*>(ThreadPoolBase::GetCurrent());
+	}
+
+
 public:
-	ThreadPool(size_t poolSize) :
+
+	/**
+	 * @param poolSize The max number of workers; to use as many as the CPUs
+	 *                 this process can actually use, given its CPU quota
+	 *                 and affinity mask, pass
+	 *                 `CpuQuota::GetDefaultPoolSize()`.
+	 */
+	BasicThreadPool(size_t poolSize) :
+		ThreadPoolBase(),
+		_CompletionPolicy(),
+		_StatsPolicy(),
+
 		m_poolSize(poolSize),
+		m_maxDequeueBatchSize(sk_defaultMaxDequeueBatchSize),
+		m_maxAffinityBacklog(sk_defaultMaxAffinityBacklog),
+		m_affinityStealThreshold(sk_defaultAffinityStealThreshold),
+
+		m_terminated(false),
+
+		m_threadsMutex(),
+		m_threads(),
+		m_threadsSize(0),
+		m_blockingWorkersSize(0),
+		m_busyTaskRunners(),
+		m_workerStates(),
+		m_workerSlots(),
+		m_adoptedTaskRunners(),
+		m_adoptedWorkerStates(),
+		m_adoptedWorkerSlots(),
+		m_pollingThreads(),
+		m_pollingTaskRunners(),
+		m_pollingWorkerStates(),
+		m_lowLatencyTasksOwner(),
+		m_lowLatencyTasks(nullptr),
+
+		m_pendingTasks(),
+		m_waiter(),
+		m_idleWorkersSize(0),
+		m_stealSeq(0),
+
+		m_numOfExpiredTasks(0),
+		m_recentQueueTimeNs(0),
+		m_recentRunTimeNs(0)
+	{}
+
+
+	// LCOV_EXCL_START
+	virtual ~BasicThreadPool()
+	{
+		// terminate all threads
+		Terminate();
+	}
+	// LCOV_EXCL_STOP
+
+
+	virtual void AddTask(std::unique_ptr<Task> task) override
+	{
+		PrepareTask(*task);
+		PushPendingTask(std::move(task));
+	}
+
+
+	/**
+	 * @brief Add a task that prefers the worker the key is hashed to,
+	 *        so that tasks with the same key, e.g., touching the same shard
+	 *        of data, tend to run on the same worker, and find their data
+	 *        in its cache.
+	 *        The task waits in the backlog of the preferred worker, unless
+	 *        it already has `GetMaxAffinityBacklog` tasks waiting, or it is
+	 *        not started yet, or it is busy while nobody is idle and the
+	 *        pool can still start a worker, which then takes the task.
+	 *        Idle workers only steal from a backlog of more than
+	 *        `GetAffinityStealThreshold` tasks, so a task is not held up
+	 *        long by the ones before it, while most still run on the
+	 *        preferred worker.
+	 *        Unlike a strand, tasks with the same key are not ordered, and
+	 *        may run at the same time.
+	 *
+	 */
+	template<typename _KeyType>
+	void AddTask(const _KeyType& key, std::unique_ptr<Task> task)
+	{
+		PrepareTask(*task);
+
+		size_t hash = std::hash<_KeyType>()(key);
+		size_t poolSize = m_poolSize;
+		WorkerState* preferred =
+			FindSlot(m_workerSlots, poolSize > 0 ? hash % poolSize : 0);
+		if (preferred != nullptr)
+		{
+			bool isPreferredIdle = preferred->m_isIdle;
+			bool isStartingWorker =
+				!isPreferredIdle &&
+				(m_idleWorkersSize == 0) &&
+				(m_threadsSize < GetMaxNumOfThreads());
+			if (
+				!isStartingWorker &&
+				preferred->TryPushBack(task, m_maxAffinityBacklog)
+			)
+			{
+				if (isPreferredIdle)
+				{
+					m_waiter.Notify(preferred->m_waitSlot);
+				}
+				else if (
+					(m_idleWorkersSize > 0) &&
+					(preferred->m_localTasksSize > m_affinityStealThreshold)
+				)
+				{
+					// the preferred worker is busy, and falling behind
+					++m_stealSeq;
+					m_waiter.NotifyOne();
+				}
+				return;
+			}
+		}
+
+		// the preferred worker is overloaded, or not there, or a new
+		// worker is started for it
+		PushPendingTask(std::move(task));
+	}
+
+
+	/**
+	 * @brief Add the task only if it can probably start before its
+	 *        deadline, judging by `GetEstimatedWaitTime`; otherwise, the
+	 *        task is left in `task`, so the caller can reject it up front.
+	 *
+	 * @return Whether the task is added.
+	 */
+	bool TryAddTask(std::unique_ptr<Task>& task)
+	{
+		if (
+			task->HasDeadline() &&
+			task->IsExpired(Task::Clock::now() + GetEstimatedWaitTime())
+		)
+		{
+			return false;
+		}
+
+		AddTask(std::move(task));
+		return true;
+	}
+
+
+	/**
+	 * @brief Take a pending task, and run it in the calling thread,
+	 *        including its `Finishing` function if it completes inline.
+	 *        A worker takes tasks from its own batch first, then the shared
+	 *        queue, and then steals from the batches of other workers.
+	 *
+	 * @return Whether there was a task to run.
+	 */
+	virtual bool RunPendingTask() override
+	{
+		std::unique_ptr<Task> task = TakeTaskToHelp();
+		if (task == nullptr)
+		{
+			return false;
+		}
+
+		Task::TimePoint beginTime = GetBeginTime(*task);
+		if (ShedIfExpired(task, beginTime))
+		{
+			return true;
+		}
+
+		// the task being helped may still use the scratch arena,
+		// so only free what this task allocates
+		ScratchArena* arena = GetCurrentScratchArena();
+		ScratchArena::Marker marker = ScratchArena::Marker();
+		if (arena != nullptr)
+		{
+			marker = arena->GetMarker();
+		}
+
+		auto runContext = this->OnTaskRunBegin(*task);
+		bool hasThrown = false;
+		try
+		{
+			task->Run();
+		}
+		catch(...)
+		{
+			hasThrown = true;
+			task->OnException(std::current_exception());
+		}
+		this->OnTaskRunEnd(*task, runContext, hasThrown);
+		RecordRunTime(beginTime);
+		this->CompleteTask(std::move(task));
+
+		if (arena != nullptr)
+		{
+			arena->RewindTo(marker);
+		}
+		return true;
+	}
+
+
+	virtual void BeginBlocking() override
+	{
+		if (IsCurrentWorkerUncounted())
+		{
+			// it is not counted in the pool size, so an extra worker would
+			// not take its place
+			return;
+		}
+
+		++m_blockingWorkersSize;
+
+		if (m_idleWorkersSize == 0)
+		{
+			TrySpawnWorkerForPendingTask();
+		}
+	}
+
+
+	virtual void EndBlocking() override
+	{
+		if (IsCurrentWorkerUncounted())
+		{
+			return;
+		}
+
+		--m_blockingWorkersSize;
+
+		if (m_threadsSize > GetMaxNumOfThreads())
+		{
+			// let an idle worker retire
+			m_waiter.NotifyAll();
+		}
+	}
+
+
+	/**
+	 * @brief Let the calling thread, which is not created by the pool, e.g.,
+	 *        a thread entering an enclave, work as a worker of the pool,
+	 *        until the stop is requested on `stopToken`, or the pool is
+	 *        terminated. It takes pending tasks like the other workers, but
+	 *        in addition to the pool size; e.g., with a pool size of 0, the
+	 *        pool never creates a thread, and only the adopted threads run
+	 *        tasks. When the stop is requested, it leaves once it is done
+	 *        with its current task.
+	 *        `Terminate` waits for the adopted threads to leave.
+	 *
+	 */
+	void JoinAsWorker(const StopToken& stopToken)
+	{
+		if (ThreadPoolBase::GetCurrent() != nullptr)
+		{
+			throw std::logic_error("The calling thread is already a worker");
+		}
+
+		WorkerState* workerPtr = nullptr;
+		TaskRunner taskRunner;
+		{
+			std::lock_guard<Mutex> lock(m_threadsMutex);
+			if (m_terminated)
+			{
+				return;
+			}
+			workerPtr = &m_adoptedWorkerSlots.Acquire();
+			workerPtr->m_stopToken = &stopToken;
+			workerPtr->m_threadId = std::this_thread::get_id();
+			m_adoptedTaskRunners.push_back(&taskRunner);
+			m_adoptedWorkerStates.push_back(workerPtr);
+		}
+		WorkerState& worker = *workerPtr;
+
+		uint64_t callbackId = stopToken.AddCallback(
+			[this]()
+			{
+				m_waiter.NotifyAll();
+			}
+		);
+		CurrentWorkerPool() = this;
+		CurrentScratchArena() = &(worker.m_scratchArena);
+		CurrentWorkerState() = &worker;
+
+		try
+		{
+			RunAdoptedWorker(worker, taskRunner);
+		}
+		catch(...)
+		{
+			LeaveAsWorker(worker, taskRunner, stopToken, callbackId);
+			throw;
+		}
+		LeaveAsWorker(worker, taskRunner, stopToken, callbackId);
+	}
+
+
+	/**
+	 * @brief Let the calling thread work as a worker of the pool until the
+	 *        pool is terminated (see `JoinAsWorker`).
+	 *
+	 */
+	void RunWorker()
+	{
+		JoinAsWorker(StopToken());
+	}
+
+
+	/**
+	 * @brief Get the number of threads working for the pool through
+	 *        `JoinAsWorker`.
+	 *
+	 */
+	size_t GetNumOfAdoptedWorkers() const
+	{
+		std::lock_guard<Mutex> lock(m_threadsMutex);
+		return m_adoptedTaskRunners.size();
+	}
+
+
+	/**
+	 * @brief Start workers dedicated to the tasks added by
+	 *        `AddLowLatencyTask`, which never sleep: they keep polling a
+	 *        lock-free queue, and only pause the CPU in between (see
+	 *        `PollingBackoff`), so a task is picked up in well under a
+	 *        microsecond, at the cost of a whole CPU for each of them.
+	 *        They are in addition to the pool size, and don't run the other
+	 *        tasks, which are left to the other workers.
+	 *
+	 * @param numOfWorkers The number of polling workers to start.
+	 * @param cpus The CPUs to pin the workers to, one each, ideally ones
+	 *             isolated from the scheduler; the workers beyond its size
+	 *             are not pinned.
+	 * @return The number of workers pinned; a worker that can't be
+	 *         pinned, e.g., to a CPU the process is not allowed to use, or
+	 *         outside Linux, runs unpinned.
+	 */
+	size_t StartPollingWorkers(
+		size_t numOfWorkers,
+		const std::vector<size_t>& cpus = std::vector<size_t>()
+	)
+	{
+		std::lock_guard<Mutex> lock(m_threadsMutex);
+		if (m_terminated)
+		{
+			return 0;
+		}
+
+		if (m_lowLatencyTasksOwner == nullptr)
+		{
+			m_lowLatencyTasksOwner.reset(new LowLatencyQueue());
+			m_lowLatencyTasks = m_lowLatencyTasksOwner.get();
+		}
+
+		// each worker pins itself once it starts
+		PinResults pinResults;
+		for (size_t i = 0; i < numOfWorkers; ++i)
+		{
+			bool isPinned = i < cpus.size();
+			CreatePollingThread(
+				isPinned ? cpus[i] : 0,
+				isPinned ? &pinResults : nullptr
+			);
+		}
+		return pinResults.Wait(
+			numOfWorkers < cpus.size() ? numOfWorkers : cpus.size()
+		);
+	}
+
+
+	/**
+	 * @brief Add a task to be run by a polling worker (see
+	 *        `StartPollingWorkers`); without polling workers, it is added
+	 *        like any other task.
+	 *
+	 */
+	void AddLowLatencyTask(std::unique_ptr<Task> task)
+	{
+		LowLatencyQueue* queue = m_lowLatencyTasks.load();
+		if (queue == nullptr)
+		{
+			AddTask(std::move(task));
+			return;
+		}
+
+		PrepareTask(*task);
+		queue->Push(std::move(task));
+	}
+
+
+	size_t GetNumOfPollingWorkers() const
+	{
+		std::lock_guard<Mutex> lock(m_threadsMutex);
+		return m_pollingThreads.size();
+	}
+
+
+	/**
+	 * @brief Set the max number of pending tasks a worker can take at once.
+	 *        Taking more than one task saves trips to the shared queue for
+	 *        short tasks; the actual number also depends on the queue depth
+	 *        and the number of workers, so tasks are not hoarded by one
+	 *        worker.
+	 *
+	 */
+	void SetMaxDequeueBatchSize(size_t maxBatchSize)
+	{
+		m_maxDequeueBatchSize = maxBatchSize > 0 ? maxBatchSize : 1;
+	}
+
+
+	size_t GetMaxDequeueBatchSize() const
+	{
+		return m_maxDequeueBatchSize;
+	}
+
+
+	/**
+	 * @brief Set the max number of tasks waiting for a worker, beyond which
+	 *        the tasks added with a key preferring that worker are shared
+	 *        with the other workers (see `AddTask(key, task)`).
+	 *
+	 */
+	void SetMaxAffinityBacklog(size_t maxBacklog)
+	{
+		m_maxAffinityBacklog = maxBacklog;
+	}
+
+
+	size_t GetMaxAffinityBacklog() const
+	{
+		return m_maxAffinityBacklog;
+	}
+
+
+	/**
+	 * @brief Set the number of tasks waiting for a busy worker, beyond
+	 *        which idle workers steal the tasks added with a key preferring
+	 *        that worker (see `AddTask(key, task)`).
+	 *
+	 */
+	void SetAffinityStealThreshold(size_t threshold)
+	{
+		m_affinityStealThreshold = threshold;
+	}
+
+
+	size_t GetAffinityStealThreshold() const
+	{
+		return m_affinityStealThreshold;
+	}
+
+
+	/**
+	 * @brief Get the number of tasks in the shared pending queue;
+	 *        tasks already taken by a worker are not counted.
+	 *
+	 */
+	size_t GetNumOfPendingTasks() const
+	{
+		return m_pendingTasks.Size();
+	}
+
+
+	virtual size_t GetPoolSize() const override
+	{
+		return m_poolSize;
+	}
+
+
+	/**
+	 * @brief Change the max number of workers at run time.
+	 *        When it grows, workers are started right away for the pending
+	 *        tasks; when it shrinks, the extra workers retire once they are
+	 *        done with the tasks they have taken, so no task is interrupted.
+	 *        Like the pool size given to the constructor, it can be 0, in
+	 *        which case only the adopted workers (see `JoinAsWorker`) and
+	 *        the compensating ones run tasks.
+	 *
+	 */
+	virtual void SetPoolSize(size_t poolSize) override
+	{
+		size_t oldPoolSize = m_poolSize.exchange(poolSize);
+		if (poolSize > oldPoolSize)
+		{
+			for (size_t i = oldPoolSize; i < poolSize; ++i)
+			{
+				TrySpawnWorkerForPendingTask();
+			}
+		}
+		else if (poolSize < oldPoolSize)
+		{
+			// let the idle workers retire
+			m_waiter.NotifyAll();
+		}
+	}
+
+
+	/**
+	 * @brief Get the number of worker threads, including the compensating
+	 *        ones, and excluding the retired, adopted, and polling ones.
+	 *
+	 */
+	size_t GetNumOfThreads() const
+	{
+		return m_threadsSize;
+	}
+
+
+	size_t GetNumOfBlockingWorkers() const
+	{
+		return m_blockingWorkersSize;
+	}
+
+
+	/**
+	 * @brief Get the number of tasks dropped since their deadlines passed
+	 *        while they were pending.
+	 *
+	 */
+	uint64_t GetNumOfExpiredTasks() const
+	{
+		return m_numOfExpiredTasks;
+	}
+
+
+	/**
+	 * @brief Get the moving average of the time tasks spend in the queue,
+	 *        over roughly the last 8 tasks started; it stays 0 unless the
+	 *        statistics policy is timing the tasks (`sk_isTimingTasks`).
+	 *
+	 */
+	std::chrono::nanoseconds GetRecentQueueTime() const
+	{
+		return std::chrono::nanoseconds(m_recentQueueTimeNs.load());
+	}
+
+
+	/**
+	 * @brief Get the moving average of the time tasks spend running,
+	 *        over roughly the last 8 tasks finished; it stays 0 unless the
+	 *        statistics policy is timing the tasks (`sk_isTimingTasks`).
+	 *
+	 */
+	std::chrono::nanoseconds GetRecentRunTime() const
+	{
+		return std::chrono::nanoseconds(m_recentRunTimeNs.load());
+	}
+
+
+	/**
+	 * @brief Estimate how long a task added now waits before it starts:
+	 *        the time the tasks ahead of it take on the workers, judging by
+	 *        the recent run time, or the recent queue time if it is longer,
+	 *        e.g., while workers are blocked, or tasks are not run in FIFO
+	 *        order. It is 0 unless the statistics policy is timing the
+	 *        tasks, so `TryAddTask` only rejects expired tasks then.
+	 *
+	 */
+	std::chrono::nanoseconds GetEstimatedWaitTime() const
+	{
+		size_t numOfPending = m_pendingTasks.Size();
+		size_t numOfIdle = m_idleWorkersSize;
+		if (numOfPending < numOfIdle)
+		{
+			// an idle worker picks it up right away
+			return std::chrono::nanoseconds(0);
+		}
+
+		// the task waits for the ones ahead of it, and for a busy worker
+		uint64_t numOfAhead = numOfPending - numOfIdle + 1;
+		uint64_t numOfWorkers = m_poolSize.load();
+		numOfWorkers = numOfWorkers > 0 ? numOfWorkers : 1;
+		uint64_t waitNs = numOfAhead * m_recentRunTimeNs.load() / numOfWorkers;
+		uint64_t queueNs = m_recentQueueTimeNs.load();
+		waitNs = waitNs > queueNs ? waitNs : queueNs;
+		return std::chrono::nanoseconds(waitNs);
+	}
+
+
+	/**
+	 * @brief Get the tasks being run by the workers, including the adopted
+	 *        ones; a task run by a worker helping another one (see
+	 *        `RunPendingTask`) is accounted to the task it helps.
+	 *        It is always empty unless the statistics policy tracks the
+	 *        running tasks (`sk_isTrackingRunningTasks`).
+	 *
+	 */
+	virtual std::vector<RunningTaskInfo> GetRunningTasks() const override
+	{
+		std::vector<RunningTaskInfo> infos;
+		if (!_StatsPolicy::sk_isTrackingRunningTasks)
+		{
+			return infos;
+		}
+		Task::TimePoint now = Task::Clock::now();
+
+		std::lock_guard<Mutex> lock(m_threadsMutex);
+		for (const WorkerState* worker : m_workerStates)
+		{
+			AppendRunningTask(*worker, now, infos);
+		}
+		for (const WorkerState* worker : m_adoptedWorkerStates)
+		{
+			AppendRunningTask(*worker, now, infos);
+		}
+		for (const auto& worker : m_pollingWorkerStates)
+		{
+			AppendRunningTask(*worker, now, infos);
+		}
+		return infos;
+	}
+
+
+	virtual bool IsTerminated() const override
+	{
+		return m_terminated;
+	}
+
+
+	void Terminate()
+	{
+		m_terminated = true;
+
+		m_waiter.NotifyAll();
+
+		// the adopted threads are not ours to join
+		WaitForAdoptedWorkersToLeave();
+
+		std::lock_guard<Mutex> lock(m_threadsMutex);
+
+		TerminateThreadsNonLocking(m_threads, m_busyTaskRunners);
+		for (WorkerState* worker : m_workerStates)
+		{
+			// the tasks left in the batches of the workers are dropped
+			m_workerSlots.Release(*worker);
+		}
+		m_workerStates.clear();
+
+		TerminateThreadsNonLocking(m_pollingThreads, m_pollingTaskRunners);
+		m_pollingWorkerStates.clear();
+
+		this->StopCompletion();
+	}
+
+
+private: // private types:
+
+
+	using LowLatencyQueue = LockFreeQueuePolicy<>;
+
+
+	struct WorkerState
+	{
+		WorkerState() :
+			m_nextSlot(nullptr),
+			m_isSlotUsed(false),
+			m_localTasksMutex(),
+			m_localTasks(),
+			m_localTasksSize(0),
+			m_isRetired(false),
+			m_isIdle(false),
+			m_stopToken(nullptr),
+			m_isPolling(false),
+			m_threadId(),
+			m_runSeq(0),
+			m_runIndex(0),
+			m_runTag(nullptr),
+			m_runBeginTicks(0),
+			m_isRunning(false),
+			m_waitSlot(),
+			m_scratchArena(),
+			m_runContext(),
+			m_runBeginTime()
+		{}
+
+		void PushBack(std::unique_ptr<Task> task)
+		{
+			std::lock_guard<Mutex> lock(m_localTasksMutex);
+			m_localTasks.PushBack(std::move(task));
+			++m_localTasksSize;
+		}
+
+		/**
+		 * @brief Push a task from another thread, unless the worker is
+		 *        retired, or already has `maxBacklog` tasks; the task is
+		 *        left in `task` if it is not pushed.
+		 *
+		 */
+		bool TryPushBack(std::unique_ptr<Task>& task, size_t maxBacklog)
+		{
+			std::lock_guard<Mutex> lock(m_localTasksMutex);
+			if (m_isRetired || m_localTasks.Size() >= maxBacklog)
+			{
+				return false;
+			}
+			m_localTasks.PushBack(std::move(task));
+			++m_localTasksSize;
+			return true;
+		}
+
+		/**
+		 * @brief Get the state ready for a new worker taking the slot.
+		 *
+		 */
+		void Reuse()
+		{
+			{
+				std::lock_guard<Mutex> lock(m_localTasksMutex);
+				m_isRetired = false;
+			}
+			m_isIdle = false;
+			m_stopToken = nullptr;
+			m_threadId = std::thread::id();
+		}
+
+		/**
+		 * @brief Stop taking tasks from other threads, and give back the
+		 *        tasks not run yet.
+		 *
+		 */
+		IntrusiveTaskQueue Retire()
+		{
+			std::lock_guard<Mutex> lock(m_localTasksMutex);
+			m_isRetired = true;
+			m_localTasksSize = 0;
+			IntrusiveTaskQueue tasks(std::move(m_localTasks));
+			return tasks;
+		}
+
+		/**
+		 * @brief Whether the stop is requested on an adopted worker.
+		 *
+		 */
+		bool IsStopRequested() const
+		{
+			return m_stopToken != nullptr && m_stopToken->IsStopRequested();
+		}
+
+		/**
+		 * @brief Publish the task starting, or `nullptr` when it is done,
+		 *        for `GetRunningTasks`; only called by the one thread
+		 *        running the tasks of this worker.
+		 *
+		 */
+		void PublishRunningTask(const Task* task)
+		{
+			// a sequence lock; the sequence is odd while it is updated,
+			// and the fence keeps the fields from being seen before that
+			uint64_t seq = m_runSeq.load(std::memory_order_relaxed);
+			m_runSeq.store(seq + 1, std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_release);
+			if (task != nullptr)
+			{
+				m_runIndex.store(
+					m_runIndex.load(std::memory_order_relaxed) + 1,
+					std::memory_order_relaxed
+				);
+				m_runTag.store(task->GetTag(), std::memory_order_relaxed);
+				m_runBeginTicks.store(
+					m_runBeginTime.time_since_epoch().count(),
+					std::memory_order_relaxed
+				);
+			}
+			m_isRunning.store(task != nullptr, std::memory_order_relaxed);
+			m_runSeq.store(seq + 2, std::memory_order_release);
+		}
+
+		/**
+		 * @brief Read the task published by `PublishRunningTask`.
+		 *
+		 * @return Whether a task is running.
+		 */
+		bool TryGetRunningTask(RunningTaskInfo& info) const
+		{
+			while (true)
+			{
+				uint64_t seq = m_runSeq.load(std::memory_order_acquire);
+				if ((seq & 1) == 0)
+				{
+					bool isRunning =
+						m_isRunning.load(std::memory_order_relaxed);
+					info.m_threadId = m_threadId.load();
+					info.m_runIndex =
+						m_runIndex.load(std::memory_order_relaxed) - 1;
+					info.m_tag = m_runTag.load(std::memory_order_relaxed);
+					info.m_beginTime = Task::TimePoint(
+						Task::Clock::duration(
+							m_runBeginTicks.load(std::memory_order_relaxed)
+						)
+					);
+					// the fields are read before the sequence is checked
+					std::atomic_thread_fence(std::memory_order_acquire);
+					if (m_runSeq.load(std::memory_order_relaxed) == seq)
+					{
+						return isRunning;
+					}
+				}
+				std::this_thread::yield();
+			}
+		}
+
+		std::unique_ptr<Task> PopFront()
+		{
+			if (m_localTasksSize == 0)
+			{
+				return nullptr;
+			}
+
+			std::lock_guard<Mutex> lock(m_localTasksMutex);
+			return PopNonLocking(true);
+		}
+
+		std::unique_ptr<Task> PopBack()
+		{
+			if (m_localTasksSize == 0)
+			{
+				return nullptr;
+			}
+
+			std::lock_guard<Mutex> lock(m_localTasksMutex);
+			return PopNonLocking(false);
+		}
+
+		std::unique_ptr<Task> PopNonLocking(bool isFront)
+		{
+			std::unique_ptr<Task> task = isFront ?
+				m_localTasks.PopFront() : m_localTasks.PopBack();
+			if (task != nullptr)
+			{
+				--m_localTasksSize;
+			}
+			return task;
+		}
+
+		// the next slot in the list (see `WorkerSlots`)
+		std::atomic<WorkerState*> m_nextSlot;
+		// guarded by the threads mutex
+		bool m_isSlotUsed;
+
+		// tasks taken from the pending queue in the same batch;
+		// the worker runs them from the front, and threads waiting for
+		// their tasks may steal them from the back
+		// tasks added with a key preferring this worker are kept here too
+		Mutex m_localTasksMutex;
+		IntrusiveTaskQueue m_localTasks;
+		std::atomic<size_t> m_localTasksSize;
+		bool m_isRetired;
+		std::atomic_bool m_isIdle;
+		// only set for a thread adopted through `JoinAsWorker`
+		const StopToken* m_stopToken;
+		// only set for a worker started by `StartPollingWorkers`
+		bool m_isPolling;
+
+		// the task being run, published for other threads
+		std::atomic<std::thread::id> m_threadId;
+		std::atomic<uint64_t> m_runSeq;
+		std::atomic<uint64_t> m_runIndex;
+		std::atomic<const char*> m_runTag;
+		std::atomic<Task::Clock::rep> m_runBeginTicks;
+		std::atomic_bool m_isRunning;
+
+		// what the worker waits with, so it can be woken up alone
+		typename _WaitPolicy::WaitSlot m_waitSlot;
+
+		// only accessed by the worker thread
+		ScratchArena m_scratchArena;
+		typename _StatsPolicy::RunContext m_runContext;
+		Task::TimePoint m_runBeginTime;
+	}; // struct WorkerState
+
+
+	/**
+	 * @brief The states of one kind of workers, in slots that are never
+	 *        removed, but taken over by later workers, so that other
+	 *        threads can walk through them without taking a lock, e.g.,
+	 *        to steal tasks.
+	 *        Slots are only taken and given back while holding the
+	 *        threads mutex.
+	 *
+	 */
+	class WorkerSlots
+	{
+	public:
+		WorkerSlots() :
+			m_states(),
+			m_first(nullptr),
+			m_last(nullptr)
+		{}
+
+		WorkerState& Acquire()
+		{
+			for (auto& state : m_states)
+			{
+				if (!state->m_isSlotUsed)
+				{
+					state->m_isSlotUsed = true;
+					state->Reuse();
+					return *state;
+				}
+			}
+
+			std::unique_ptr<WorkerState> state(new WorkerState());
+			WorkerState* statePtr = state.get();
+			statePtr->m_isSlotUsed = true;
+			m_states.push_back(std::move(state));
+
+			// publish the slot once it is ready
+			if (m_last == nullptr)
+			{
+				m_first = statePtr;
+			}
+			else
+			{
+				m_last->m_nextSlot = statePtr;
+			}
+			m_last = statePtr;
+			return *statePtr;
+		}
+
+		/**
+		 * @brief Give back the slot of a worker that is gone; the tasks
+		 *        left in its batch, if any, are dropped.
+		 *
+		 */
+		void Release(WorkerState& state)
+		{
+			state.Retire();
+			state.m_isSlotUsed = false;
+		}
+
+		WorkerState* GetFirst() const
+		{
+			return m_first;
+		}
+
+	private:
+		std::vector<std::unique_ptr<WorkerState> > m_states;
+		std::atomic<WorkerState*> m_first;
+		WorkerState* m_last;
+	}; // class WorkerSlots
+
+
+	/**
+	 * @brief Counts the polling workers started together that are pinned,
+	 *        as each of them pins itself in its own thread.
+	 *
+	 */
+	class PinResults
+	{
+	public:
+		PinResults() :
+			m_mutex(),
+			m_cv(),
+			m_numOfTried(0),
+			m_numOfPinned(0)
+		{}
+
+		void Add(bool isPinned)
+		{
+			// notified with the lock held, as the waiter is gone once it
+			// sees the last result
+			std::lock_guard<Mutex> lock(m_mutex);
+			++m_numOfTried;
+			m_numOfPinned += isPinned ? 1 : 0;
+			m_cv.notify_all();
+		}
+
+		/**
+		 * @brief Wait for `numOfTries` results.
+		 *
+		 * @return The number of workers pinned.
+		 */
+		size_t Wait(size_t numOfTries)
+		{
+			std::unique_lock<Mutex> lock(m_mutex);
+			m_cv.wait(
+				lock,
+				[this, numOfTries]()
+				{
+					return m_numOfTried >= numOfTries;
+				}
+			);
+			return m_numOfPinned;
+		}
+
+	private:
+		Mutex m_mutex;
+		ConditionVariable m_cv;
+		size_t m_numOfTried;
+		size_t m_numOfPinned;
+	}; // class PinResults
+
+
+private: // private functions:
+
+
+	static WorkerState*& CurrentWorkerState()
+	{
+		static thread_local WorkerState* s_state = nullptr;
+		return s_state;
+	}
+
+
+	/**
+	 * @brief Whether the calling thread is an adopted or polling worker,
+	 *        which are not counted in the pool size.
+	 *
+	 */
+	static bool IsCurrentWorkerUncounted()
+	{
+		WorkerState* state = CurrentWorkerState();
+		return state != nullptr &&
+			(state->m_stopToken != nullptr || state->m_isPolling);
+	}
+
+
+	static void AppendRunningTask(
+		const WorkerState& worker,
+		Task::TimePoint now,
+		std::vector<RunningTaskInfo>& infos
+	)
+	{
+		RunningTaskInfo info;
+		if (worker.TryGetRunningTask(info))
+		{
+			info.m_runTime =
+				std::chrono::duration_cast<std::chrono::nanoseconds>(
+					now - info.m_beginTime
+				);
+			infos.push_back(info);
+		}
+	}
+
+
+	void BeginRun(WorkerState& worker, const Task& task)
+	{
+		worker.m_runContext = this->OnTaskRunBegin(task);
+		if (_StatsPolicy::sk_isTrackingRunningTasks)
+		{
+			worker.PublishRunningTask(&task);
+		}
+	}
+
+
+	/**
+	 * @brief Get the time a task begins, for its deadline, the recent
+	 *        times, and the running tasks; the clock is not read if none
+	 *        of them is needed.
+	 *
+	 */
+	static Task::TimePoint GetBeginTime(const Task& task)
+	{
+		if (
+			_StatsPolicy::sk_isTimingTasks ||
+			_StatsPolicy::sk_isTrackingRunningTasks ||
+			task.HasDeadline()
+		)
+		{
+			return Task::Clock::now();
+		}
+		// unused; a task without a deadline never expires
+		return Task::TimePoint();
+	}
+
+
+	void PrepareTask(Task& task)
+	{
+		if (_StatsPolicy::sk_isTimingTasks)
+		{
+			task.SetEnqueueTime(Task::Clock::now());
+		}
+		this->OnTaskSubmitted(task);
+		this->OnTaskAdded(task);
+	}
+
+
+	void PushPendingTask(std::unique_ptr<Task> task)
+	{
+		// add task to pending tasks, and notify a task runner
+		m_pendingTasks.Push(std::move(task));
+		m_waiter.NotifyOne();
+
+		TrySpawnWorkerForPendingTask();
+	}
 
-		m_terminated(false),
 
-		m_threadsMutex(),
-		m_threads(),
-		m_threadsSize(0),
-		m_busyTaskRunners(),
-		//m_idleTaskRunners(),
+	static void UpdateRecentTime(
+		std::atomic<uint64_t>& recentTimeNs,
+		Task::Clock::duration sample
+	)
+	{
+		// exponential moving average with a weight of 1/8 for the sample
+		int64_t sampleNs =
+			std::chrono::duration_cast<std::chrono::nanoseconds>(sample).count();
+		uint64_t sampleVal = sampleNs > 0 ? static_cast<uint64_t>(sampleNs) : 0;
+		uint64_t oldVal = recentTimeNs.load(std::memory_order_relaxed);
+		while (
+			!recentTimeNs.compare_exchange_weak(
+				oldVal,
+				oldVal - (oldVal / 8) + (sampleVal / 8),
+				std::memory_order_relaxed
+			)
+		)
+		{}
+	}
 
-		m_pendingTasksMutex(),
-		m_pendingTasksCV(),
-		m_pendingTasksSize(0),
-		m_pendingTasks(),
 
-		m_finishTasksQueueMutex(),
-		m_finishTasksQueue(),
-		m_finishTasksQueueSize(0)
-	{}
+	// the recent times are only kept if the statistics policy asks for
+	// them, so the other pools don't read the clock for them
 
+	void RecordQueueTime(const Task& task, Task::TimePoint beginTime)
+	{
+		if (_StatsPolicy::sk_isTimingTasks)
+		{
+			UpdateRecentTime(
+				m_recentQueueTimeNs, beginTime - task.GetEnqueueTime()
+			);
+		}
+	}
 
-	// LCOV_EXCL_START
-	~ThreadPool()
+
+	void RecordRunTime(Task::TimePoint beginTime)
 	{
-		// terminate all threads
-		Terminate();
+		if (_StatsPolicy::sk_isTimingTasks)
+		{
+			UpdateRecentTime(m_recentRunTimeNs, Task::Clock::now() - beginTime);
+		}
 	}
-	// LCOV_EXCL_STOP
 
 
-	void Update()
+	/**
+	 * @brief Called right before a task starts; drops the task instead,
+	 *        if its deadline has passed.
+	 *
+	 * @return Whether the task is dropped.
+	 */
+	bool ShedIfExpired(std::unique_ptr<Task>& task, Task::TimePoint now)
 	{
-		// check if there are any finished tasks
-		while (m_finishTasksQueueSize > 0)
+		RecordQueueTime(*task, now);
+
+		if (!task->IsExpired(now))
+		{
+			return false;
+		}
+
+		++m_numOfExpiredTasks;
+		try
+		{
+			task->OnExpired();
+		}
+		catch(...)
 		{
-			std::unique_ptr<Task> task;
+			task->OnException(std::current_exception());
+		}
+		task.reset();
+		return true;
+	}
 
-			// Fetch a finished task
-			{
-				std::lock_guard<std::mutex> lock(m_finishTasksQueueMutex);
 
-				task = std::move(m_finishTasksQueue.front());
-				m_finishTasksQueue.pop();
-				--m_finishTasksQueueSize;
+	std::unique_ptr<Task> TakeTaskToHelp()
+	{
+		// the batch of the calling worker first, as it is the next to run
+		WorkerState* self =
+			ThreadPoolBase::GetCurrent() == this ? CurrentWorkerState() : nullptr;
+		if (self != nullptr)
+		{
+			std::unique_ptr<Task> task = self->PopFront();
+			if (task != nullptr)
+			{
+				return task;
 			}
+		}
+
+		// then the shared queue
+		std::unique_ptr<Task> task;
+		if (m_pendingTasks.TryPop(task))
+		{
+			return task;
+		}
 
-			// call finishing function
-			task->Finishing();
+		// then the batches of other workers, which would run them last;
+		// the slots are walked without a lock, as this is called by tasks,
+		// which may hold any lock
+		task = StealTask(m_workerSlots, self, 0);
+		if (task != nullptr)
+		{
+			return task;
 		}
+		return StealTask(m_adoptedWorkerSlots, self, 0);
 	}
 
 
-	void AddTask(std::unique_ptr<Task> task)
+	/**
+	 * @brief Get the slot at `index`, if there are so many, without a lock;
+	 *        the slot may be free, or its worker retired.
+	 *
+	 */
+	static WorkerState* FindSlot(const WorkerSlots& slots, size_t index)
 	{
-		// add task to pending tasks
+		WorkerState* worker = slots.GetFirst();
+		for (size_t i = 0; i < index && worker != nullptr; ++i)
 		{
-			std::lock_guard<std::mutex> lock(m_pendingTasksMutex);
-			++m_pendingTasksSize;
-			m_pendingTasks.push_back(std::move(task));
+			worker = worker->m_nextSlot;
 		}
+		return worker;
+	}
 
-		// notify a task runner
-		m_pendingTasksCV.notify_one();
 
-		if (
-			m_pendingTasksSize > 0 &&
-			m_threadsSize < m_poolSize
+	/**
+	 * @brief Steal a task from the back of the batch of another worker,
+	 *        which has more than `minBacklog` tasks.
+	 *
+	 */
+	static std::unique_ptr<Task> StealTask(
+		const WorkerSlots& slots,
+		const WorkerState* self,
+		size_t minBacklog
+	)
+	{
+		for (
+			WorkerState* worker = slots.GetFirst();
+			worker != nullptr;
+			worker = worker->m_nextSlot
 		)
 		{
-			bool needNotify = false;
-
+			if (worker != self && worker->m_localTasksSize > minBacklog)
 			{
-				// Task is still pending, so probably there is no idle runner
-				// And there is still room for a new thread
-				std::lock_guard<std::mutex> lock(m_pendingTasksMutex);
-				if (m_pendingTasks.size() > 0)
+				std::unique_ptr<Task> task = worker->PopBack();
+				if (task != nullptr)
 				{
-					std::unique_ptr<Task>& firstTask = m_pendingTasks.front();
-					CreateNewThread(firstTask);
-
-					if (firstTask == nullptr)
-					{
-						// task is moved to the new thread
-						--m_pendingTasksSize;
-						m_pendingTasks.pop_front();
-					}
-					else
-					{
-						// no thread was created; task is still pending
-						// we may need to notify again
-						needNotify = true;
-					}
+					return task;
 				}
 			}
+		}
+		return nullptr;
+	}
+
+
+	size_t GetMaxNumOfThreads() const
+	{
+		// blocked workers are compensated by extra workers
+		return m_poolSize + m_blockingWorkersSize;
+	}
+
 
-			if (needNotify)
+	bool TryRetireWorker()
+	{
+		uint64_t numOfThreads = m_threadsSize;
+		while (numOfThreads > GetMaxNumOfThreads())
+		{
+			if (m_threadsSize.compare_exchange_weak(numOfThreads, numOfThreads - 1))
 			{
-				m_pendingTasksCV.notify_one();
+				return true;
 			}
 		}
+		return false;
 	}
 
 
-	void Terminate()
+	void TrySpawnWorkerForPendingTask()
 	{
-		m_terminated = true;
+		if (
+			m_pendingTasks.Size() == 0 ||
+			m_threadsSize >= GetMaxNumOfThreads()
+		)
+		{
+			return;
+		}
 
-		m_pendingTasksCV.notify_all();
+		// Task is still pending, so probably there is no idle runner
+		// And there is still room for a new thread;
+		// the task is only taken once the thread is sure to be created,
+		// since the queue can't take it back to its head
+		Task::TimePoint now = Task::Clock::now();
+		std::vector<std::unique_ptr<Task> > expiredTasks;
+		{
+			std::lock_guard<Mutex> lock(m_threadsMutex);
+			// lock threads mutex before doing management job
 
-		std::lock_guard<std::mutex> lock(m_threadsMutex);
+			JoinRetiredThreadsNonLocking();
 
-		// terminate all task runners
-		// for (auto& taskRunner : m_idleTaskRunners)
-		// {
-		// 	taskRunner->TerminateTask();
-		// }
-		for (auto& taskRunner : m_busyTaskRunners)
-		{
-			// repeat function call to help the task runner to terminate
-			while(!taskRunner->IsTerminated())
+			if (m_terminated || m_threadsSize >= GetMaxNumOfThreads())
 			{
-				m_pendingTasksCV.notify_all();
-				taskRunner->TerminateTask();
+				// pool is terminated or full, do nothing
+				return;
+			}
+
+			std::unique_ptr<Task> firstTask;
+			while (m_pendingTasks.TryPop(firstTask) && firstTask->IsExpired(now))
+			{
+				expiredTasks.push_back(std::move(firstTask));
+			}
+
+			if (firstTask != nullptr)
+			{
+				RecordQueueTime(*firstTask, now);
+				CreateNewThreadNonLocking(std::move(firstTask));
 			}
 		}
 
-		// join all threads
-		for (auto& thread : m_threads)
+		// shed them without the lock, as it calls into the tasks
+		for (std::unique_ptr<Task>& expiredTask : expiredTasks)
 		{
-			thread.join();
+			ShedIfExpired(expiredTask, now);
 		}
+	}
 
-		// clear all threads first
-		m_threads.clear();
 
-		// now it's safe to clear all task runners
-		//m_idleTaskRunners.clear();
-		m_busyTaskRunners.clear();
+	size_t GetDequeueBatchSize() const
+	{
+		// take a fair share of the queue, so that the other workers still
+		// have tasks to fetch, including the busy ones, which come back
+		// for more soon; adopted workers are only counted while idle
+		size_t numOfSharers = static_cast<size_t>(m_threadsSize);
+		size_t numOfIdle = m_idleWorkersSize;
+		numOfSharers = numOfSharers > numOfIdle ? numOfSharers : numOfIdle;
+		numOfSharers = numOfSharers > 0 ? numOfSharers : 1;
+		size_t batchSize = m_pendingTasks.Size() / numOfSharers;
+
+		size_t maxBatchSize = m_maxDequeueBatchSize;
+		batchSize = batchSize < maxBatchSize ? batchSize : maxBatchSize;
+		return batchSize > 0 ? batchSize : 1;
 	}
 
 
-private: // private functions:
+	bool TryFetchPendingTasks(WorkerState& worker, std::unique_ptr<Task>& task)
+	{
+		// the first one is run right away, and the rest of the batch
+		// are kept by the worker
+		return m_pendingTasks.TryPopBatch(
+			GetDequeueBatchSize(),
+			[&worker, &task](std::unique_ptr<Task> pendingTask)
+			{
+				if (task == nullptr)
+				{
+					task = std::move(pendingTask);
+				}
+				else
+				{
+					worker.PushBack(std::move(pendingTask));
+				}
+			}
+		) > 0;
+	}
+
 
+	/**
+	 * @brief Look for a task for an idle worker, in its own batch, the
+	 *        shared queue, and then the batches of the others.
+	 *
+	 * @return Whether the worker is done waiting, with a task, retired, or
+	 *         terminated.
+	 */
+	bool TryTakeIdleWork(
+		WorkerState& worker,
+		std::unique_ptr<Task>& task,
+		bool& isRetired
+	)
+	{
+		// an adopted worker leaves when told to; otherwise, there are more
+		// workers than needed, since a blocked worker is back; retire this
+		// one
+		isRetired = worker.m_stopToken != nullptr ?
+			worker.m_stopToken->IsStopRequested() :
+			TryRetireWorker();
+		if (isRetired || m_terminated)
+		{
+			return true;
+		}
+
+		// tasks preferring this worker may come while it waits;
+		// then the ones piling up behind busy workers
+		task = worker.PopFront();
+		if (task != nullptr || TryFetchPendingTasks(worker, task))
+		{
+			return true;
+		}
+		size_t threshold = m_affinityStealThreshold;
+		task = StealTask(m_workerSlots, &worker, threshold);
+		if (task == nullptr)
+		{
+			task = StealTask(m_adoptedWorkerSlots, &worker, threshold);
+		}
+		return task != nullptr;
+	}
 
-	void PushTaskToFinishQueue(std::unique_ptr<Task> task)
+
+	/**
+	 * @brief Whether an idle worker may find something to do, judging by
+	 *        counters only, as it is checked under the lock of the waiter.
+	 *
+	 */
+	bool IsIdleWorkAvailable(
+		const WorkerState& worker,
+		uint64_t stealSeq
+	) const
 	{
-		std::lock_guard<std::mutex> lock(m_finishTasksQueueMutex);
-		m_finishTasksQueue.push(std::move(task));
-		++m_finishTasksQueueSize;
+		bool isRetiring = worker.m_stopToken != nullptr ?
+			worker.m_stopToken->IsStopRequested() :
+			m_threadsSize > GetMaxNumOfThreads();
+		return
+			isRetiring ||
+			m_terminated ||
+			(worker.m_localTasksSize > 0) ||
+			(m_pendingTasks.Size() > 0) ||
+			(m_stealSeq != stealSeq);
 	}
 
 
-	std::unique_ptr<Task> BlockingFetchPendingTask()
+	std::unique_ptr<Task> BlockingFetchPendingTask(
+		WorkerState& worker,
+		TaskRunner* taskRunner
+	)
 	{
-		std::unique_lock<std::mutex> lock(m_pendingTasksMutex);
+		std::unique_ptr<Task> task;
 
 		// wait for pending tasks
-		m_pendingTasksCV.wait(
-			lock,
-			[this]()
+		bool isRetired = false;
+		worker.m_isIdle = true;
+		++m_idleWorkersSize;
+		while (true)
+		{
+			// a task left to steal after this point is seen by the check
+			uint64_t stealSeq = m_stealSeq;
+			if (TryTakeIdleWork(worker, task, isRetired))
 			{
-				return (!m_pendingTasks.empty() || m_terminated);
+				break;
 			}
-		);
 
-		if (m_terminated)
-		{
-			return nullptr;
+			// the look-up is made without the lock of the waiter, so the
+			// threads adding tasks are not held up by it
+			m_waiter.Wait(
+				worker.m_waitSlot,
+				[this, &worker, stealSeq]()
+				{
+					return IsIdleWorkAvailable(worker, stealSeq);
+				}
+			);
 		}
-		else
+		--m_idleWorkersSize;
+		worker.m_isIdle = false;
+
+		if (isRetired)
 		{
-			// fetch a pending task
-			--m_pendingTasksSize;
-			std::unique_ptr<Task> task = std::move(m_pendingTasks.front());
-			m_pendingTasks.pop_front();
+			// the tasks preferring this worker go to the others
+			IntrusiveTaskQueue tasks = worker.Retire();
+			if (!tasks.IsEmpty())
+			{
+				while (!tasks.IsEmpty())
+				{
+					m_pendingTasks.Push(tasks.PopFront());
+				}
+				m_waiter.NotifyAll();
+			}
 
-			return task;
+			taskRunner->TerminateTask();
+			return nullptr;
 		}
+
+		// `nullptr` if terminated
+		return task;
 	}
 
 
 	std::unique_ptr<Task> OnTaskFinished(
-		TaskRunner*,
+		WorkerState& worker,
+		TaskRunner* taskRunner,
+		std::unique_ptr<Task> task
+	)
+	{
+		EndRun(worker, taskRunner, std::move(task));
+
+		std::unique_ptr<Task> nextTask = FetchNextTask(worker, taskRunner);
+		if (nextTask != nullptr)
+		{
+			BeginRun(worker, *nextTask);
+		}
+		return nextTask;
+	}
+
+
+	void EndRun(
+		WorkerState& worker,
+		TaskRunner* taskRunner,
 		std::unique_ptr<Task> task
 	)
 	{
-		// push task to finish queue
-		PushTaskToFinishQueue(std::move(task));
+		if (_StatsPolicy::sk_isTrackingRunningTasks)
+		{
+			worker.PublishRunningTask(nullptr);
+		}
+
+		// call or schedule the finishing function
+		this->OnTaskRunEnd(
+			*task, worker.m_runContext, taskRunner->HasTaskThrown()
+		);
+		RecordRunTime(worker.m_runBeginTime);
+		this->CompleteTask(std::move(task));
+
+		// free everything the task allocated from the arena at once
+		worker.m_scratchArena.Reset();
+	}
+
+
+	/**
+	 * @brief Poll for the next low-latency task without ever sleeping.
+	 *
+	 * @return The task, or `nullptr` if the pool is terminated.
+	 */
+	std::unique_ptr<Task> PollNextTask(WorkerState& worker)
+	{
+		LowLatencyQueue& queue = *m_lowLatencyTasks.load();
+		PollingBackoff backoff;
+		std::unique_ptr<Task> task;
+		while (!m_terminated)
+		{
+			if (!queue.TryPop(task))
+			{
+				backoff.Pause();
+				continue;
+			}
+			backoff.Reset();
+
+			Task::TimePoint now = GetBeginTime(*task);
+			if (!ShedIfExpired(task, now))
+			{
+				worker.m_runBeginTime = now;
+				return task;
+			}
+		}
+		return nullptr;
+	}
+
+
+	std::unique_ptr<Task> FetchNextTask(
+		WorkerState& worker,
+		TaskRunner* taskRunner
+	)
+	{
+		while (true)
+		{
+			// run the rest of the batch fetched earlier
+			std::unique_ptr<Task> nextTask;
+			if (!m_terminated && !worker.IsStopRequested())
+			{
+				nextTask = worker.PopFront();
+			}
+
+			// check / wait for pending tasks
+			if (nextTask == nullptr)
+			{
+				nextTask = BlockingFetchPendingTask(worker, taskRunner);
+				if (nextTask == nullptr)
+				{
+					return nullptr;
+				}
+			}
 
-		// check / wait for pending tasks
-		return BlockingFetchPendingTask();
+			Task::TimePoint now = GetBeginTime(*nextTask);
+			if (!ShedIfExpired(nextTask, now))
+			{
+				worker.m_runBeginTime = now;
+				return nextTask;
+			}
+		}
 	}
 
 
-	void CreateNewThread(std::unique_ptr<Task>& task)
+	void JoinRetiredThreadsNonLocking()
 	{
-		std::lock_guard<std::mutex> lock(m_threadsMutex);
-		// lock threads mutex before doing management job
+		// a task runner is only terminated before `Terminate` when its
+		// worker is retired
+		size_t i = 0;
+		while (i < m_threads.size())
+		{
+			if (m_busyTaskRunners[i]->IsTerminated())
+			{
+				m_threads[i].join();
+				m_threads.erase(m_threads.begin() + i);
+				m_busyTaskRunners.erase(m_busyTaskRunners.begin() + i);
+				m_workerSlots.Release(*m_workerStates[i]);
+				m_workerStates.erase(m_workerStates.begin() + i);
+			}
+			else
+			{
+				++i;
+			}
+		}
+	}
 
-		if (m_threads.size() >= m_poolSize)
+
+	void RunAdoptedWorker(WorkerState& worker, TaskRunner& taskRunner)
+	{
+		// the first task is fetched here, since the task runner only waits
+		// for tasks assigned to it
+		std::unique_ptr<Task> task = FetchNextTask(worker, &taskRunner);
+		if (task == nullptr)
 		{
-			// pool is full, do nothing
 			return;
 		}
+		BeginRun(worker, *task);
+		taskRunner.AssignTask(std::move(task));
+
+		taskRunner.ThreadRunner(
+			// callback for finished tasks:
+			[this, &worker](TaskRunner* tr, std::unique_ptr<Task> task)
+			{
+				return OnTaskFinished(worker, tr, std::move(task));
+			}
+		);
+	}
+
+
+	void LeaveAsWorker(
+		WorkerState& worker,
+		TaskRunner& taskRunner,
+		const StopToken& stopToken,
+		uint64_t callbackId
+	)
+	{
+		CurrentWorkerPool() = nullptr;
+		CurrentScratchArena() = nullptr;
+		CurrentWorkerState() = nullptr;
+		stopToken.RemoveCallback(callbackId);
+
+		// the tasks taken but not run go to the other workers
+		IntrusiveTaskQueue tasks = worker.Retire();
+
+		std::lock_guard<Mutex> lock(m_threadsMutex);
+		while (!tasks.IsEmpty())
+		{
+			m_pendingTasks.Push(tasks.PopFront());
+			m_waiter.NotifyOne();
+		}
+		for (size_t i = 0; i < m_adoptedTaskRunners.size(); ++i)
+		{
+			if (m_adoptedTaskRunners[i] == &taskRunner)
+			{
+				m_adoptedTaskRunners.erase(m_adoptedTaskRunners.begin() + i);
+				m_adoptedWorkerStates.erase(m_adoptedWorkerStates.begin() + i);
+				break;
+			}
+		}
+		m_adoptedWorkerSlots.Release(worker);
+	}
+
+
+	void WaitForAdoptedWorkersToLeave()
+	{
+		while (true)
+		{
+			{
+				std::lock_guard<Mutex> lock(m_threadsMutex);
+				if (m_adoptedTaskRunners.empty())
+				{
+					return;
+				}
+
+				// repeat to help the task runners to terminate
+				for (TaskRunner* taskRunner : m_adoptedTaskRunners)
+				{
+					taskRunner->TerminateTask();
+				}
+			}
+			m_waiter.NotifyAll();
+			std::this_thread::yield();
+		}
+	}
+
+
+	void TerminateThreadsNonLocking(
+		std::vector<Thread>& threads,
+		std::vector<std::unique_ptr<TaskRunner> >& taskRunners
+	)
+	{
+		// terminate all task runners
+		for (auto& taskRunner : taskRunners)
+		{
+			// repeat function call to help the task runner to terminate
+			while(!taskRunner->IsTerminated())
+			{
+				m_waiter.NotifyAll();
+				taskRunner->TerminateTask();
+			}
+		}
+
+		// join all threads
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+
+		// clear all threads first
+		threads.clear();
 
+		// now it's safe to clear all task runners
+		taskRunners.clear();
+	}
+
+
+	void CreatePollingThread(size_t cpu, PinResults* pinResults)
+	{
+		std::unique_ptr<WorkerState> workerState(new WorkerState());
+		WorkerState* workerStatePtr = workerState.get();
+		workerStatePtr->m_isPolling = true;
+		m_pollingWorkerStates.emplace_back(std::move(workerState));
+
+		std::unique_ptr<TaskRunner> taskRunner(new TaskRunner());
+		TaskRunner* taskRunnerPtr = taskRunner.get();
+		m_pollingTaskRunners.emplace_back(std::move(taskRunner));
+
+		m_pollingThreads.emplace_back(
+			[this, taskRunnerPtr, workerStatePtr, cpu, pinResults]() {
+				if (pinResults != nullptr)
+				{
+					pinResults->Add(ThreadAffinity::PinCurrentThread(cpu));
+				}
+				CurrentWorkerPool() = this;
+				CurrentScratchArena() = &(workerStatePtr->m_scratchArena);
+				CurrentWorkerState() = workerStatePtr;
+				workerStatePtr->m_threadId = std::this_thread::get_id();
+
+				std::unique_ptr<Task> task = PollNextTask(*workerStatePtr);
+				if (task != nullptr)
+				{
+					BeginRun(*workerStatePtr, *task);
+					taskRunnerPtr->AssignTask(std::move(task));
+				}
+
+				// without a task, it only waits to be terminated
+				taskRunnerPtr->ThreadRunner(
+					// callback for finished tasks:
+					[this, workerStatePtr]
+					(TaskRunner* tr, std::unique_ptr<Task> task)
+					{
+						EndRun(*workerStatePtr, tr, std::move(task));
+
+						std::unique_ptr<Task> nextTask =
+							PollNextTask(*workerStatePtr);
+						if (nextTask != nullptr)
+						{
+							BeginRun(*workerStatePtr, *nextTask);
+						}
+						return nextTask;
+					}
+				);
+			}
+		);
+	}
+
+
+	void CreateNewThreadNonLocking(std::unique_ptr<Task> task)
+	{
 		// pool is not full, create a new thread
 		++m_threadsSize;
 
+		WorkerState* workerStatePtr = &m_workerSlots.Acquire();
+		m_workerStates.push_back(workerStatePtr);
+
 		// Create a new task runner, and assign an initial task to it
+		const Task* firstTaskPtr = task.get();
 		std::unique_ptr<TaskRunner> taskRunner(new TaskRunner());
 		TaskRunner* taskRunnerPtr = taskRunner.get();
 		m_busyTaskRunners.emplace_back(std::move(taskRunner));
@@ -249,12 +1855,28 @@ private: // private functions:
 
 		// create a thread and start the task runner
 		m_threads.emplace_back(
-			[this, taskRunnerPtr]() {
+			[this, taskRunnerPtr, workerStatePtr, firstTaskPtr]() {
+				CurrentWorkerPool() = this;
+				CurrentScratchArena() = &(workerStatePtr->m_scratchArena);
+				CurrentWorkerState() = workerStatePtr;
+				workerStatePtr->m_threadId = std::this_thread::get_id();
+
+				// the run is published, and measured, by the thread running
+				// it, once its ID is known; the task is not run until
+				// `ThreadRunner`
+				workerStatePtr->m_runBeginTime = GetBeginTime(*firstTaskPtr);
+				BeginRun(*workerStatePtr, *firstTaskPtr);
+
 				taskRunnerPtr->ThreadRunner(
 					// callback for finished tasks:
-					[this](TaskRunner* tr, std::unique_ptr<Task> task)
+					[this, workerStatePtr]
+					(TaskRunner* tr, std::unique_ptr<Task> task)
 					{
-						return OnTaskFinished(tr, std::move(task));
+						return OnTaskFinished(
+							*workerStatePtr,
+							tr,
+							std::move(task)
+						);
 					}
 				);
 			}
@@ -262,26 +1884,56 @@ private: // private functions:
 	}
 
 private:
-	size_t m_poolSize;
+	std::atomic<size_t> m_poolSize;
+	std::atomic<size_t> m_maxDequeueBatchSize;
+	std::atomic<size_t> m_maxAffinityBacklog;
+	std::atomic<size_t> m_affinityStealThreshold;
 
 	std::atomic_bool m_terminated;
 
-	mutable std::mutex m_threadsMutex;
-	std::vector<std::thread> m_threads;
+	mutable Mutex m_threadsMutex;
+	std::vector<Thread> m_threads;
 	std::atomic_uint64_t m_threadsSize;
+	std::atomic<size_t> m_blockingWorkersSize;
 	std::vector<std::unique_ptr<TaskRunner> > m_busyTaskRunners;
-	//std::vector<std::unique_ptr<TaskRunner> > m_idleTaskRunners;
+	std::vector<WorkerState*> m_workerStates;
+	WorkerSlots m_workerSlots;
+	// the task runners are owned by the threads adopted through
+	// `JoinAsWorker`
+	std::vector<TaskRunner*> m_adoptedTaskRunners;
+	std::vector<WorkerState*> m_adoptedWorkerStates;
+	WorkerSlots m_adoptedWorkerSlots;
+	// the workers started by `StartPollingWorkers`
+	std::vector<Thread> m_pollingThreads;
+	std::vector<std::unique_ptr<TaskRunner> > m_pollingTaskRunners;
+	std::vector<std::unique_ptr<WorkerState> > m_pollingWorkerStates;
+	std::unique_ptr<LowLatencyQueue> m_lowLatencyTasksOwner;
+	std::atomic<LowLatencyQueue*> m_lowLatencyTasks;
+
+	_QueuePolicy m_pendingTasks;
+	_WaitPolicy m_waiter;
+	std::atomic<size_t> m_idleWorkersSize;
+	// bumped when a task is left for an idle worker to steal
+	std::atomic<uint64_t> m_stealSeq;
+
+	std::atomic<uint64_t> m_numOfExpiredTasks;
+	std::atomic<uint64_t> m_recentQueueTimeNs;
+	std::atomic<uint64_t> m_recentRunTimeNs;
 
-	mutable std::mutex m_pendingTasksMutex;
-	mutable std::condition_variable m_pendingTasksCV;
-	std::atomic_uint64_t m_pendingTasksSize;
-	std::list<std::unique_ptr<Task> > m_pendingTasks;
+}; // class BasicThreadPool
 
-	mutable std::mutex m_finishTasksQueueMutex;
-	std::queue<std::unique_ptr<Task> > m_finishTasksQueue;
-	std::atomic_uint64_t m_finishTasksQueueSize;
 
-}; // class ThreadPool
+/**
+ * @brief The thread pool with the default policies; it supports all
+ *        completion modes, and collects no statistics.
+ *
+ */
+using ThreadPool = BasicThreadPool<
+	LockedQueuePolicy,
+	BlockingWaitPolicy,
+	DefaultCompletionPolicy,
+	NoStatsPolicy
+>;
 
 
 } // namespace Threading
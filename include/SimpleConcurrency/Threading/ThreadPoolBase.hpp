@@ -0,0 +1,192 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+#include <cstdint>
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "Executor.hpp"
+#include "ScratchArena.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief A task being run by a worker, reported by
+ *        `ThreadPoolBase::GetRunningTasks`.
+ *
+ */
+struct RunningTaskInfo
+{
+	std::thread::id m_threadId;
+
+	/**
+	 * @brief The number of tasks the worker started before this one, which
+	 *        tells a task reported again apart from the next one.
+	 *
+	 */
+	uint64_t m_runIndex;
+
+	/**
+	 * @brief The tag of the task (see `Task::SetTag`), or `nullptr`.
+	 *
+	 */
+	const char* m_tag;
+
+	Task::TimePoint m_beginTime;
+
+	/**
+	 * @brief How long it had been running when it was reported.
+	 *
+	 */
+	std::chrono::nanoseconds m_runTime;
+}; // struct RunningTaskInfo
+
+
+/**
+ * @brief The part of the interface of `BasicThreadPool` that does not
+ *        depend on its policies, so that the helpers (e.g., `TaskGroup`,
+ *        `ScopedBlocking`, and the parallel algorithms) work with any
+ *        configuration of the pool.
+ *
+ */
+class ThreadPoolBase :
+	public Executor
+{
+public: // static members:
+
+
+	/**
+	 * @brief Get the pool that the calling thread is a worker of,
+	 *        or `nullptr` if it is not a worker of any pool.
+	 *
+	 */
+	static ThreadPoolBase* GetCurrent()
+	{
+		return CurrentWorkerPool();
+	}
+
+
+	/**
+	 * @brief Get the scratch arena of the calling worker, or `nullptr` if
+	 *        the calling thread is not a pool worker.
+	 *        A task can use it for short-lived allocations in its `Run`
+	 *        function (and an inline `Finishing` function), e.g., with
+	 *        `ArenaAllocator`; it is reset after each task.
+	 *
+	 */
+	static ScratchArena* GetCurrentScratchArena()
+	{
+		return CurrentScratchArena();
+	}
+
+
+public:
+	ThreadPoolBase() = default;
+
+	// LCOV_EXCL_START
+	virtual ~ThreadPoolBase() = default;
+	// LCOV_EXCL_STOP
+
+
+	/**
+	 * @brief Get the max number of workers, not counting the compensating
+	 *        ones (see `BeginBlocking`).
+	 *
+	 */
+	virtual size_t GetPoolSize() const = 0;
+
+
+	/**
+	 * @brief Change the max number of workers at run time; workers beyond
+	 *        the new size retire once they are done with their tasks.
+	 *
+	 */
+	virtual void SetPoolSize(size_t poolSize) = 0;
+
+
+	/**
+	 * @brief Take a pending task, and run it in the calling thread,
+	 *        including its `Finishing` function if it completes inline.
+	 *        This lets a thread waiting for some tasks help to run them,
+	 *        instead of holding up a worker (see `TaskGroup::Wait`).
+	 *
+	 * @return Whether there was a task to run.
+	 */
+	virtual bool RunPendingTask() = 0;
+
+
+	/**
+	 * @brief Tell the pool that the calling worker is about to block;
+	 *        until the matching `EndBlocking`, the pool may run one more
+	 *        worker than its pool size, so that the pending tasks still
+	 *        have a worker.
+	 *        Prefer `ScopedBlocking` to calling this directly.
+	 *
+	 */
+	virtual void BeginBlocking() = 0;
+
+
+	/**
+	 * @brief Tell the pool that the calling worker does not block anymore;
+	 *        a worker beyond the pool size is retired once it is done
+	 *        with its task.
+	 *
+	 */
+	virtual void EndBlocking() = 0;
+
+
+	/**
+	 * @brief Get the tasks being run by the workers right now, and how
+	 *        long they have been running, e.g., to find the ones that hang
+	 *        or hold up the others (see `StallWatchdog`).
+	 *
+	 */
+	virtual std::vector<RunningTaskInfo> GetRunningTasks() const = 0;
+
+
+	/**
+	 * @brief Whether the pool is terminated, after which tasks added to it
+	 *        are never run by its workers.
+	 *
+	 */
+	virtual bool IsTerminated() const = 0;
+
+
+protected:
+
+
+	static ThreadPoolBase*& CurrentWorkerPool()
+	{
+		static thread_local ThreadPoolBase* s_pool = nullptr;
+		return s_pool;
+	}
+
+
+	static ScratchArena*& CurrentScratchArena()
+	{
+		static thread_local ScratchArena* s_arena = nullptr;
+		return s_arena;
+	}
+
+}; // class ThreadPoolBase
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
@@ -0,0 +1,277 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+#pragma once
+
+
+#include <cstddef>
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+
+#include "SyncPrimitives.hpp"
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+namespace SimpleConcurrency
+#else
+namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#endif
+{
+namespace Threading
+{
+
+
+/**
+ * @brief The wait policy of `BasicThreadPool`; idle workers sleep until
+ *        they are notified, each on a condition variable of its own, so
+ *        one particular worker can be woken up without waking the others.
+ *        A wait policy provides:
+ *        - `WaitSlot`, what a worker waits with, one for each worker
+ *        - `Wait(slot, pred)`, which returns once `pred()` returns true;
+ *          `pred` only reads the pool state, and is cheap, as the
+ *          policy may call it under its lock
+ *        - `NotifyOne()` and `NotifyAll()`, which are called after
+ *          anything `pred` checks has changed, with a sequentially
+ *          consistent atomic operation
+ *        - `Notify(slot)`, which wakes up the worker waiting with `slot`,
+ *          if it is waiting
+ *
+ */
+class BlockingWaitPolicy
+{
+public: // types:
+
+	class WaitSlot
+	{
+	public:
+		WaitSlot() :
+			m_cv(),
+			m_prev(nullptr),
+			m_next(nullptr),
+			m_isWaiting(false)
+		{}
+
+		WaitSlot(const WaitSlot&) = delete;
+
+		WaitSlot& operator=(const WaitSlot&) = delete;
+
+	private:
+		friend class BlockingWaitPolicy;
+
+		ConditionVariable m_cv;
+
+		// the list of waiting slots, guarded by the mutex of the policy
+		WaitSlot* m_prev;
+		WaitSlot* m_next;
+		bool m_isWaiting;
+
+	}; // class WaitSlot
+
+
+public:
+	BlockingWaitPolicy() :
+		m_mutex(),
+		m_first(nullptr),
+		m_last(nullptr),
+		m_numOfWaiters(0)
+	{}
+
+
+	template<typename _PredType>
+	void Wait(WaitSlot& slot, _PredType pred)
+	{
+		// counted before the check, so a notifier either sees this waiter,
+		// or has made its change before the check
+		++m_numOfWaiters;
+		{
+			std::unique_lock<Mutex> lock(m_mutex);
+			while (!pred())
+			{
+				// until the slot is unlinked by a notification
+				LinkNonLocking(slot);
+				slot.m_cv.wait(
+					lock,
+					[&slot]()
+					{
+						return !slot.m_isWaiting;
+					}
+				);
+			}
+		}
+		--m_numOfWaiters;
+	}
+
+
+	void NotifyOne()
+	{
+		if (!HasWaiters())
+		{
+			return;
+		}
+
+		// the change is made without the lock; taking it here makes sure a
+		// waiter is either still before its check, or waiting
+		std::lock_guard<Mutex> lock(m_mutex);
+		if (m_last != nullptr)
+		{
+			// the one that waited the least, which has the warmest cache,
+			// and lets the others stay idle long enough to be retired
+			WakeNonLocking(*m_last);
+		}
+	}
+
+
+	void NotifyAll()
+	{
+		if (!HasWaiters())
+		{
+			return;
+		}
+
+		std::lock_guard<Mutex> lock(m_mutex);
+		while (m_first != nullptr)
+		{
+			WakeNonLocking(*m_first);
+		}
+	}
+
+
+	void Notify(WaitSlot& slot)
+	{
+		if (!HasWaiters())
+		{
+			return;
+		}
+
+		std::lock_guard<Mutex> lock(m_mutex);
+		if (slot.m_isWaiting)
+		{
+			WakeNonLocking(slot);
+		}
+	}
+
+
+private: // private functions:
+
+
+	bool HasWaiters() const
+	{
+		// so the lock is only taken if someone may be waiting; the fence
+		// orders the change made by the caller before the load, against
+		// the count made by a waiter before its check
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return m_numOfWaiters.load(std::memory_order_relaxed) > 0;
+	}
+
+
+	void LinkNonLocking(WaitSlot& slot)
+	{
+		slot.m_prev = m_last;
+		slot.m_next = nullptr;
+		if (m_last != nullptr)
+		{
+			m_last->m_next = &slot;
+		}
+		else
+		{
+			m_first = &slot;
+		}
+		m_last = &slot;
+		slot.m_isWaiting = true;
+	}
+
+
+	void UnlinkNonLocking(WaitSlot& slot)
+	{
+		if (!slot.m_isWaiting)
+		{
+			return;
+		}
+		if (slot.m_prev != nullptr)
+		{
+			slot.m_prev->m_next = slot.m_next;
+		}
+		else
+		{
+			m_first = slot.m_next;
+		}
+		if (slot.m_next != nullptr)
+		{
+			slot.m_next->m_prev = slot.m_prev;
+		}
+		else
+		{
+			m_last = slot.m_prev;
+		}
+		slot.m_prev = nullptr;
+		slot.m_next = nullptr;
+		slot.m_isWaiting = false;
+	}
+
+
+	void WakeNonLocking(WaitSlot& slot)
+	{
+		UnlinkNonLocking(slot);
+		slot.m_cv.notify_one();
+	}
+
+
+private:
+
+	Mutex m_mutex;
+	WaitSlot* m_first;
+	WaitSlot* m_last;
+	std::atomic<size_t> m_numOfWaiters;
+
+}; // class BlockingWaitPolicy
+
+
+/**
+ * @brief The wait policy of `BasicThreadPool` where idle workers keep
+ *        polling, and yield in between, instead of sleeping;
+ *        it saves the cost of notifying and waking up workers, at the cost
+ *        of the CPU time of the idle workers.
+ *
+ */
+class SpinWaitPolicy
+{
+public: // types:
+
+	struct WaitSlot
+	{}; // struct WaitSlot
+
+
+public:
+	SpinWaitPolicy() = default;
+
+
+	template<typename _PredType>
+	void Wait(WaitSlot&, _PredType pred)
+	{
+		while (!pred())
+		{
+			std::this_thread::yield();
+		}
+	}
+
+
+	void NotifyOne()
+	{}
+
+
+	void NotifyAll()
+	{}
+
+
+	void Notify(WaitSlot&)
+	{}
+
+}; // class SpinWaitPolicy
+
+
+} // namespace Threading
+} // namespace SimpleConcurrency
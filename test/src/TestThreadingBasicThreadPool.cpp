@@ -0,0 +1,359 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <chrono>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/ProfilingStatsPolicy.hpp>
+#include <SimpleConcurrency/Threading/TaskGroup.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+using SpinningPool = Threading::BasicThreadPool<
+	Threading::LockFreeQueuePolicy<8>,
+	Threading::SpinWaitPolicy,
+	Threading::InlineCompletionPolicy,
+	Threading::NoStatsPolicy
+>;
+
+using CountingPool = Threading::BasicThreadPool<
+	Threading::LockedQueuePolicy,
+	Threading::BlockingWaitPolicy,
+	Threading::DefaultCompletionPolicy,
+	Threading::CountingStatsPolicy
+>;
+
+template<size_t _MaxNumOfTypes>
+using ProfilingPool = Threading::BasicThreadPool<
+	Threading::LockedQueuePolicy,
+	Threading::BlockingWaitPolicy,
+	Threading::InlineCompletionPolicy,
+	Threading::ProfilingStatsPolicy<_MaxNumOfTypes>
+>;
+
+
+template<typename _ThreadLambda>
+void AddTaggedTask(
+	Threading::Executor& executor,
+	const char* tag,
+	std::atomic<int>& numOfFinished,
+	_ThreadLambda threadLambda
+)
+{
+	std::unique_ptr<Threading::Task> task = Threading::MakeLambdaTask(
+		threadLambda,
+		[&numOfFinished]()
+		{
+			++numOfFinished;
+		}
+	);
+	task->SetTag(tag);
+	executor.AddTask(std::move(task));
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, LockFreeQueue)
+{
+	Threading::LockFreeQueuePolicy<4> queue;
+
+	// more than the ring can hold; the overflow keeps the order
+	for (int i = 0; i < 10; ++i)
+	{
+		queue.Push(Threading::MakeLambdaTask(
+			[](const std::atomic_bool&) {}
+		));
+	}
+	EXPECT_EQ(queue.Size(), 10);
+
+	std::unique_ptr<Threading::Task> task;
+	size_t num = queue.TryPopBatch(
+		3,
+		[](std::unique_ptr<Threading::Task> poppedTask)
+		{
+			EXPECT_NE(poppedTask, nullptr);
+		}
+	);
+	EXPECT_EQ(num, 3);
+	EXPECT_EQ(queue.Size(), 7);
+
+	for (int i = 0; i < 7; ++i)
+	{
+		EXPECT_TRUE(queue.TryPop(task));
+		EXPECT_NE(task, nullptr);
+	}
+	EXPECT_FALSE(queue.TryPop(task));
+	EXPECT_EQ(queue.Size(), 0);
+
+	// from many threads at once
+	std::atomic<int> numOfPopped(0);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; ++t)
+	{
+		threads.emplace_back(
+			[&queue, &numOfPopped]()
+			{
+				std::unique_ptr<Threading::Task> poppedTask;
+				for (int i = 0; i < 500; ++i)
+				{
+					queue.Push(Threading::MakeLambdaTask(
+						[](const std::atomic_bool&) {}
+					));
+					if (queue.TryPop(poppedTask))
+					{
+						++numOfPopped;
+					}
+				}
+			}
+		);
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	while (queue.TryPop(task))
+	{
+		++numOfPopped;
+	}
+	EXPECT_EQ(numOfPopped, 2000);
+	EXPECT_EQ(queue.Size(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, SpinningInlinePool)
+{
+	SpinningPool pool(2);
+
+	std::atomic<int> numOfRuns(0);
+	std::atomic<int> numOfFinished(0);
+	for (int i = 0; i < 200; ++i)
+	{
+		// the completion mode is ignored, they are all finished inline
+		std::unique_ptr<Threading::Task> task = Threading::MakeLambdaTask(
+			[&numOfRuns](const std::atomic_bool&)
+			{
+				++numOfRuns;
+			},
+			[&numOfFinished]()
+			{
+				++numOfFinished;
+			}
+		);
+		task->SetCompletionMode(Threading::CompletionMode::Update);
+		pool.AddTask(std::move(task));
+	}
+	while (numOfFinished < 200)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfRuns, 200);
+	EXPECT_EQ(pool.GetNumOfFinishedTasks(), 0);
+	pool.Update();
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, HelpersOnCustomPool)
+{
+	SpinningPool pool(1);
+
+	std::atomic_bool isCurrent(false);
+	std::atomic<int> numOfRuns(0);
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&pool, &isCurrent, &numOfRuns]()
+		{
+			// only a pool of the same type is found
+			isCurrent =
+				SpinningPool::GetCurrent() == &pool &&
+				Threading::ThreadPool::GetCurrent() == nullptr &&
+				Threading::ThreadPoolBase::GetCurrentScratchArena() != nullptr;
+
+			// the only worker runs the subtasks while waiting
+			Threading::TaskGroup subGroup(pool);
+			for (int i = 0; i < 10; ++i)
+			{
+				subGroup.Spawn(
+					[&numOfRuns]()
+					{
+						++numOfRuns;
+					}
+				);
+			}
+			subGroup.Wait();
+		}
+	);
+	group.Wait();
+	EXPECT_TRUE(isCurrent);
+	EXPECT_EQ(numOfRuns, 10);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, CountingStats)
+{
+	CountingPool pool(2);
+	EXPECT_EQ(pool.GetNumOfTasksAdded(), 0);
+
+	std::atomic<int> numOfFinished(0);
+	for (int i = 0; i < 20; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[](const std::atomic_bool&)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			},
+			[&numOfFinished]()
+			{
+				++numOfFinished;
+			}
+		));
+	}
+	EXPECT_EQ(pool.GetNumOfTasksAdded(), 20);
+
+	// the default completion mode is still `Update`
+	while (numOfFinished < 20)
+	{
+		pool.Update();
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(pool.GetNumOfTasksRun(), 20);
+	EXPECT_GE(pool.GetTotalRunTime(), std::chrono::milliseconds(20));
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, ProfilingStats)
+{
+	ProfilingPool<256> pool(2);
+
+	std::atomic<int> numOfFinished(0);
+	for (int i = 0; i < 10; ++i)
+	{
+		AddTaggedTask(
+			pool, nullptr, numOfFinished,
+			[](const std::atomic_bool&)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			}
+		);
+	}
+	for (int i = 0; i < 3; ++i)
+	{
+		AddTaggedTask(
+			pool, nullptr, numOfFinished,
+			[](const std::atomic_bool&)
+			{
+				throw std::runtime_error("Task failed");
+			}
+		);
+	}
+	// different types with the same tag are accounted for together;
+	// tags are told apart by their addresses, so it is one pointer
+	static const char* const sk_tag = "tagged";
+	for (int i = 0; i < 2; ++i)
+	{
+		AddTaggedTask(
+			pool, sk_tag, numOfFinished, [](const std::atomic_bool&) {}
+		);
+		AddTaggedTask(
+			pool, sk_tag, numOfFinished, [](const std::atomic_bool&) { }
+		);
+	}
+	while (numOfFinished < 17)
+	{
+		std::this_thread::yield();
+	}
+
+	std::vector<Threading::TaskTypeProfile> profiles =
+		pool.GetTaskTypeProfiles();
+	ASSERT_EQ(profiles.size(), 3);
+	uint64_t numOfExceptions = 0;
+	for (const auto& profile : profiles)
+	{
+		numOfExceptions += profile.m_numOfExceptions;
+		if (profile.m_name == sk_tag)
+		{
+			EXPECT_EQ(profile.m_numOfRuns, 4);
+		}
+		else if (profile.m_numOfExceptions > 0)
+		{
+			EXPECT_EQ(profile.m_numOfRuns, 3);
+		}
+	}
+	EXPECT_EQ(numOfExceptions, 3);
+
+	// the sleeping tasks use the most run time
+	profiles = pool.GetTopTaskTypes(1);
+	ASSERT_EQ(profiles.size(), 1);
+	EXPECT_EQ(profiles[0].m_numOfRuns, 10);
+	EXPECT_GE(profiles[0].m_runTime, std::chrono::milliseconds(10));
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_BasicThreadPool, ProfilingStatsOverflow)
+{
+	ProfilingPool<1> pool(1);
+
+	std::atomic<int> numOfFinished(0);
+	AddTaggedTask(pool, "a", numOfFinished, [](const std::atomic_bool&) {});
+	AddTaggedTask(pool, "b", numOfFinished, [](const std::atomic_bool&) {});
+	AddTaggedTask(pool, "b", numOfFinished, [](const std::atomic_bool&) {});
+	while (numOfFinished < 3)
+	{
+		std::this_thread::yield();
+	}
+
+	// only one type fits in the table
+	std::vector<Threading::TaskTypeProfile> profiles =
+		pool.GetTopTaskTypes(10);
+	ASSERT_EQ(profiles.size(), 2);
+	EXPECT_EQ(profiles[0].m_numOfRuns + profiles[1].m_numOfRuns, 3);
+	EXPECT_TRUE(
+		profiles[0].m_name == "(other)" || profiles[1].m_name == "(other)"
+	);
+
+	pool.Terminate();
+}
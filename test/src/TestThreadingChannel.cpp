@@ -0,0 +1,382 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/Channel.hpp>
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+class TestQueueExecutor :
+	public Threading::Executor
+{
+public:
+	TestQueueExecutor() = default;
+
+	virtual ~TestQueueExecutor() = default;
+
+	virtual void AddTask(std::unique_ptr<Threading::Task> task) override
+	{
+		m_tasks.push_back(std::move(task));
+	}
+
+	size_t RunAll()
+	{
+		size_t count = m_tasks.size();
+		std::vector<std::unique_ptr<Threading::Task> > tasks;
+		tasks.swap(m_tasks);
+		for (auto& task : tasks)
+		{
+			task->Run();
+		}
+		return count;
+	}
+
+	std::vector<std::unique_ptr<Threading::Task> > m_tasks;
+}; // class TestQueueExecutor
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_Channel, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_Channel, SpscSendReceive)
+{
+	EXPECT_THROW(Threading::SpscChannel<int>(0), std::invalid_argument);
+
+	Threading::SpscChannel<int> channel(5);
+	EXPECT_EQ(channel.GetCapacity(), 8);
+
+	// wrap around the buffer multiple times
+	int expVal = 0;
+	int sendVal = 0;
+	for (size_t round = 0; round < 5; ++round)
+	{
+		while (channel.TrySend(sendVal))
+		{
+			++sendVal;
+		}
+		EXPECT_EQ(channel.GetSize(), 8);
+
+		int val = -1;
+		for (size_t i = 0; i < 5; ++i)
+		{
+			ASSERT_TRUE(channel.TryReceive(val));
+			EXPECT_EQ(val, expVal++);
+		}
+		EXPECT_EQ(channel.GetSize(), 3);
+	}
+
+	int val = -1;
+	while (channel.TryReceive(val))
+	{
+		EXPECT_EQ(val, expVal++);
+	}
+	EXPECT_EQ(expVal, sendVal);
+	EXPECT_EQ(channel.GetSize(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_Channel, BatchSendReceive)
+{
+	std::vector<std::unique_ptr<int> > input;
+	for (int i = 0; i < 10; ++i)
+	{
+		input.emplace_back(new int(i));
+	}
+
+	Threading::SpscChannel<std::unique_ptr<int> > spsc(8);
+	Threading::MpscChannel<std::unique_ptr<int> > mpsc(8);
+
+	// only the leading values that fit are sent, and moved out
+	EXPECT_EQ(spsc.TrySendBatch(input.begin(), input.begin() + 5), 5);
+	EXPECT_EQ(spsc.TrySendBatch(input.begin() + 5, input.end()), 3);
+	EXPECT_EQ(input[7], nullptr);
+	ASSERT_NE(input[8], nullptr);
+
+	std::vector<std::unique_ptr<int> > output(10);
+	EXPECT_EQ(spsc.TryReceiveBatch(output.begin(), 6), 6);
+	EXPECT_EQ(spsc.TryReceiveBatch(output.begin() + 6, 6), 2);
+	EXPECT_EQ(spsc.TryReceiveBatch(output.begin() + 8, 6), 0);
+	for (int i = 0; i < 8; ++i)
+	{
+		ASSERT_NE(output[i], nullptr);
+		EXPECT_EQ(*output[i], i);
+	}
+
+	for (int i = 0; i < 8; ++i)
+	{
+		input[i] = std::move(output[i]);
+	}
+	EXPECT_EQ(mpsc.TrySendBatch(input.begin(), input.begin() + 5), 5);
+	EXPECT_EQ(mpsc.TrySendBatch(input.begin() + 5, input.end()), 3);
+	EXPECT_EQ(mpsc.TrySendBatch(input.begin() + 8, input.end()), 0);
+	EXPECT_EQ(mpsc.TryReceiveBatch(output.begin(), 10), 8);
+	for (int i = 0; i < 8; ++i)
+	{
+		ASSERT_NE(output[i], nullptr);
+		EXPECT_EQ(*output[i], i);
+	}
+
+	// values left in the channel are destroyed with the channel
+	EXPECT_EQ(mpsc.TrySendBatch(input.begin() + 8, input.end()), 2);
+	EXPECT_EQ(mpsc.GetSize(), 2);
+}
+
+
+GTEST_TEST(Test_Threading_Channel, SpscConcurrent)
+{
+	const uint64_t numOfVals = 10000;
+	Threading::SpscChannel<uint64_t> channel(64);
+
+	std::thread producer(
+		[&channel, numOfVals]()
+		{
+			std::vector<uint64_t> batch;
+			uint64_t next = 0;
+			while (next < numOfVals)
+			{
+				batch.clear();
+				for (uint64_t i = next; i < numOfVals && batch.size() < 16; ++i)
+				{
+					batch.push_back(i);
+				}
+				size_t count = channel.TrySendBatch(batch.begin(), batch.end());
+				if (count == 0)
+				{
+					std::this_thread::yield();
+				}
+				next += count;
+			}
+			channel.Close();
+		}
+	);
+
+	uint64_t expVal = 0;
+	uint64_t buf[32];
+	while (!channel.IsDrained())
+	{
+		size_t count = channel.TryReceiveBatch(buf, 32);
+		for (size_t i = 0; i < count; ++i)
+		{
+			ASSERT_EQ(buf[i], expVal++);
+		}
+		if (count == 0)
+		{
+			std::this_thread::yield();
+		}
+	}
+	producer.join();
+
+	EXPECT_EQ(expVal, numOfVals);
+	EXPECT_FALSE(channel.TrySend(0));
+}
+
+
+GTEST_TEST(Test_Threading_Channel, MpscConcurrent)
+{
+	const uint64_t numOfProducers = 4;
+	const uint64_t numOfVals = 5000;
+	Threading::MpscChannel<uint64_t> channel(128);
+
+	std::vector<std::thread> producers;
+	for (uint64_t p = 0; p < numOfProducers; ++p)
+	{
+		producers.emplace_back(
+			[&channel, numOfVals, p]()
+			{
+				for (uint64_t i = 0; i < numOfVals; ++i)
+				{
+					// the producer id is in the high bits
+					while (!channel.TrySend((p << 32) | i))
+					{
+						std::this_thread::yield();
+					}
+				}
+			}
+		);
+	}
+
+	// values from the same producer must arrive in order
+	std::vector<uint64_t> nextVals(numOfProducers, 0);
+	uint64_t received = 0;
+	uint64_t buf[32];
+	while (received < numOfProducers * numOfVals)
+	{
+		size_t count = channel.TryReceiveBatch(buf, 32);
+		for (size_t i = 0; i < count; ++i)
+		{
+			uint64_t p = buf[i] >> 32;
+			ASSERT_LT(p, numOfProducers);
+			ASSERT_EQ(buf[i] & 0xFFFFFFFFULL, nextVals[p]++);
+		}
+		if (count == 0)
+		{
+			std::this_thread::yield();
+		}
+		received += count;
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+	for (uint64_t p = 0; p < numOfProducers; ++p)
+	{
+		EXPECT_EQ(nextVals[p], numOfVals);
+	}
+	EXPECT_EQ(channel.GetSize(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_Channel, WaitingTasks)
+{
+	TestQueueExecutor executor;
+	Threading::SpscChannel<int> channel(2);
+
+	int numOfRuns = 0;
+	auto waiterFunc =
+		[&numOfRuns](const std::atomic_bool&)
+		{
+			++numOfRuns;
+		};
+
+	// empty channel; the reader waits
+	channel.WhenReadable(executor, Threading::MakeLambdaTask(waiterFunc));
+	EXPECT_EQ(executor.RunAll(), 0);
+
+	// sending wakes up the reader
+	EXPECT_TRUE(channel.TrySend(1));
+	EXPECT_EQ(executor.RunAll(), 1);
+	EXPECT_EQ(numOfRuns, 1);
+
+	// non-empty channel; the reader is submitted right away
+	channel.WhenReadable(executor, Threading::MakeLambdaTask(waiterFunc));
+	EXPECT_EQ(executor.RunAll(), 1);
+
+	// full channel; the writer waits
+	EXPECT_TRUE(channel.TrySend(2));
+	EXPECT_FALSE(channel.TrySend(3));
+	channel.WhenWritable(executor, Threading::MakeLambdaTask(waiterFunc));
+	EXPECT_EQ(executor.RunAll(), 0);
+
+	// receiving wakes up the writer
+	int val = 0;
+	EXPECT_TRUE(channel.TryReceive(val));
+	EXPECT_EQ(val, 1);
+	EXPECT_EQ(executor.RunAll(), 1);
+	EXPECT_EQ(numOfRuns, 3);
+
+	// closing wakes up the reader
+	EXPECT_TRUE(channel.TryReceive(val));
+	EXPECT_EQ(val, 2);
+	channel.WhenReadable(executor, Threading::MakeLambdaTask(waiterFunc));
+	EXPECT_EQ(executor.RunAll(), 0);
+	EXPECT_FALSE(channel.IsDrained());
+	channel.Close();
+	EXPECT_EQ(executor.RunAll(), 1);
+	EXPECT_TRUE(channel.IsDrained());
+	EXPECT_EQ(numOfRuns, 4);
+}
+
+
+GTEST_TEST(Test_Threading_Channel, ConsumerTaskOnPool)
+{
+	const int numOfVals = 1000;
+
+	Threading::ThreadPool pool(2);
+	Threading::MpscChannel<int> channel(16);
+
+	std::atomic<int> sum(0);
+	std::atomic_bool isDone(false);
+
+	// a consumer task receives what is available, and then gives its worker
+	// back to the pool until there are more values
+	struct Consumer
+	{
+		static void Arm(
+			Threading::ThreadPool& pool,
+			Threading::MpscChannel<int>& channel,
+			std::atomic<int>& sum,
+			std::atomic_bool& isDone
+		)
+		{
+			channel.WhenReadable(
+				pool,
+				Threading::MakeLambdaTask(
+					[&pool, &channel, &sum, &isDone](const std::atomic_bool&)
+					{
+						int buf[8];
+						size_t count = 0;
+						while ((count = channel.TryReceiveBatch(buf, 8)) > 0)
+						{
+							for (size_t i = 0; i < count; ++i)
+							{
+								sum += buf[i];
+							}
+						}
+
+						if (channel.IsDrained())
+						{
+							isDone = true;
+						}
+						else
+						{
+							Arm(pool, channel, sum, isDone);
+						}
+					}
+				)
+			);
+		}
+	}; // struct Consumer
+
+	Consumer::Arm(pool, channel, sum, isDone);
+
+	for (int i = 1; i <= numOfVals; ++i)
+	{
+		while (!channel.TrySend(i))
+		{
+			std::this_thread::yield();
+		}
+	}
+	channel.Close();
+
+	while (!isDone)
+	{
+		pool.Update();
+	}
+	EXPECT_EQ(sum, numOfVals * (numOfVals + 1) / 2);
+
+	pool.Terminate();
+}
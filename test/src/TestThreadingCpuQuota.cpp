@@ -0,0 +1,258 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdio>
+
+#include <atomic>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/CpuQuota.hpp>
+#include <SimpleConcurrency/Threading/ThreadAffinity.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+#ifdef __linux__
+#include <sched.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // __linux__
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+GTEST_TEST(Test_Threading_CpuQuota, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_CpuQuota, Parse)
+{
+	EXPECT_DOUBLE_EQ(Threading::CpuQuota::ParseCpuMax("150000 100000\n"), 1.5);
+	EXPECT_DOUBLE_EQ(Threading::CpuQuota::ParseCpuMax("max 100000\n"), 0.0);
+	EXPECT_DOUBLE_EQ(Threading::CpuQuota::ParseCpuMax(""), 0.0);
+
+	EXPECT_DOUBLE_EQ(Threading::CpuQuota::ParseCfsQuota(400000, 100000), 4.0);
+	EXPECT_DOUBLE_EQ(Threading::CpuQuota::ParseCfsQuota(-1, 100000), 0.0);
+}
+
+
+GTEST_TEST(Test_Threading_CpuQuota, DefaultPoolSize)
+{
+	size_t numOfCpus = Threading::CpuQuota::GetNumOfAffinityCpus();
+	size_t poolSize = Threading::CpuQuota::GetDefaultPoolSize();
+	EXPECT_GE(numOfCpus, 1);
+	EXPECT_GE(poolSize, 1);
+	EXPECT_LE(poolSize, numOfCpus);
+
+	// a pool sized by the CPUs available
+	Threading::ThreadPool pool(poolSize);
+	EXPECT_EQ(pool.GetPoolSize(), poolSize);
+	pool.Terminate();
+}
+
+
+#ifdef __linux__
+
+
+namespace
+{
+
+// a fake cgroup file system in a temporary directory
+struct FakeCgroupFs
+{
+	FakeCgroupFs() :
+		m_root(),
+		m_files(),
+		m_dirs()
+	{
+		char tmpl[] = "/tmp/SimpleConcurrency_cgroup_XXXXXX";
+		char* root = mkdtemp(tmpl);
+		EXPECT_NE(root, nullptr);
+		m_root = root != nullptr ? root : "";
+	}
+
+	~FakeCgroupFs()
+	{
+		for (const auto& file : m_files)
+		{
+			std::remove(file.c_str());
+		}
+		for (auto it = m_dirs.rbegin(); it != m_dirs.rend(); ++it)
+		{
+			rmdir(it->c_str());
+		}
+		rmdir(m_root.c_str());
+	}
+
+	void MakeDir(const std::string& dir)
+	{
+		std::string path = m_root + dir;
+		EXPECT_EQ(mkdir(path.c_str(), 0700), 0);
+		m_dirs.push_back(path);
+	}
+
+	void WriteFile(const std::string& file, const std::string& content)
+	{
+		std::string path = m_root + file;
+		std::ofstream(path) << content;
+		m_files.push_back(path);
+	}
+
+	double GetQuota(const std::string& procCgroupFile)
+	{
+		return Threading::CpuQuota::GetCgroupCpuQuota(
+			m_root + procCgroupFile, m_root + "/fs"
+		);
+	}
+
+	std::string m_root;
+	std::vector<std::string> m_files;
+	std::vector<std::string> m_dirs;
+}; // struct FakeCgroupFs
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_CpuQuota, CgroupV2)
+{
+	FakeCgroupFs fs;
+	fs.MakeDir("/fs");
+	fs.MakeDir("/fs/app");
+	fs.MakeDir("/fs/app/worker");
+	fs.WriteFile("/cgroup", "0::/app/worker\n");
+
+	// no limit anywhere
+	EXPECT_DOUBLE_EQ(fs.GetQuota("/cgroup"), 0.0);
+
+	// the tightest limit along the path applies
+	fs.WriteFile("/fs/cpu.max", "max 100000\n");
+	fs.WriteFile("/fs/app/cpu.max", "250000 100000\n");
+	fs.WriteFile("/fs/app/worker/cpu.max", "400000 100000\n");
+	EXPECT_DOUBLE_EQ(fs.GetQuota("/cgroup"), 2.5);
+
+	// a path outside of the mount, as in a container without a cgroup
+	// namespace, falls back to the root of the mount
+	fs.WriteFile("/cgroup2", "0::/docker/abc\n");
+	fs.WriteFile("/fs/cpu.max", "50000 100000\n");
+	EXPECT_DOUBLE_EQ(fs.GetQuota("/cgroup2"), 0.5);
+}
+
+
+GTEST_TEST(Test_Threading_CpuQuota, CgroupV1)
+{
+	FakeCgroupFs fs;
+	fs.MakeDir("/fs");
+	fs.MakeDir("/fs/cpu,cpuacct");
+	fs.MakeDir("/fs/cpu,cpuacct/app");
+	fs.WriteFile(
+		"/cgroup",
+		"12:memory:/app\n"
+		"3:cpu,cpuacct:/app\n"
+	);
+	fs.WriteFile("/fs/cpu,cpuacct/cpu.cfs_quota_us", "-1\n");
+	fs.WriteFile("/fs/cpu,cpuacct/cpu.cfs_period_us", "100000\n");
+	fs.WriteFile("/fs/cpu,cpuacct/app/cpu.cfs_quota_us", "300000\n");
+	fs.WriteFile("/fs/cpu,cpuacct/app/cpu.cfs_period_us", "100000\n");
+
+	EXPECT_DOUBLE_EQ(fs.GetQuota("/cgroup"), 3.0);
+}
+
+
+#endif // __linux__
+
+
+GTEST_TEST(Test_Threading_CpuQuota, Watcher)
+{
+	Threading::ThreadPool pool(1);
+	std::atomic<size_t> quotaCpus(3);
+
+	{
+		Threading::CpuQuotaWatcher watcher(
+			pool,
+			std::chrono::milliseconds(1),
+			[&quotaCpus]()
+			{
+				return quotaCpus.load();
+			}
+		);
+		while (pool.GetPoolSize() != 3)
+		{
+			std::this_thread::yield();
+		}
+
+		// it follows a changed quota
+		quotaCpus = 2;
+		while (pool.GetPoolSize() != 2)
+		{
+			std::this_thread::yield();
+		}
+	}
+
+	// not after it is stopped
+	quotaCpus = 5;
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	EXPECT_EQ(pool.GetPoolSize(), 2);
+
+	pool.Terminate();
+}
+
+
+#ifdef __linux__
+
+
+GTEST_TEST(Test_Threading_CpuQuota, PinCurrentThread)
+{
+	// the first CPU this process can use
+	cpu_set_t cpuSet;
+	CPU_ZERO(&cpuSet);
+	ASSERT_EQ(sched_getaffinity(0, sizeof(cpuSet), &cpuSet), 0);
+	size_t cpu = 0;
+	while (!CPU_ISSET(cpu, &cpuSet))
+	{
+		++cpu;
+	}
+
+	std::atomic_bool isPinned(false);
+	std::atomic_int runningCpu(-1);
+	std::atomic_bool isOutOfRangePinned(true);
+	std::thread thread(
+		[cpu, &isPinned, &runningCpu, &isOutOfRangePinned]()
+		{
+			isOutOfRangePinned =
+				Threading::ThreadAffinity::PinCurrentThread(CPU_SETSIZE);
+			isPinned = Threading::ThreadAffinity::PinCurrentThread(cpu);
+			runningCpu = sched_getcpu();
+		}
+	);
+	thread.join();
+
+	EXPECT_FALSE(isOutOfRangePinned);
+	EXPECT_TRUE(isPinned);
+	EXPECT_EQ(runningCpu.load(), static_cast<int>(cpu));
+}
+
+
+#endif // __linux__
@@ -0,0 +1,186 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+
+
+/**
+ * @brief A mutex counting how many times it is locked, to show that the
+ *        pool uses the customized type.
+ *
+ */
+class CountingSyncMutex
+{
+public:
+	static std::atomic<uint64_t> sm_numOfLocks;
+
+
+	void lock()
+	{
+		m_mutex.lock();
+		++sm_numOfLocks;
+	}
+
+
+	bool try_lock()
+	{
+		if (m_mutex.try_lock())
+		{
+			++sm_numOfLocks;
+			return true;
+		}
+		return false;
+	}
+
+
+	void unlock()
+	{
+		m_mutex.unlock();
+	}
+
+
+private:
+	std::mutex m_mutex;
+}; // class CountingSyncMutex
+
+
+/**
+ * @brief A thread counting how many threads are started with it.
+ *
+ */
+class CountingSyncThread
+{
+public:
+	static std::atomic<uint64_t> sm_numOfStarted;
+
+
+	CountingSyncThread() = default;
+
+	template<typename _FuncType>
+	explicit CountingSyncThread(_FuncType func) :
+		m_thread(std::move(func))
+	{
+		++sm_numOfStarted;
+	}
+
+	CountingSyncThread(CountingSyncThread&&) = default;
+
+	CountingSyncThread& operator=(CountingSyncThread&&) = default;
+
+
+	bool joinable() const
+	{
+		return m_thread.joinable();
+	}
+
+
+	void join()
+	{
+		m_thread.join();
+	}
+
+
+private:
+	std::thread m_thread;
+}; // class CountingSyncThread
+
+
+std::atomic<uint64_t> CountingSyncMutex::sm_numOfLocks(0);
+std::atomic<uint64_t> CountingSyncThread::sm_numOfStarted(0);
+
+} // namespace SimpleConcurrency_Test
+
+
+// the pool built with these types is put in a namespace of its own, so it
+// does not clash with the one built with the defaults in the other tests
+#undef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+#define SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE \
+	SimpleConcurrency_CustomizedSync
+#define SIMPLECONCURRENCY_CUSTOMIZED_MUTEX \
+	SimpleConcurrency_Test::CountingSyncMutex
+#define SIMPLECONCURRENCY_CUSTOMIZED_CONDITION_VARIABLE \
+	std::condition_variable_any
+#define SIMPLECONCURRENCY_CUSTOMIZED_THREAD \
+	SimpleConcurrency_Test::CountingSyncThread
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/TaskGroup.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+using SimpleConcurrency_Test::CountingSyncMutex;
+using SimpleConcurrency_Test::CountingSyncThread;
+
+
+GTEST_TEST(Test_Threading_CustomizedSync, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_CustomizedSync, ThreadPool)
+{
+	static constexpr size_t sk_poolSize = 2;
+	static constexpr uint64_t sk_numOfTasks = 100;
+
+	CountingSyncMutex::sm_numOfLocks = 0;
+	CountingSyncThread::sm_numOfStarted = 0;
+
+	Threading::ThreadPool pool(sk_poolSize);
+	std::atomic_uint64_t count(0);
+	for (uint64_t i = 0; i < sk_numOfTasks; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&count](const std::atomic_bool&)
+				{
+					++count;
+				}
+			)
+		);
+	}
+	while (count < sk_numOfTasks)
+	{
+		std::this_thread::yield();
+	}
+
+	// the group waits with the customized types too
+	Threading::TaskGroup group(pool);
+	for (uint64_t i = 0; i < sk_numOfTasks; ++i)
+	{
+		group.Spawn(
+			[&count]()
+			{
+				++count;
+			}
+		);
+	}
+	group.Wait();
+	EXPECT_EQ(count.load(), 2 * sk_numOfTasks);
+
+	pool.Terminate();
+
+	EXPECT_GT(CountingSyncMutex::sm_numOfLocks.load(), 0);
+	EXPECT_GT(CountingSyncThread::sm_numOfStarted.load(), 0);
+	EXPECT_LE(CountingSyncThread::sm_numOfStarted.load(), sk_poolSize);
+}
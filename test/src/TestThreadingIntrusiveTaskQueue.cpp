@@ -0,0 +1,263 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/IntrusiveTaskQueue.hpp>
+#include <SimpleConcurrency/Threading/IntrusiveTaskStack.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+class IdTask :
+	public Threading::Task
+{
+public:
+	IdTask(int id, std::atomic<int>& numOfAlive) :
+		m_id(id),
+		m_numOfAlive(numOfAlive)
+	{
+		++m_numOfAlive;
+	}
+
+	virtual ~IdTask()
+	{
+		--m_numOfAlive;
+	}
+
+	virtual void Run() override
+	{}
+
+	virtual void Terminate() override
+	{}
+
+	int m_id;
+	std::atomic<int>& m_numOfAlive;
+}; // class IdTask
+
+
+int PopId(std::unique_ptr<Threading::Task> task)
+{
+	return task == nullptr ? -1 : static_cast<IdTask&>(*task).m_id;
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_IntrusiveTaskQueue, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_IntrusiveTaskQueue, PushPop)
+{
+	std::atomic<int> numOfAlive(0);
+	Threading::IntrusiveTaskQueue queue;
+	EXPECT_TRUE(queue.IsEmpty());
+	EXPECT_EQ(PopId(queue.PopFront()), -1);
+	EXPECT_EQ(PopId(queue.PopBack()), -1);
+
+	// 0 1 2 3
+	queue.PushBack(std::unique_ptr<Threading::Task>(new IdTask(1, numOfAlive)));
+	queue.PushBack(std::unique_ptr<Threading::Task>(new IdTask(2, numOfAlive)));
+	queue.PushFront(std::unique_ptr<Threading::Task>(new IdTask(0, numOfAlive)));
+	queue.PushBack(std::unique_ptr<Threading::Task>(new IdTask(3, numOfAlive)));
+	EXPECT_EQ(queue.Size(), 4);
+
+	EXPECT_EQ(PopId(queue.PopFront()), 0);
+	EXPECT_EQ(PopId(queue.PopBack()), 3);
+	EXPECT_EQ(PopId(queue.PopBack()), 2);
+	EXPECT_EQ(PopId(queue.PopFront()), 1);
+	EXPECT_TRUE(queue.IsEmpty());
+	EXPECT_EQ(queue.Size(), 0);
+	EXPECT_EQ(numOfAlive, 0);
+
+	// the remaining tasks are deleted with the queue
+	{
+		Threading::IntrusiveTaskQueue queue2;
+		queue2.PushBack(
+			std::unique_ptr<Threading::Task>(new IdTask(0, numOfAlive))
+		);
+		queue2.PushBack(
+			std::unique_ptr<Threading::Task>(new IdTask(1, numOfAlive))
+		);
+		Threading::IntrusiveTaskQueue queue3(std::move(queue2));
+		EXPECT_TRUE(queue2.IsEmpty());
+		EXPECT_EQ(queue3.Size(), 2);
+		EXPECT_EQ(numOfAlive, 2);
+	}
+	EXPECT_EQ(numOfAlive, 0);
+}
+
+
+GTEST_TEST(Test_Threading_IntrusiveTaskQueue, Splice)
+{
+	std::atomic<int> numOfAlive(0);
+	Threading::IntrusiveTaskQueue queue;
+	Threading::IntrusiveTaskQueue other;
+
+	// splicing empty queues
+	queue.SpliceBack(other);
+	queue.SpliceFront(other);
+	EXPECT_TRUE(queue.IsEmpty());
+
+	for (int i = 2; i < 4; ++i)
+	{
+		queue.PushBack(
+			std::unique_ptr<Threading::Task>(new IdTask(i, numOfAlive))
+		);
+	}
+	for (int i = 0; i < 2; ++i)
+	{
+		other.PushBack(
+			std::unique_ptr<Threading::Task>(new IdTask(i, numOfAlive))
+		);
+	}
+	queue.SpliceFront(other);
+	EXPECT_TRUE(other.IsEmpty());
+
+	for (int i = 4; i < 6; ++i)
+	{
+		other.PushBack(
+			std::unique_ptr<Threading::Task>(new IdTask(i, numOfAlive))
+		);
+	}
+	queue.SpliceBack(other);
+	EXPECT_TRUE(other.IsEmpty());
+	EXPECT_EQ(queue.Size(), 6);
+
+	// into an empty queue
+	other.SpliceBack(queue);
+	EXPECT_TRUE(queue.IsEmpty());
+	EXPECT_EQ(other.Size(), 6);
+
+	for (int i = 0; i < 6; ++i)
+	{
+		EXPECT_EQ(PopId(other.PopFront()), i);
+	}
+	EXPECT_EQ(numOfAlive, 0);
+
+	other.PushBack(
+		std::unique_ptr<Threading::Task>(new IdTask(0, numOfAlive))
+	);
+	other.Clear();
+	EXPECT_TRUE(other.IsEmpty());
+	EXPECT_EQ(numOfAlive, 0);
+}
+
+
+GTEST_TEST(Test_Threading_IntrusiveTaskQueue, Stack)
+{
+	std::atomic<int> numOfAlive(0);
+	Threading::IntrusiveTaskStack stack;
+	EXPECT_TRUE(stack.IsEmpty());
+	EXPECT_TRUE(stack.PopAll().IsEmpty());
+
+	// taken in the order pushed
+	for (int i = 0; i < 3; ++i)
+	{
+		stack.Push(std::unique_ptr<Threading::Task>(new IdTask(i, numOfAlive)));
+	}
+	EXPECT_FALSE(stack.IsEmpty());
+	Threading::IntrusiveTaskQueue tasks = stack.PopAll();
+	EXPECT_TRUE(stack.IsEmpty());
+	EXPECT_EQ(tasks.Size(), 3);
+	for (int i = 0; i < 3; ++i)
+	{
+		EXPECT_EQ(PopId(tasks.PopFront()), i);
+	}
+	EXPECT_EQ(numOfAlive, 0);
+
+	// the remaining tasks are deleted with the stack
+	{
+		Threading::IntrusiveTaskStack stack2;
+		stack2.Push(
+			std::unique_ptr<Threading::Task>(new IdTask(0, numOfAlive))
+		);
+		EXPECT_EQ(numOfAlive, 1);
+	}
+	EXPECT_EQ(numOfAlive, 0);
+}
+
+
+GTEST_TEST(Test_Threading_IntrusiveTaskQueue, StackMultiProducer)
+{
+	static constexpr int sk_numOfThreads = 4;
+	static constexpr int sk_numOfTasks = 1000;
+
+	std::atomic<int> numOfAlive(0);
+	Threading::IntrusiveTaskStack stack;
+	std::vector<int> lastIds(sk_numOfThreads, -1);
+	int numOfTaken = 0;
+
+	std::vector<std::thread> producers;
+	for (int t = 0; t < sk_numOfThreads; ++t)
+	{
+		producers.emplace_back(
+			[&stack, &numOfAlive, t]()
+			{
+				for (int i = 0; i < sk_numOfTasks; ++i)
+				{
+					stack.Push(std::unique_ptr<Threading::Task>(
+						new IdTask(t * sk_numOfTasks + i, numOfAlive)
+					));
+				}
+			}
+		);
+	}
+
+	// tasks of each producer are taken in the order they were pushed
+	auto takeAll =
+		[&stack, &lastIds, &numOfTaken]()
+		{
+			Threading::IntrusiveTaskQueue tasks = stack.PopAll();
+			while (!tasks.IsEmpty())
+			{
+				int id = PopId(tasks.PopFront());
+				int producer = id / sk_numOfTasks;
+				EXPECT_GT(id, lastIds[producer]);
+				lastIds[producer] = id;
+				++numOfTaken;
+			}
+		};
+	while (numOfTaken < sk_numOfThreads * sk_numOfTasks / 2)
+	{
+		takeAll();
+		std::this_thread::yield();
+	}
+
+	for (auto& producer : producers)
+	{
+		producer.join();
+	}
+	takeAll();
+	EXPECT_EQ(numOfTaken, sk_numOfThreads * sk_numOfTasks);
+	EXPECT_EQ(numOfAlive, 0);
+}
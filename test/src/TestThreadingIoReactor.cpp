@@ -0,0 +1,363 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdio>
+
+#include <atomic>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/IoReactor.hpp>
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <unistd.h>
+#endif // __linux__
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+GTEST_TEST(Test_Threading_IoReactor, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+#ifdef __linux__
+
+
+namespace
+{
+
+struct TestPipe
+{
+	TestPipe()
+	{
+		int fds[2] = { -1, -1 };
+		EXPECT_EQ(pipe2(fds, O_NONBLOCK | O_CLOEXEC), 0);
+		m_readFd = fds[0];
+		m_writeFd = fds[1];
+	}
+
+	~TestPipe()
+	{
+		close(m_readFd);
+		close(m_writeFd);
+	}
+
+	int m_readFd;
+	int m_writeFd;
+}; // struct TestPipe
+
+
+/**
+ * @brief Fails to take the next `m_numOfFailures` tasks.
+ *
+ */
+class FailingExecutor :
+	public Threading::Executor
+{
+public:
+	FailingExecutor(Threading::Executor& executor) :
+		m_executor(executor),
+		m_numOfFailures(0)
+	{}
+
+	virtual ~FailingExecutor() = default;
+
+	virtual void AddTask(std::unique_ptr<Threading::Task> task) override
+	{
+		if (m_numOfFailures > 0)
+		{
+			--m_numOfFailures;
+			throw std::runtime_error("AddTask failed");
+		}
+		m_executor.AddTask(std::move(task));
+	}
+
+	Threading::Executor& m_executor;
+	std::atomic<int> m_numOfFailures;
+}; // class FailingExecutor
+
+
+std::unique_ptr<Threading::Task> MakeCountingTask(std::atomic<size_t>& count)
+{
+	return Threading::MakeLambdaTask(
+		[&count](const std::atomic_bool&)
+		{
+			++count;
+		}
+	);
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_IoReactor, PipeReadable)
+{
+	Threading::ThreadPool pool(1);
+	Threading::IoReactor reactor(pool);
+	TestPipe testPipe;
+
+	char received = 0;
+	bool isFinished = false;
+	reactor.WhenReadable(
+		testPipe.m_readFd,
+		Threading::MakeLambdaTask(
+			[&testPipe, &received](const std::atomic_bool&)
+			{
+				EXPECT_EQ(read(testPipe.m_readFd, &received, 1), 1);
+			},
+			[&isFinished]()
+			{
+				isFinished = true;
+			}
+		)
+	);
+	EXPECT_EQ(reactor.GetNumOfWaiters(), 1);
+
+	// nothing to read yet
+	EXPECT_EQ(reactor.Poll(0), 0);
+
+	char sent = 'x';
+	EXPECT_EQ(write(testPipe.m_writeFd, &sent, 1), 1);
+	EXPECT_EQ(reactor.Poll(1000), 1);
+	EXPECT_EQ(reactor.GetNumOfWaiters(), 0);
+
+	while (!isFinished)
+	{
+		pool.Update();
+	}
+	EXPECT_EQ(received, 'x');
+
+	// a waiting task is posted only once
+	EXPECT_EQ(write(testPipe.m_writeFd, &sent, 1), 1);
+	EXPECT_EQ(reactor.Poll(0), 0);
+
+	reactor.Deregister(testPipe.m_readFd);
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_IoReactor, ReadAndWriteWaiters)
+{
+	Threading::ThreadPool pool(1);
+	Threading::IoReactor reactor(pool);
+	TestPipe testPipe;
+
+	std::atomic<int> numOfRuns(0);
+	auto waiterFunc =
+		[&numOfRuns](const std::atomic_bool&)
+		{
+			++numOfRuns;
+		};
+
+	// the write end of an empty pipe is writable right away
+	reactor.WhenWritable(testPipe.m_writeFd, Threading::MakeLambdaTask(waiterFunc));
+	// two tasks waiting on the same end are posted together
+	reactor.WhenReadable(testPipe.m_readFd, Threading::MakeLambdaTask(waiterFunc));
+	reactor.WhenReadable(testPipe.m_readFd, Threading::MakeLambdaTask(waiterFunc));
+	EXPECT_EQ(reactor.GetNumOfWaiters(), 3);
+
+	EXPECT_EQ(reactor.Poll(1000), 1);
+
+	// closing the write end wakes up the readers
+	reactor.Deregister(testPipe.m_writeFd);
+	close(testPipe.m_writeFd);
+	testPipe.m_writeFd = -1;
+	EXPECT_EQ(reactor.Poll(1000), 2);
+
+	while (numOfRuns < 3)
+	{
+		std::this_thread::yield();
+	}
+
+	reactor.Deregister(testPipe.m_readFd);
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_IoReactor, RegularFile)
+{
+	Threading::ThreadPool pool(1);
+	Threading::IoReactor reactor(pool);
+
+	char path[] = "/tmp/SimpleConcurrencyTestXXXXXX";
+	int fd = mkstemp(path);
+	ASSERT_GE(fd, 0);
+	unlink(path);
+
+	// regular files are always ready, so the task is posted right away
+	std::atomic_bool isRun(false);
+	reactor.WhenReadable(
+		fd,
+		Threading::MakeLambdaTask(
+			[&isRun](const std::atomic_bool&)
+			{
+				isRun = true;
+			}
+		)
+	);
+	EXPECT_EQ(reactor.GetNumOfWaiters(), 0);
+	while (!isRun)
+	{
+		std::this_thread::yield();
+	}
+
+	close(fd);
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_IoReactor, Deregister)
+{
+	Threading::ThreadPool pool(1);
+	Threading::IoReactor reactor(pool);
+	TestPipe testPipe;
+
+	reactor.WhenReadable(
+		testPipe.m_readFd,
+		Threading::MakeLambdaTask(
+			[](const std::atomic_bool&)
+			{
+				FAIL();
+			}
+		)
+	);
+	reactor.Deregister(testPipe.m_readFd);
+	EXPECT_EQ(reactor.GetNumOfWaiters(), 0);
+
+	char sent = 'x';
+	EXPECT_EQ(write(testPipe.m_writeFd, &sent, 1), 1);
+	EXPECT_EQ(reactor.Poll(0), 0);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_IoReactor, ManyWaitsFewThreads)
+{
+	const size_t numOfPipes = 200;
+
+	Threading::ThreadPool pool(2);
+	Threading::IoReactor reactor(pool);
+	reactor.Start();
+
+	std::vector<std::unique_ptr<TestPipe> > pipes;
+	std::atomic<size_t> numOfReceived(0);
+	for (size_t i = 0; i < numOfPipes; ++i)
+	{
+		pipes.emplace_back(new TestPipe());
+		int readFd = pipes.back()->m_readFd;
+		reactor.WhenReadable(
+			readFd,
+			Threading::MakeLambdaTask(
+				[readFd, &numOfReceived](const std::atomic_bool&)
+				{
+					char received = 0;
+					if (read(readFd, &received, 1) == 1)
+					{
+						++numOfReceived;
+					}
+				}
+			)
+		);
+	}
+	EXPECT_EQ(reactor.GetNumOfWaiters(), numOfPipes);
+
+	// all waits are outstanding, but no worker is occupied
+	EXPECT_EQ(pool.GetNumOfThreads(), 0);
+
+	char sent = 'x';
+	for (auto& testPipe : pipes)
+	{
+		EXPECT_EQ(write(testPipe->m_writeFd, &sent, 1), 1);
+	}
+	while (numOfReceived < numOfPipes)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_LE(pool.GetNumOfThreads(), 2);
+
+	reactor.Stop();
+	for (auto& testPipe : pipes)
+	{
+		reactor.Deregister(testPipe->m_readFd);
+	}
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_IoReactor, ExecutorFailure)
+{
+	Threading::ThreadPool pool(1);
+	FailingExecutor executor(pool);
+	Threading::IoReactor reactor(executor);
+	TestPipe pipe1;
+	TestPipe pipe2;
+	std::atomic<size_t> count(0);
+
+	// the data is never read, so the pipes stay readable
+	char sent = 'x';
+	EXPECT_EQ(write(pipe1.m_writeFd, &sent, 1), 1);
+	EXPECT_EQ(write(pipe2.m_writeFd, &sent, 1), 1);
+
+	// the other task is still posted, and then the error is rethrown
+	reactor.WhenReadable(pipe1.m_readFd, MakeCountingTask(count));
+	reactor.WhenReadable(pipe2.m_readFd, MakeCountingTask(count));
+	executor.m_numOfFailures = 1;
+	EXPECT_THROW(reactor.Poll(1000), std::runtime_error);
+	EXPECT_EQ(reactor.GetNumOfWaiters(), 0);
+	while (count < 1)
+	{
+		std::this_thread::yield();
+	}
+
+	// the thread keeps polling after a failure
+	reactor.Start();
+	executor.m_numOfFailures = 1;
+	reactor.WhenReadable(pipe1.m_readFd, MakeCountingTask(count));
+	while (executor.m_numOfFailures > 0)
+	{
+		std::this_thread::yield();
+	}
+	reactor.WhenReadable(pipe2.m_readFd, MakeCountingTask(count));
+	while (count < 2)
+	{
+		std::this_thread::yield();
+	}
+
+	reactor.Stop();
+	EXPECT_FALSE(reactor.GetThreadError());
+	EXPECT_EQ(count.load(), 2);
+
+	reactor.Deregister(pipe1.m_readFd);
+	reactor.Deregister(pipe2.m_readFd);
+	pool.Terminate();
+}
+
+
+#endif // __linux__
@@ -0,0 +1,270 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <algorithm>
+#include <numeric>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/ParallelAlgorithms.hpp>
+#include <SimpleConcurrency/Threading/TaskGroup.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+std::vector<uint64_t> GenRandomVals(size_t size, uint64_t seed)
+{
+	std::mt19937_64 rand(seed);
+	std::vector<uint64_t> vals(size);
+	for (auto& val : vals)
+	{
+		val = rand() % 1000000;
+	}
+	return vals;
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, Sort)
+{
+	Threading::ThreadPool pool(4);
+
+	// different numbers of runs to merge, including odd ones
+	for (size_t size : { 0, 1, 100, 5000, 12345, 100000 })
+	{
+		std::vector<uint64_t> vals = GenRandomVals(size, size);
+		std::vector<uint64_t> expVals = vals;
+		std::sort(expVals.begin(), expVals.end());
+
+		Threading::ParallelSort(pool, vals.begin(), vals.end());
+		ASSERT_EQ(vals, expVals);
+	}
+
+	// with a comparator, and a small threshold, so merges are split too
+	std::vector<uint64_t> vals = GenRandomVals(3000, 0);
+	std::vector<uint64_t> expVals = vals;
+	std::sort(expVals.begin(), expVals.end(), std::greater<uint64_t>());
+	Threading::ParallelSort(
+		pool, vals.begin(), vals.end(), std::greater<uint64_t>(), 64
+	);
+	EXPECT_EQ(vals, expVals);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, SortMoveOnly)
+{
+	Threading::ThreadPool pool(3);
+
+	std::vector<uint64_t> keys = GenRandomVals(2000, 1);
+	std::vector<std::unique_ptr<uint64_t> > vals;
+	for (uint64_t key : keys)
+	{
+		vals.emplace_back(new uint64_t(key));
+	}
+	std::sort(keys.begin(), keys.end());
+
+	Threading::ParallelSort(
+		pool,
+		vals.begin(),
+		vals.end(),
+		[](const std::unique_ptr<uint64_t>& a, const std::unique_ptr<uint64_t>& b)
+		{
+			return *a < *b;
+		},
+		100
+	);
+	ASSERT_EQ(vals.size(), keys.size());
+	for (size_t i = 0; i < keys.size(); ++i)
+	{
+		ASSERT_NE(vals[i], nullptr);
+		ASSERT_EQ(*vals[i], keys[i]);
+	}
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, Scan)
+{
+	Threading::ThreadPool pool(4);
+
+	for (size_t size : { 0, 1, 100, 4097, 50000 })
+	{
+		std::vector<uint64_t> vals = GenRandomVals(size, size);
+
+		std::vector<uint64_t> expInclusive(size);
+		std::partial_sum(vals.begin(), vals.end(), expInclusive.begin());
+		std::vector<uint64_t> expExclusive(size);
+		uint64_t sum = 10;
+		for (size_t i = 0; i < size; ++i)
+		{
+			expExclusive[i] = sum;
+			sum += vals[i];
+		}
+
+		std::vector<uint64_t> inclusive(size);
+		auto end = Threading::ParallelInclusiveScan(
+			pool, vals.begin(), vals.end(), inclusive.begin()
+		);
+		EXPECT_EQ(end, inclusive.end());
+		ASSERT_EQ(inclusive, expInclusive);
+
+		std::vector<uint64_t> exclusive(size);
+		Threading::ParallelExclusiveScan(
+			pool, vals.begin(), vals.end(), exclusive.begin(), uint64_t(10)
+		);
+		ASSERT_EQ(exclusive, expExclusive);
+
+		// in-place, with a small threshold
+		std::vector<uint64_t> inPlace = vals;
+		Threading::ParallelExclusiveScan(
+			pool, inPlace.begin(), inPlace.end(), inPlace.begin(),
+			uint64_t(10), std::plus<uint64_t>(), 16
+		);
+		ASSERT_EQ(inPlace, expExclusive);
+
+		inPlace = vals;
+		Threading::ParallelInclusiveScan(
+			pool, inPlace.begin(), inPlace.end(), inPlace.begin(),
+			std::plus<uint64_t>(), 16
+		);
+		ASSERT_EQ(inPlace, expInclusive);
+	}
+
+	// an associative, but not commutative operation
+	std::vector<std::string> strs;
+	for (int i = 0; i < 200; ++i)
+	{
+		strs.push_back(std::string(1, static_cast<char>('a' + (i % 26))));
+	}
+	std::vector<std::string> expStrs(strs.size());
+	std::partial_sum(strs.begin(), strs.end(), expStrs.begin());
+	std::vector<std::string> outStrs(strs.size());
+	Threading::ParallelInclusiveScan(
+		pool, strs.begin(), strs.end(), outStrs.begin(),
+		std::plus<std::string>(), 8
+	);
+	EXPECT_EQ(outStrs, expStrs);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, Transform)
+{
+	Threading::ThreadPool pool(4);
+
+	std::vector<uint64_t> vals = GenRandomVals(30000, 2);
+	std::vector<uint64_t> others = GenRandomVals(30000, 3);
+
+	std::vector<uint64_t> out(vals.size());
+	auto end = Threading::ParallelTransform(
+		pool, vals.begin(), vals.end(), out.begin(),
+		[](uint64_t val)
+		{
+			return val * 3;
+		}
+	);
+	EXPECT_EQ(end, out.end());
+	for (size_t i = 0; i < vals.size(); ++i)
+	{
+		ASSERT_EQ(out[i], vals[i] * 3);
+	}
+
+	Threading::ParallelTransform(
+		pool, vals.begin(), vals.end(), others.begin(), out.begin(),
+		[](uint64_t a, uint64_t b)
+		{
+			return a + b;
+		},
+		100
+	);
+	for (size_t i = 0; i < vals.size(); ++i)
+	{
+		ASSERT_EQ(out[i], vals[i] + others[i]);
+	}
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, OnWorker)
+{
+	// called from a task on the same pool, which helps instead of blocking
+	Threading::ThreadPool pool(1);
+
+	std::vector<uint64_t> vals = GenRandomVals(20000, 4);
+	std::vector<uint64_t> expVals = vals;
+	std::sort(expVals.begin(), expVals.end());
+
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&pool, &vals]()
+		{
+			Threading::ParallelSort(
+				pool, vals.begin(), vals.end(), std::less<uint64_t>(), 256
+			);
+		}
+	);
+	group.Wait();
+	EXPECT_EQ(vals, expVals);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ParallelAlgorithms, Exception)
+{
+	Threading::ThreadPool pool(2);
+
+	std::vector<int> vals(10000, 1);
+	std::vector<int> out(vals.size());
+	EXPECT_THROW(
+		Threading::ParallelTransform(
+			pool, vals.begin(), vals.end(), out.begin(),
+			[](int) -> int
+			{
+				throw std::runtime_error("Transform failed");
+			},
+			100
+		),
+		std::runtime_error
+	);
+
+	pool.Terminate();
+}
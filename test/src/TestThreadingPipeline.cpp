@@ -0,0 +1,366 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/Pipeline.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+// runs each task right away in the submitting thread
+class InlineExecutor :
+	public Threading::Executor
+{
+public:
+	virtual void AddTask(std::unique_ptr<Threading::Task> task) override
+	{
+		task->Run();
+	}
+}; // class InlineExecutor
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_Pipeline, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_Pipeline, InvalidConfig)
+{
+	Threading::ThreadPool pool(1);
+
+	EXPECT_THROW(
+		Threading::PipelineStageConfig::Parallel(
+			0, Threading::PipelineStageOrder::Unordered, 4
+		),
+		std::invalid_argument
+	);
+	EXPECT_THROW(
+		Threading::PipelineStageConfig::Serial(
+			Threading::PipelineStageOrder::Unordered, 0
+		),
+		std::invalid_argument
+	);
+	EXPECT_THROW(
+		Threading::MakePipelineBuilder<int>(pool, 0, 4),
+		std::invalid_argument
+	);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_Pipeline, OrderedStages)
+{
+	Threading::ThreadPool pool(4);
+
+	const int numOfItems = 1000;
+
+	std::atomic<int> numOfActive(0);
+	std::atomic<int> maxActive(0);
+	std::vector<int> results;
+
+	auto pipeline = Threading::MakePipelineBuilder<std::string>(pool, 64, 8)
+		// parse; parallel, and may reorder the items
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Parallel(
+				4, Threading::PipelineStageOrder::Unordered, 16
+			),
+			[](std::string str)
+			{
+				return std::stoi(str);
+			}
+		)
+		// transform; parallel, but passes the items on in order
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Parallel(
+				3, Threading::PipelineStageOrder::Ordered, 16
+			),
+			[&numOfActive, &maxActive](int val)
+			{
+				int active = ++numOfActive;
+				int prevMax = maxActive;
+				while (
+					active > prevMax &&
+					!maxActive.compare_exchange_weak(prevMax, active)
+				)
+				{}
+				std::this_thread::yield();
+				--numOfActive;
+				return val * 2;
+			}
+		)
+		// emit; serial and in order
+		.AddSink(
+			Threading::PipelineStageConfig::Serial(
+				Threading::PipelineStageOrder::Ordered, 16
+			),
+			[&results](int val)
+			{
+				results.push_back(val);
+			}
+		);
+
+	for (int i = 0; i < numOfItems; ++i)
+	{
+		pipeline->Push(std::to_string(i));
+		EXPECT_LE(pipeline->GetInFlightCount(), 64);
+	}
+	pipeline->Wait();
+	EXPECT_EQ(pipeline->GetInFlightCount(), 0);
+
+	ASSERT_EQ(results.size(), static_cast<size_t>(numOfItems));
+	for (int i = 0; i < numOfItems; ++i)
+	{
+		ASSERT_EQ(results[i], i * 2);
+	}
+	EXPECT_LE(maxActive, 3);
+
+	pipeline.reset();
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_Pipeline, SerialOrderedAfterUnordered)
+{
+	Threading::ThreadPool pool(3);
+
+	std::vector<int> results;
+
+	auto pipeline = Threading::MakePipelineBuilder<int>(pool, 32, 4)
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Parallel(
+				3, Threading::PipelineStageOrder::Unordered, 8
+			),
+			[](int val)
+			{
+				if (val % 3 == 0)
+				{
+					// delay some items, so that they are overtaken
+					std::this_thread::yield();
+				}
+				return val;
+			}
+		)
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Serial(
+				Threading::PipelineStageOrder::Ordered, 8
+			),
+			[](int val)
+			{
+				return val + 1;
+			}
+		)
+		.AddSink(
+			Threading::PipelineStageConfig::Serial(
+				Threading::PipelineStageOrder::Unordered, 8
+			),
+			[&results](int val)
+			{
+				results.push_back(val);
+			}
+		);
+
+	for (int i = 0; i < 500; ++i)
+	{
+		pipeline->Push(i);
+	}
+	pipeline->Wait();
+
+	ASSERT_EQ(results.size(), 500);
+	for (int i = 0; i < 500; ++i)
+	{
+		ASSERT_EQ(results[i], i + 1);
+	}
+
+	pipeline.reset();
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_Pipeline, InlineExecutor)
+{
+	InlineExecutor executor;
+
+	std::vector<int> results;
+
+	auto pipeline = Threading::MakePipelineBuilder<int>(executor, 4, 2)
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Parallel(
+				2, Threading::PipelineStageOrder::Ordered, 2
+			),
+			[](int val)
+			{
+				return val * 2;
+			}
+		)
+		.AddSink(
+			Threading::PipelineStageConfig::Serial(
+				Threading::PipelineStageOrder::Ordered, 2
+			),
+			[&results](int val)
+			{
+				results.push_back(val);
+			}
+		);
+
+	// the stages run in the pushing thread, which must not hold the lock
+	for (int i = 0; i < 100; i += 2)
+	{
+		pipeline->Push(i);
+		int val = i + 1;
+		EXPECT_TRUE(pipeline->TryPush(std::move(val)));
+	}
+	pipeline->Wait();
+
+	ASSERT_EQ(results.size(), 100);
+	for (int i = 0; i < 100; ++i)
+	{
+		ASSERT_EQ(results[i], i * 2);
+	}
+}
+
+
+GTEST_TEST(Test_Threading_Pipeline, Backpressure)
+{
+	Threading::ThreadPool pool(2);
+
+	std::atomic_bool isSinkOpen(false);
+	std::atomic<int> numOfEmitted(0);
+
+	auto pipeline = Threading::MakePipelineBuilder<int>(pool, 10, 2)
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Parallel(
+				2, Threading::PipelineStageOrder::Unordered, 2
+			),
+			[](int val)
+			{
+				return val;
+			}
+		)
+		// the slowest stage
+		.AddSink(
+			Threading::PipelineStageConfig::Serial(
+				Threading::PipelineStageOrder::Unordered, 2
+			),
+			[&isSinkOpen, &numOfEmitted](int)
+			{
+				while (!isSinkOpen)
+				{
+					std::this_thread::yield();
+				}
+				++numOfEmitted;
+			}
+		);
+
+	// keep pushing until the pipeline stops taking items
+	int numOfPushed = 0;
+	for (int i = 0; i < 1000 && numOfPushed < 100; ++i)
+	{
+		int val = i;
+		if (pipeline->TryPush(std::move(val)))
+		{
+			++numOfPushed;
+		}
+		else
+		{
+			std::this_thread::yield();
+		}
+	}
+	EXPECT_LE(numOfPushed, 10);
+	EXPECT_LE(pipeline->GetInFlightCount(), 10);
+	EXPECT_EQ(numOfEmitted, 0);
+
+	isSinkOpen = true;
+	pipeline->Wait();
+	EXPECT_EQ(numOfEmitted, numOfPushed);
+
+	// it takes items again once the sink catches up
+	int val = 0;
+	EXPECT_TRUE(pipeline->TryPush(std::move(val)));
+	pipeline->Wait();
+	EXPECT_EQ(numOfEmitted, numOfPushed + 1);
+
+	pipeline.reset();
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_Pipeline, StageException)
+{
+	Threading::ThreadPool pool(2);
+
+	std::atomic<int> numOfEmitted(0);
+
+	auto pipeline = Threading::MakePipelineBuilder<int>(pool, 16, 4)
+		.AddStage<int>(
+			Threading::PipelineStageConfig::Parallel(
+				2, Threading::PipelineStageOrder::Ordered, 8
+			),
+			[](int val)
+			{
+				if (val == 5)
+				{
+					throw std::runtime_error("Stage failed");
+				}
+				return val;
+			}
+		)
+		.AddSink(
+			Threading::PipelineStageConfig::Serial(
+				Threading::PipelineStageOrder::Ordered, 8
+			),
+			[&numOfEmitted](int)
+			{
+				++numOfEmitted;
+			}
+		);
+
+	auto pushAll = [&pipeline]()
+	{
+		for (int i = 0; i < 100; ++i)
+		{
+			pipeline->Push(i);
+		}
+	};
+
+	EXPECT_THROW({ pushAll(); pipeline->Wait(); }, std::runtime_error);
+	EXPECT_THROW(pipeline->Wait(), std::runtime_error);
+	EXPECT_THROW(pipeline->Push(0), std::runtime_error);
+	EXPECT_EQ(pipeline->GetInFlightCount(), 0);
+	// items after the failed one never reach the ordered sink
+	EXPECT_LE(numOfEmitted, 5);
+
+	pipeline.reset();
+	pool.Terminate();
+}
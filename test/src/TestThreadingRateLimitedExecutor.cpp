@@ -0,0 +1,180 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <chrono>
+#include <functional>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/RateLimitedExecutor.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+class InlineExecutor :
+	public Threading::Executor
+{
+public:
+	virtual void AddTask(std::unique_ptr<Threading::Task> task) override
+	{
+		task->Run();
+	}
+}; // class InlineExecutor
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_RateLimitedExecutor, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_RateLimitedExecutor, Burst)
+{
+	Threading::ThreadPool pool(2);
+
+	EXPECT_THROW(
+		Threading::RateLimitedExecutor(pool, 0.0, 1),
+		std::invalid_argument
+	);
+	EXPECT_THROW(
+		Threading::RateLimitedExecutor(pool, 1.0, 0),
+		std::invalid_argument
+	);
+
+	// the burst is released at once, and the rest wait for a long time
+	Threading::RateLimitedExecutor limiter(pool, 0.5, 3);
+	std::atomic<int> numOfRuns(0);
+	for (int i = 0; i < 5; ++i)
+	{
+		limiter.AddTask(Threading::MakeLambdaTask(
+			[&numOfRuns](const std::atomic_bool&)
+			{
+				++numOfRuns;
+			}
+		));
+	}
+	EXPECT_EQ(limiter.GetNumOfPendingTasks(), 2);
+	while (numOfRuns < 3)
+	{
+		std::this_thread::yield();
+	}
+
+	// the waiting tasks are dropped
+	limiter.Terminate();
+	EXPECT_EQ(limiter.GetNumOfPendingTasks(), 0);
+	limiter.AddTask(Threading::MakeLambdaTask([](const std::atomic_bool&) {}));
+	EXPECT_EQ(limiter.GetNumOfPendingTasks(), 0);
+	EXPECT_EQ(numOfRuns, 3);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_RateLimitedExecutor, Rate)
+{
+	Threading::ThreadPool pool(2);
+	Threading::RateLimitedExecutor limiter(pool, 200.0, 2);
+
+	std::atomic<int> numOfRuns(0);
+	auto beginTime = std::chrono::steady_clock::now();
+	for (int i = 0; i < 12; ++i)
+	{
+		limiter.AddTask(Threading::MakeLambdaTask(
+			[&numOfRuns](const std::atomic_bool&)
+			{
+				++numOfRuns;
+			}
+		));
+	}
+	while (numOfRuns < 12)
+	{
+		std::this_thread::yield();
+	}
+	auto duration = std::chrono::steady_clock::now() - beginTime;
+
+	// 10 tasks after the burst, at 5ms each
+	EXPECT_GE(duration, std::chrono::milliseconds(45));
+	EXPECT_EQ(limiter.GetNumOfPendingTasks(), 0);
+
+	limiter.Terminate();
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_RateLimitedExecutor, ReentrantAndTerminate)
+{
+	// the tasks are passed on without the lock, so a task run inline can
+	// add more; they are released after it, still in order
+	InlineExecutor executor;
+	Threading::RateLimitedExecutor limiter(executor, 1000.0, 10);
+
+	std::vector<int> runOrder;
+	std::function<void(int)> addTask;
+	addTask =
+		[&limiter, &runOrder, &addTask](int idx)
+		{
+			limiter.AddTask(Threading::MakeLambdaTask(
+				[&runOrder, &addTask, idx](const std::atomic_bool&)
+				{
+					runOrder.push_back(idx);
+					if (idx < 3)
+					{
+						addTask(idx * 2 + 1);
+						addTask(idx * 2 + 2);
+					}
+				}
+			));
+		};
+	addTask(0);
+	EXPECT_EQ(runOrder, std::vector<int>({ 0, 1, 2, 3, 4, 5, 6 }));
+	EXPECT_EQ(limiter.GetNumOfPendingTasks(), 0);
+
+	// terminated by many threads at once
+	for (int i = 0; i < 20; ++i)
+	{
+		limiter.AddTask(Threading::MakeLambdaTask([](const std::atomic_bool&) {}));
+	}
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 4; ++i)
+	{
+		threads.emplace_back(
+			[&limiter]()
+			{
+				limiter.Terminate();
+				EXPECT_EQ(limiter.GetNumOfPendingTasks(), 0);
+			}
+		);
+	}
+	for (std::thread& thread : threads)
+	{
+		thread.join();
+	}
+}
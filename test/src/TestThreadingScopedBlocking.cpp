@@ -0,0 +1,167 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/ScopedBlocking.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+GTEST_TEST(Test_Threading_ScopedBlocking, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_ScopedBlocking, OutsidePool)
+{
+	EXPECT_EQ(Threading::ThreadPool::GetCurrent(), nullptr);
+
+	// nothing to compensate
+	Threading::ScopedBlocking blocking;
+}
+
+
+GTEST_TEST(Test_Threading_ScopedBlocking, CompensatingWorker)
+{
+	Threading::ThreadPool pool(1);
+
+	std::atomic_bool isBlocked(false);
+	std::atomic_bool isUnblocked(false);
+	std::atomic<Threading::ThreadPool*> currentPool(nullptr);
+	std::atomic<size_t> numOfBlocking(0);
+	int numOfFinished = 0;
+
+	pool.AddTask(Threading::MakeLambdaTask(
+		[&](const std::atomic_bool&)
+		{
+			currentPool = Threading::ThreadPool::GetCurrent();
+
+			Threading::ScopedBlocking blocking;
+			{
+				// nested markers count once
+				Threading::ScopedBlocking nestedBlocking;
+				numOfBlocking = pool.GetNumOfBlockingWorkers();
+			}
+
+			isBlocked = true;
+			while (!isUnblocked)
+			{
+				std::this_thread::yield();
+			}
+		},
+		[&numOfFinished]()
+		{
+			++numOfFinished;
+		}
+	));
+	while (!isBlocked)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(currentPool, &pool);
+	EXPECT_EQ(numOfBlocking, 1);
+
+	// the only worker is blocked, but the pool still runs this one
+	bool isSecondFinished = false;
+	pool.AddTask(Threading::MakeLambdaTask(
+		[](const std::atomic_bool&) {},
+		[&isSecondFinished]()
+		{
+			isSecondFinished = true;
+		}
+	));
+	while (!isSecondFinished)
+	{
+		pool.Update();
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 2);
+
+	// the compensating worker is retired afterwards
+	isUnblocked = true;
+	while (numOfFinished < 1)
+	{
+		pool.Update();
+	}
+	while (pool.GetNumOfThreads() > 1)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(pool.GetNumOfBlockingWorkers(), 0);
+
+	// and the pool still works with its own size
+	for (int i = 0; i < 10; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[](const std::atomic_bool&) {},
+			[&numOfFinished]()
+			{
+				++numOfFinished;
+			}
+		));
+	}
+	while (numOfFinished < 11)
+	{
+		pool.Update();
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 1);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ScopedBlocking, AllWorkersBlocked)
+{
+	Threading::ThreadPool pool(2);
+
+	std::atomic<int> numOfBlocked(0);
+	std::atomic_bool isUnblocked(false);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[&numOfBlocked, &isUnblocked](const std::atomic_bool&)
+			{
+				Threading::ScopedBlocking blocking;
+				++numOfBlocked;
+				while (!isUnblocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		));
+	}
+
+	// each blocked task makes room for the next one
+	while (numOfBlocked < 4)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 4);
+	isUnblocked = true;
+
+	pool.Terminate();
+}
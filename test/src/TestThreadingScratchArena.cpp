@@ -0,0 +1,215 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <map>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/ScratchArena.hpp>
+#include <SimpleConcurrency/Threading/TaskGroup.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+GTEST_TEST(Test_Threading_ScratchArena, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_ScratchArena, AllocateAndReset)
+{
+	Threading::ScratchArena arena(256);
+	EXPECT_EQ(arena.GetCapacity(), 0);
+
+	char* a = static_cast<char*>(arena.Allocate(3, 1));
+	uint64_t* b = static_cast<uint64_t*>(arena.Allocate(sizeof(uint64_t), alignof(uint64_t)));
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(b) % alignof(uint64_t), 0);
+	EXPECT_GE(reinterpret_cast<char*>(b), a + 3);
+	EXPECT_EQ(arena.GetCapacity(), 256);
+
+	// doesn't fit in the first block
+	arena.Allocate(250, 1);
+	EXPECT_EQ(arena.GetCapacity(), 512);
+	// larger than a block
+	arena.Allocate(1000, 1);
+	EXPECT_EQ(arena.GetCapacity(), 1512);
+
+	// rewind to a marker
+	auto marker = arena.GetMarker();
+	size_t used = arena.GetNumOfBytesUsed();
+	arena.Allocate(100, 1);
+	EXPECT_GT(arena.GetNumOfBytesUsed(), used);
+	EXPECT_EQ(arena.GetCapacity(), 1768);
+	arena.RewindTo(marker);
+	EXPECT_EQ(arena.GetNumOfBytesUsed(), used);
+
+	// the blocks are reused after a reset
+	arena.Reset();
+	EXPECT_EQ(arena.GetNumOfBytesUsed(), 0);
+	EXPECT_EQ(arena.Allocate(3, 1), a);
+	EXPECT_EQ(arena.Allocate(sizeof(uint64_t), alignof(uint64_t)), b);
+	arena.Allocate(250, 1);
+	arena.Allocate(1000, 1);
+	EXPECT_EQ(arena.GetCapacity(), 1768);
+
+	// a large allocation takes a new block, before the small ones
+	arena.Reset();
+	arena.Allocate(2000, 1);
+	EXPECT_EQ(arena.GetCapacity(), 3768);
+
+	arena.Release();
+	EXPECT_EQ(arena.GetCapacity(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_ScratchArena, Allocator)
+{
+	Threading::ScratchArena arena(1024);
+
+	{
+		Threading::ArenaAllocator<int> alloc(arena);
+		std::vector<int, Threading::ArenaAllocator<int> > vals(alloc);
+		for (int i = 0; i < 1000; ++i)
+		{
+			vals.push_back(i);
+		}
+		for (int i = 0; i < 1000; ++i)
+		{
+			ASSERT_EQ(vals[i], i);
+		}
+
+		// node-based containers rebind the allocator
+		using MapAlloc = Threading::ArenaAllocator<std::pair<const int, int> >;
+		std::map<int, int, std::less<int>, MapAlloc> map((std::less<int>()), MapAlloc(alloc));
+		map[1] = 2;
+		map[3] = 4;
+		EXPECT_EQ(map[3], 4);
+
+		EXPECT_TRUE(alloc == MapAlloc(arena));
+		Threading::ScratchArena otherArena;
+		EXPECT_TRUE(alloc != Threading::ArenaAllocator<int>(otherArena));
+	}
+	EXPECT_GT(arena.GetNumOfBytesUsed(), 1000 * sizeof(int));
+	arena.Reset();
+
+	// over-aligned types, including ones starting a new block
+	struct alignas(256) OverAligned
+	{
+		char m_data[8];
+	};
+	Threading::ArenaAllocator<OverAligned> overAlignedAlloc(arena);
+	arena.Allocate(1, 1);
+	for (int i = 0; i < 10; ++i)
+	{
+		OverAligned* ptr = overAlignedAlloc.allocate(1);
+		EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignof(OverAligned), 0);
+	}
+	OverAligned* ptr = overAlignedAlloc.allocate(4);
+	EXPECT_EQ(reinterpret_cast<uintptr_t>(ptr) % alignof(OverAligned), 0);
+	arena.Reset();
+}
+
+
+GTEST_TEST(Test_Threading_ScratchArena, PerWorkerArena)
+{
+	EXPECT_EQ(Threading::ThreadPool::GetCurrentScratchArena(), nullptr);
+
+	Threading::ThreadPool pool(2);
+
+	std::atomic<int> numOfRuns(0);
+	std::atomic<int> numOfFresh(0);
+	for (int i = 0; i < 50; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[&numOfRuns, &numOfFresh](const std::atomic_bool&)
+			{
+				Threading::ScratchArena* arena =
+					Threading::ThreadPool::GetCurrentScratchArena();
+				ASSERT_NE(arena, nullptr);
+
+				// the previous task on this worker has left nothing behind
+				if (arena->GetNumOfBytesUsed() == 0)
+				{
+					++numOfFresh;
+				}
+
+				std::vector<int, Threading::ArenaAllocator<int> > vals(
+					(Threading::ArenaAllocator<int>(*arena))
+				);
+				vals.resize(100, 1);
+				EXPECT_GT(arena->GetNumOfBytesUsed(), 0);
+				++numOfRuns;
+			}
+		));
+	}
+	while (numOfRuns < 50)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfFresh, 50);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ScratchArena, HelpedTaskRewinds)
+{
+	Threading::ThreadPool pool(1);
+
+	bool isKept = false;
+	Threading::TaskGroup outerGroup(pool);
+	outerGroup.Spawn(
+		[&pool, &isKept]()
+		{
+			Threading::ScratchArena* arena =
+				Threading::ThreadPool::GetCurrentScratchArena();
+			int* val = static_cast<int*>(arena->Allocate(sizeof(int), alignof(int)));
+			*val = 42;
+			size_t used = arena->GetNumOfBytesUsed();
+
+			// the subtask is run by this worker while waiting
+			Threading::TaskGroup group(pool);
+			group.Spawn(
+				[]()
+				{
+					Threading::ThreadPool::GetCurrentScratchArena()->Allocate(
+						100000, 1
+					);
+				}
+			);
+			group.Wait();
+
+			// but the allocations of this task are kept
+			isKept =
+				(*val == 42) && (arena->GetNumOfBytesUsed() == used);
+		}
+	);
+	outerGroup.Wait();
+	EXPECT_TRUE(isKept);
+
+	pool.Terminate();
+}
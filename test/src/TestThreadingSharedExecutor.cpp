@@ -0,0 +1,400 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/ScopedBlocking.hpp>
+#include <SimpleConcurrency/Threading/SharedExecutor.hpp>
+#include <SimpleConcurrency/Threading/TaskGroup.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, InvalidConfig)
+{
+	Threading::SharedExecutor executor(1);
+
+	EXPECT_THROW(
+		Threading::LogicalThreadPool(executor, 0, 1),
+		std::invalid_argument
+	);
+	EXPECT_THROW(
+		Threading::LogicalThreadPool(executor, 1, 0),
+		std::invalid_argument
+	);
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, ConcurrencyCap)
+{
+	Threading::SharedExecutor executor(4);
+	Threading::LogicalThreadPool pool(executor, 2);
+	EXPECT_EQ(pool.GetMaxConcurrency(), 2);
+	EXPECT_EQ(pool.GetWeight(), 1);
+
+	std::atomic<int> numOfActive(0);
+	std::atomic<int> maxActive(0);
+	int numOfFinished = 0;
+
+	for (int i = 0; i < 50; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[&numOfActive, &maxActive](const std::atomic_bool&)
+			{
+				int active = ++numOfActive;
+				int prevMax = maxActive;
+				while (
+					active > prevMax &&
+					!maxActive.compare_exchange_weak(prevMax, active)
+				)
+				{}
+				std::this_thread::yield();
+				--numOfActive;
+			},
+			[&numOfFinished]()
+			{
+				++numOfFinished;
+			}
+		));
+	}
+
+	while (numOfFinished < 50)
+	{
+		pool.Update();
+	}
+	EXPECT_LE(maxActive, 2);
+	EXPECT_EQ(pool.GetNumOfPendingTasks(), 0);
+	EXPECT_EQ(pool.GetNumOfFinishedTasks(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, WeightedShare)
+{
+	// a single worker, so the order of the tasks is decided by the weights
+	Threading::SharedExecutor executor(1);
+	Threading::LogicalThreadPool gatePool(executor, 1);
+	Threading::LogicalThreadPool heavyPool(executor, 1, 3);
+	Threading::LogicalThreadPool lightPool(executor, 1, 1);
+
+	std::atomic_bool isGateOpen(false);
+	std::atomic_bool isGateRunning(false);
+	gatePool.AddTask(Threading::MakeLambdaTask(
+		[&isGateOpen, &isGateRunning](const std::atomic_bool&)
+		{
+			isGateRunning = true;
+			while (!isGateOpen)
+			{
+				std::this_thread::yield();
+			}
+		}
+	));
+	while (!isGateRunning)
+	{
+		std::this_thread::yield();
+	}
+
+	std::vector<int> order;
+	for (int i = 0; i < 40; ++i)
+	{
+		heavyPool.AddTask(Threading::MakeLambdaTask(
+			[&order](const std::atomic_bool&)
+			{
+				order.push_back(3);
+			}
+		));
+		lightPool.AddTask(Threading::MakeLambdaTask(
+			[&order](const std::atomic_bool&)
+			{
+				order.push_back(1);
+			}
+		));
+	}
+	EXPECT_EQ(heavyPool.GetNumOfPendingTasks(), 40);
+	isGateOpen = true;
+
+	while (heavyPool.GetNumOfFinishedTasks() + lightPool.GetNumOfFinishedTasks() < 80)
+	{
+		std::this_thread::yield();
+	}
+
+	// while both are busy, the heavy pool gets three times the turns
+	int numOfHeavy = 0;
+	for (size_t i = 0; i < 40; ++i)
+	{
+		numOfHeavy += (order[i] == 3 ? 1 : 0);
+	}
+	EXPECT_GE(numOfHeavy, 29);
+	EXPECT_LE(numOfHeavy, 31);
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, SharedThreads)
+{
+	Threading::SharedExecutor executor(2);
+	EXPECT_EQ(executor.GetNumOfThreads(), 2);
+
+	std::vector<std::unique_ptr<Threading::LogicalThreadPool> > pools;
+	for (size_t i = 0; i < 4; ++i)
+	{
+		pools.emplace_back(new Threading::LogicalThreadPool(executor, 2));
+	}
+
+	std::mutex threadIdsMutex;
+	std::set<std::thread::id> threadIds;
+	for (int i = 0; i < 100; ++i)
+	{
+		pools[i % pools.size()]->AddTask(Threading::MakeLambdaTask(
+			[&threadIdsMutex, &threadIds](const std::atomic_bool&)
+			{
+				std::lock_guard<std::mutex> lock(threadIdsMutex);
+				threadIds.insert(std::this_thread::get_id());
+			}
+		));
+	}
+
+	for (auto& pool : pools)
+	{
+		while (pool->GetNumOfFinishedTasks() < 25)
+		{
+			std::this_thread::yield();
+		}
+		pool->Update();
+	}
+
+	// 4 pools of size 2, but only 2 threads
+	EXPECT_LE(threadIds.size(), 2);
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, Terminate)
+{
+	Threading::SharedExecutor executor(2);
+	Threading::LogicalThreadPool stuckPool(executor, 1);
+	Threading::LogicalThreadPool pool(executor, 1);
+
+	std::atomic_bool isRunning(false);
+	stuckPool.AddTask(Threading::MakeLambdaTask(
+		[&isRunning](const std::atomic_bool& isTerminated)
+		{
+			isRunning = true;
+			while (!isTerminated)
+			{
+				std::this_thread::yield();
+			}
+		}
+	));
+	// this one is never run
+	stuckPool.AddTask(Threading::MakeLambdaTask(
+		[](const std::atomic_bool&)
+		{
+			FAIL();
+		}
+	));
+	while (!isRunning)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(stuckPool.GetNumOfRunningTasks(), 1);
+	EXPECT_EQ(stuckPool.GetNumOfPendingTasks(), 1);
+
+	stuckPool.Terminate();
+	EXPECT_EQ(stuckPool.GetNumOfRunningTasks(), 0);
+	EXPECT_EQ(stuckPool.GetNumOfPendingTasks(), 0);
+
+	// the shared workers still serve the other pools
+	bool isFinished = false;
+	pool.AddTask(Threading::MakeLambdaTask(
+		[](const std::atomic_bool&) {},
+		[&isFinished]()
+		{
+			isFinished = true;
+		}
+	));
+	while (!isFinished)
+	{
+		pool.Update();
+	}
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, GlobalExecutor)
+{
+	// the same interface as `ThreadPool`
+	Threading::LogicalThreadPool pool(2);
+
+	int numOfFinished = 0;
+	for (int i = 0; i < 10; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[](const std::atomic_bool&) {},
+			[&numOfFinished]()
+			{
+				++numOfFinished;
+			}
+		));
+	}
+	while (numOfFinished < 10)
+	{
+		pool.Update();
+	}
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, TaskGroup)
+{
+	Threading::SharedExecutor executor(1);
+	Threading::LogicalThreadPool pool(executor, 1);
+
+	// nested groups on a single worker only finish if the waiting task
+	// helps with the subtasks
+	std::atomic<int> count(0);
+	std::atomic<int> numOfOtherPools(0);
+	Threading::TaskGroup group(pool);
+	for (int i = 0; i < 4; ++i)
+	{
+		group.Spawn(
+			[&pool, &count, &numOfOtherPools]()
+			{
+				if (Threading::ThreadPoolBase::GetCurrent() != &pool)
+				{
+					++numOfOtherPools;
+				}
+
+				Threading::TaskGroup subGroup(pool);
+				for (int j = 0; j < 10; ++j)
+				{
+					subGroup.Spawn(
+						[&count]()
+						{
+							++count;
+						}
+					);
+				}
+				subGroup.Wait();
+			}
+		);
+	}
+	group.Wait();
+
+	EXPECT_EQ(count.load(), 40);
+	EXPECT_EQ(numOfOtherPools.load(), 0);
+	EXPECT_EQ(Threading::ThreadPoolBase::GetCurrent(), nullptr);
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, BlockingAndRunningTasks)
+{
+	Threading::SharedExecutor executor(1);
+	Threading::LogicalThreadPool pool(executor, 1);
+	EXPECT_EQ(pool.GetPoolSize(), 1);
+	EXPECT_TRUE(pool.GetRunningTasks().empty());
+
+	// the only worker blocks until the next task runs, which needs
+	// a compensating worker
+	std::atomic_bool isBlocking(false);
+	std::atomic_bool isReleased(false);
+	std::unique_ptr<Threading::Task> blockingTask = Threading::MakeLambdaTask(
+		[&isBlocking, &isReleased](const std::atomic_bool&)
+		{
+			Threading::ScopedBlocking blocking;
+			isBlocking = true;
+			while (!isReleased)
+			{
+				std::this_thread::yield();
+			}
+		}
+	);
+	blockingTask->SetTag("blocking");
+	pool.AddTask(std::move(blockingTask));
+	while (!isBlocking)
+	{
+		std::this_thread::yield();
+	}
+
+	std::vector<Threading::RunningTaskInfo> infos = pool.GetRunningTasks();
+	ASSERT_EQ(infos.size(), 1);
+	EXPECT_STREQ(infos[0].m_tag, "blocking");
+	EXPECT_NE(infos[0].m_threadId, std::this_thread::get_id());
+
+	pool.AddTask(Threading::MakeLambdaTask(
+		[&isReleased](const std::atomic_bool&)
+		{
+			isReleased = true;
+		}
+	));
+	while (pool.GetNumOfRunningTasks() > 0 || pool.GetNumOfPendingTasks() > 0)
+	{
+		std::this_thread::yield();
+	}
+
+	EXPECT_THROW(pool.SetPoolSize(0), std::invalid_argument);
+
+	EXPECT_FALSE(pool.IsTerminated());
+	pool.Terminate();
+	EXPECT_TRUE(pool.IsTerminated());
+	EXPECT_FALSE(pool.RunPendingTask());
+}
+
+
+GTEST_TEST(Test_Threading_SharedExecutor, SetPoolSize)
+{
+	Threading::SharedExecutor executor(2);
+	Threading::LogicalThreadPool pool(executor, 1);
+
+	// the tasks only finish if they run at once
+	pool.SetPoolSize(2);
+	EXPECT_EQ(pool.GetPoolSize(), 2);
+	EXPECT_EQ(pool.GetMaxConcurrency(), 2);
+
+	std::atomic<int> numOfArrived(0);
+	for (int i = 0; i < 2; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask(
+			[&numOfArrived](const std::atomic_bool&)
+			{
+				++numOfArrived;
+				while (numOfArrived < 2)
+				{
+					std::this_thread::yield();
+				}
+			}
+		));
+	}
+	while (pool.GetNumOfRunningTasks() > 0 || pool.GetNumOfPendingTasks() > 0)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfArrived.load(), 2);
+}
@@ -0,0 +1,268 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/SharedMemoryTaskQueue.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+#ifdef __linux__
+#include <sys/wait.h>
+#include <unistd.h>
+#endif // __linux__
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+GTEST_TEST(Test_Threading_SharedMemoryTaskQueue, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+#ifdef __linux__
+
+
+namespace
+{
+
+// unique per test and per test process
+std::string GetQueueName(const std::string& testName)
+{
+	return "/SimpleConcurrency_test_" + testName + "_" +
+		std::to_string(getpid());
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_SharedMemoryTaskQueue, PushPop)
+{
+	const std::string name = GetQueueName("PushPop");
+	Threading::SharedMemoryTaskQueue::Remove(name);
+
+	EXPECT_THROW(
+		Threading::SharedMemoryTaskQueue(name, 3, 16),
+		std::invalid_argument
+	);
+
+	Threading::SharedMemoryTaskQueue queue(name, 4, 16);
+	EXPECT_EQ(queue.GetCapacity(), 4);
+	EXPECT_EQ(queue.GetMaxPayloadSize(), 16);
+	EXPECT_THROW(
+		queue.TryPush(1, std::string(17, 'x')),
+		std::invalid_argument
+	);
+
+	for (int i = 0; i < 4; ++i)
+	{
+		EXPECT_TRUE(queue.TryPush(i, std::string(i, 'a' + i)));
+	}
+	EXPECT_FALSE(queue.TryPush(4, "full"));
+	EXPECT_EQ(queue.Size(), 4);
+
+	// another attachment sees the same queue
+	{
+		EXPECT_THROW(
+			Threading::SharedMemoryTaskQueue(name, 8, 16),
+			std::invalid_argument
+		);
+		Threading::SharedMemoryTaskQueue queue2(name, 4, 16);
+		EXPECT_EQ(queue2.Size(), 4);
+
+		uint32_t handlerId = 0;
+		std::string payload;
+		EXPECT_TRUE(queue2.TryPop(handlerId, payload));
+		EXPECT_EQ(handlerId, 0);
+		EXPECT_EQ(payload, "");
+	}
+
+	uint32_t handlerId = 0;
+	std::string payload;
+	for (uint32_t i = 1; i < 4; ++i)
+	{
+		EXPECT_TRUE(queue.TryPop(handlerId, payload));
+		EXPECT_EQ(handlerId, i);
+		EXPECT_EQ(payload, std::string(i, 'a' + i));
+	}
+	EXPECT_FALSE(queue.TryPop(handlerId, payload));
+	EXPECT_EQ(queue.Size(), 0);
+
+	Threading::SharedMemoryTaskQueue::Remove(name);
+}
+
+
+GTEST_TEST(Test_Threading_SharedMemoryTaskQueue, Dispatcher)
+{
+	const std::string name = GetQueueName("Dispatcher");
+	Threading::SharedMemoryTaskQueue::Remove(name);
+	Threading::SharedMemoryTaskQueue queue(name, 64, 8);
+
+	Threading::ThreadPool pool(2);
+	Threading::SharedMemoryTaskDispatcher dispatcher(queue, pool, 2);
+	std::atomic<int> sum(0);
+	dispatcher.RegisterHandler(
+		1,
+		[&sum](const std::string& payload)
+		{
+			sum += std::stoi(payload);
+		}
+	);
+	dispatcher.Start();
+
+	// including a descriptor without a handler
+	EXPECT_TRUE(queue.TryPush(2, "1000"));
+	for (int i = 1; i <= 10; ++i)
+	{
+		EXPECT_TRUE(queue.TryPush(1, std::to_string(i)));
+	}
+	while (sum < 55 || dispatcher.GetNumOfInFlightTasks() > 0)
+	{
+		std::this_thread::yield();
+	}
+	dispatcher.Stop();
+
+	EXPECT_EQ(sum, 55);
+	EXPECT_EQ(dispatcher.GetNumOfDispatchedTasks(), 10);
+	EXPECT_EQ(dispatcher.GetNumOfDroppedTasks(), 1);
+	EXPECT_EQ(queue.Size(), 0);
+
+	pool.Terminate();
+	Threading::SharedMemoryTaskQueue::Remove(name);
+}
+
+
+GTEST_TEST(Test_Threading_SharedMemoryTaskQueue, LoadBalancing)
+{
+	const std::string name = GetQueueName("LoadBalancing");
+	Threading::SharedMemoryTaskQueue::Remove(name);
+
+	// two attachments with a pool each, as two processes would have
+	Threading::SharedMemoryTaskQueue queue1(name, 16, 8);
+	Threading::SharedMemoryTaskQueue queue2(name, 16, 8);
+	Threading::ThreadPool pool1(2);
+	Threading::ThreadPool pool2(2);
+	Threading::SharedMemoryTaskDispatcher dispatcher1(queue1, pool1, 1);
+	Threading::SharedMemoryTaskDispatcher dispatcher2(queue2, pool2, 1);
+
+	// each task waits for the other, so neither dispatcher can run both,
+	// since it keeps only one in flight
+	std::atomic<int> numOfStarted(0);
+	auto handler =
+		[&numOfStarted](const std::string&)
+		{
+			++numOfStarted;
+			while (numOfStarted < 2)
+			{
+				std::this_thread::yield();
+			}
+		};
+	dispatcher1.RegisterHandler(1, handler);
+	dispatcher2.RegisterHandler(1, handler);
+	dispatcher1.Start();
+	dispatcher2.Start();
+
+	EXPECT_TRUE(queue1.TryPush(1, ""));
+	EXPECT_TRUE(queue1.TryPush(1, ""));
+	while (
+		dispatcher1.GetNumOfDispatchedTasks() +
+			dispatcher2.GetNumOfDispatchedTasks() < 2 ||
+		dispatcher1.GetNumOfInFlightTasks() > 0 ||
+		dispatcher2.GetNumOfInFlightTasks() > 0
+	)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(dispatcher1.GetNumOfDispatchedTasks(), 1);
+	EXPECT_EQ(dispatcher2.GetNumOfDispatchedTasks(), 1);
+
+	dispatcher1.Stop();
+	dispatcher2.Stop();
+	pool1.Terminate();
+	pool2.Terminate();
+	Threading::SharedMemoryTaskQueue::Remove(name);
+}
+
+
+GTEST_TEST(Test_Threading_SharedMemoryTaskQueue, CrossProcess)
+{
+	static constexpr int sk_numOfTasks = 100;
+
+	const std::string name = GetQueueName("CrossProcess");
+	Threading::SharedMemoryTaskQueue::Remove(name);
+	Threading::SharedMemoryTaskQueue queue(name, 16, 8);
+
+	// fork before this process starts any thread, as only the forking
+	// thread is copied into the child, with whatever locks the others
+	// held; more tasks than the capacity, so the child waits for this
+	// process
+	pid_t pid = fork();
+	ASSERT_GE(pid, 0);
+	if (pid == 0)
+	{
+		Threading::SharedMemoryTaskQueue childQueue(name, 16, 8);
+		for (int i = 1; i <= sk_numOfTasks; ++i)
+		{
+			while (!childQueue.TryPush(1, std::to_string(i)))
+			{
+				std::this_thread::yield();
+			}
+		}
+		_exit(0);
+	}
+
+	Threading::ThreadPool pool(2);
+	Threading::SharedMemoryTaskDispatcher dispatcher(queue, pool, 2);
+	std::atomic<int> sum(0);
+	dispatcher.RegisterHandler(
+		1,
+		[&sum](const std::string& payload)
+		{
+			sum += std::stoi(payload);
+		}
+	);
+	dispatcher.Start();
+
+	int status = -1;
+	EXPECT_EQ(waitpid(pid, &status, 0), pid);
+	EXPECT_TRUE(WIFEXITED(status));
+	EXPECT_EQ(WEXITSTATUS(status), 0);
+
+	while (sum < sk_numOfTasks * (sk_numOfTasks + 1) / 2)
+	{
+		std::this_thread::yield();
+	}
+	dispatcher.Stop();
+	EXPECT_EQ(dispatcher.GetNumOfDispatchedTasks(), uint64_t(sk_numOfTasks));
+
+	pool.Terminate();
+	Threading::SharedMemoryTaskQueue::Remove(name);
+}
+
+
+#endif // __linux__
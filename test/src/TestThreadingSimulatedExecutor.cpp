@@ -0,0 +1,239 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/SimulatedExecutor.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+Threading::SimTaskRecord MakeRecord(
+	uint64_t id,
+	uint64_t arrivalTime,
+	uint64_t cost,
+	int priority = 0,
+	const std::vector<uint64_t>& dependencies = std::vector<uint64_t>()
+)
+{
+	Threading::SimTaskRecord record;
+	record.m_id = id;
+	record.m_arrivalTime = arrivalTime;
+	record.m_cost = cost;
+	record.m_priority = priority;
+	record.m_dependencies = dependencies;
+	return record;
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_SimulatedExecutor, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_SimulatedExecutor, Fifo)
+{
+	std::vector<Threading::SimTaskRecord> trace;
+	for (uint64_t i = 0; i < 4; ++i)
+	{
+		trace.push_back(MakeRecord(i, 0, 10));
+	}
+
+	auto report = Threading::SimulatedExecutor::Replay(
+		trace, 2, Threading::SimSchedulingPolicy::Fifo
+	);
+	EXPECT_EQ(report.m_numOfTasks, 4);
+	EXPECT_EQ(report.m_makespan, 20);
+	EXPECT_DOUBLE_EQ(report.m_utilization, 1.0);
+	EXPECT_DOUBLE_EQ(report.m_meanLatency, 15.0);
+	EXPECT_EQ(report.m_p50Latency, 10);
+	EXPECT_EQ(report.m_p99Latency, 20);
+	EXPECT_EQ(report.m_maxLatency, 20);
+
+	EXPECT_THROW(
+		Threading::SimulatedExecutor(0),
+		std::invalid_argument
+	);
+}
+
+
+GTEST_TEST(Test_Threading_SimulatedExecutor, Dependencies)
+{
+	// a diamond, listed before its dependencies are
+	std::vector<Threading::SimTaskRecord> trace = {
+		MakeRecord(3, 0, 5, 0, { 1, 2 }),
+		MakeRecord(1, 0, 5, 0, { 0 }),
+		MakeRecord(2, 0, 10, 0, { 0 }),
+		MakeRecord(0, 0, 5),
+	};
+
+	auto report = Threading::SimulatedExecutor::Replay(
+		trace, 2, Threading::SimSchedulingPolicy::Fifo
+	);
+	EXPECT_EQ(report.m_makespan, 20);
+	EXPECT_DOUBLE_EQ(report.m_utilization, 25.0 / 40.0);
+
+	// unknown and cyclic dependencies
+	trace.push_back(MakeRecord(4, 0, 1, 0, { 100 }));
+	EXPECT_THROW(
+		Threading::SimulatedExecutor::Replay(
+			trace, 2, Threading::SimSchedulingPolicy::Fifo
+		),
+		std::invalid_argument
+	);
+
+	// the failed run is dropped, so the executor can run again
+	Threading::SimulatedExecutor executor(2);
+	executor.AddRecord(MakeRecord(0, 0, 5));
+	executor.AddRecord(MakeRecord(1, 0, 5, 0, { 100 }));
+	EXPECT_THROW(executor.Run(), std::invalid_argument);
+	executor.AddRecord(MakeRecord(0, 0, 5));
+	report = executor.Run();
+	EXPECT_EQ(report.m_numOfTasks, 1);
+	EXPECT_EQ(report.m_makespan, 5);
+	trace.back() = MakeRecord(4, 0, 1, 0, { 5 });
+	trace.push_back(MakeRecord(5, 0, 1, 0, { 4 }));
+	EXPECT_THROW(
+		Threading::SimulatedExecutor::Replay(
+			trace, 2, Threading::SimSchedulingPolicy::Fifo
+		),
+		std::runtime_error
+	);
+}
+
+
+GTEST_TEST(Test_Threading_SimulatedExecutor, Priority)
+{
+	// a short urgent task arrives behind a long one
+	std::vector<Threading::SimTaskRecord> trace = {
+		MakeRecord(0, 0, 10),
+		MakeRecord(1, 1, 10),
+		MakeRecord(2, 2, 1, 5),
+	};
+
+	auto fifoReport = Threading::SimulatedExecutor::Replay(
+		trace, 1, Threading::SimSchedulingPolicy::Fifo
+	);
+	EXPECT_DOUBLE_EQ(fifoReport.m_meanLatency, (10.0 + 19.0 + 19.0) / 3);
+	EXPECT_EQ(fifoReport.m_makespan, 21);
+
+	auto priorityReport = Threading::SimulatedExecutor::Replay(
+		trace, 1, Threading::SimSchedulingPolicy::Priority
+	);
+	EXPECT_DOUBLE_EQ(priorityReport.m_meanLatency, (10.0 + 20.0 + 9.0) / 3);
+	EXPECT_EQ(priorityReport.m_makespan, 21);
+}
+
+
+GTEST_TEST(Test_Threading_SimulatedExecutor, WorkStealing)
+{
+	// a fork-join tree, with leaves of different costs
+	std::vector<Threading::SimTaskRecord> trace;
+	trace.push_back(MakeRecord(0, 0, 1));
+	std::vector<uint64_t> leaves;
+	for (uint64_t i = 1; i <= 16; ++i)
+	{
+		trace.push_back(MakeRecord(i, 0, i % 4 + 1, 0, { 0 }));
+		leaves.push_back(i);
+	}
+	trace.push_back(MakeRecord(17, 0, 1, 0, leaves));
+
+	auto report = Threading::SimulatedExecutor::Replay(
+		trace, 4, Threading::SimSchedulingPolicy::WorkStealing
+	);
+	EXPECT_EQ(report.m_numOfTasks, 18);
+	// 40 units of leaves over 4 workers take at least 10 between the fork
+	// and the join; the owner pops the newest leaves, and the thieves
+	// steal the oldest ones, which leaves a 4-unit leaf to start at 9
+	EXPECT_EQ(report.m_makespan, 14);
+
+	// the same trace gives the same results
+	auto report2 = Threading::SimulatedExecutor::Replay(
+		trace, 4, Threading::SimSchedulingPolicy::WorkStealing
+	);
+	EXPECT_EQ(report2.m_makespan, report.m_makespan);
+	EXPECT_DOUBLE_EQ(report2.m_meanLatency, report.m_meanLatency);
+	EXPECT_EQ(report2.m_p99Latency, report.m_p99Latency);
+}
+
+
+GTEST_TEST(Test_Threading_SimulatedExecutor, RealTasks)
+{
+	Threading::SimulatedExecutor executor(2);
+
+	// each task adds two more, down to a depth of 3
+	std::vector<uint64_t> runTimes;
+	std::vector<uint64_t> finishTimes;
+	std::function<void(int)> addTask;
+	addTask =
+		[&executor, &runTimes, &finishTimes, &addTask](int depth)
+		{
+			executor.AddTask(
+				Threading::MakeLambdaTask(
+					[&executor, &runTimes, &addTask, depth]
+					(const std::atomic_bool&)
+					{
+						runTimes.push_back(executor.GetTime());
+						if (depth < 3)
+						{
+							addTask(depth + 1);
+							addTask(depth + 1);
+						}
+					},
+					[&executor, &finishTimes]()
+					{
+						finishTimes.push_back(executor.GetTime());
+					}
+				),
+				10
+			);
+		};
+	addTask(1);
+
+	auto report = executor.Run();
+	EXPECT_EQ(report.m_numOfTasks, 7);
+	EXPECT_EQ(runTimes, std::vector<uint64_t>({ 0, 0, 10, 10, 20, 20, 30 }));
+	EXPECT_EQ(finishTimes, std::vector<uint64_t>({ 10, 10, 20, 20, 30, 30, 40 }));
+	EXPECT_EQ(report.m_makespan, 40);
+	EXPECT_EQ(executor.GetTime(), 40);
+
+	// the default cost, from the current virtual time
+	executor.AddTask(Threading::MakeLambdaTask([](const std::atomic_bool&) {}));
+	report = executor.Run();
+	EXPECT_EQ(report.m_numOfTasks, 1);
+	EXPECT_EQ(
+		report.m_makespan, uint64_t(Threading::SimulatedExecutor::sk_defaultCost)
+	);
+	EXPECT_EQ(executor.GetTime(), 41);
+}
@@ -0,0 +1,220 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/SpinFutexSync.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+/**
+ * @brief A stand-in for an enclave backend, which counts the calls that
+ *        would be OCALLs.
+ *
+ */
+struct CountingBackend
+{
+	static std::atomic<uint64_t> sm_numOfWaits;
+	static std::atomic<uint64_t> sm_numOfWakes;
+
+
+	static void Wait(std::atomic<uint32_t>& word, uint32_t expected)
+	{
+		++sm_numOfWaits;
+#ifdef __linux__
+		Threading::FutexSyncBackend::Wait(word, expected);
+#else
+		// a spurious return is allowed
+		(void)word;
+		(void)expected;
+		std::this_thread::yield();
+#endif // __linux__
+	}
+
+
+	static void Wake(std::atomic<uint32_t>& word, int num)
+	{
+		++sm_numOfWakes;
+#ifdef __linux__
+		Threading::FutexSyncBackend::Wake(word, num);
+#else
+		(void)word;
+		(void)num;
+#endif // __linux__
+	}
+
+
+	static void Reset()
+	{
+		sm_numOfWaits = 0;
+		sm_numOfWakes = 0;
+	}
+}; // struct CountingBackend
+
+std::atomic<uint64_t> CountingBackend::sm_numOfWaits(0);
+std::atomic<uint64_t> CountingBackend::sm_numOfWakes(0);
+
+
+using CountingMutex = Threading::BasicSpinFutexMutex<CountingBackend>;
+using CountingCV = Threading::BasicSpinFutexConditionVariable<CountingBackend>;
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_SpinFutexSync, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_SpinFutexSync, UncontendedNoCalls)
+{
+	CountingBackend::Reset();
+
+	CountingMutex mutex;
+	CountingCV cv;
+	for (size_t i = 0; i < 1000; ++i)
+	{
+		std::unique_lock<CountingMutex> lock(mutex);
+		cv.notify_one();
+		cv.notify_all();
+	}
+	EXPECT_TRUE(mutex.try_lock());
+	EXPECT_FALSE(mutex.try_lock());
+	mutex.unlock();
+
+	// nobody waits, so nothing needs to sleep or to be woken
+	EXPECT_EQ(CountingBackend::sm_numOfWaits.load(), 0);
+	EXPECT_EQ(CountingBackend::sm_numOfWakes.load(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_SpinFutexSync, ContendedMutex)
+{
+	static constexpr size_t sk_numOfThreads = 8;
+	static constexpr size_t sk_numOfIncrements = 20000;
+
+	CountingMutex mutex;
+	size_t counter = 0;
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < sk_numOfThreads; ++i)
+	{
+		threads.emplace_back(
+			[&mutex, &counter]()
+			{
+				for (size_t j = 0; j < sk_numOfIncrements; ++j)
+				{
+					std::lock_guard<CountingMutex> lock(mutex);
+					++counter;
+				}
+			}
+		);
+	}
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(counter, sk_numOfThreads * sk_numOfIncrements);
+}
+
+
+#ifdef __linux__
+
+
+GTEST_TEST(Test_Threading_SpinFutexSync, NotifyAllWakesInOneCall)
+{
+	static constexpr size_t sk_numOfWaiters = 4;
+
+	CountingBackend::Reset();
+
+	// so that only the condition variable calls the backend
+	std::mutex mutex;
+	CountingCV cv;
+	bool isReady = false;
+	size_t numOfWaiting = 0;
+	std::atomic<size_t> numOfDone(0);
+
+	std::vector<std::thread> threads;
+	for (size_t i = 0; i < sk_numOfWaiters; ++i)
+	{
+		threads.emplace_back(
+			[&]()
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				++numOfWaiting;
+				cv.wait(
+					lock,
+					[&isReady]()
+					{
+						return isReady;
+					}
+				);
+				++numOfDone;
+			}
+		);
+	}
+
+	// wait until all waiters are done spinning, and asleep
+	while (true)
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (numOfWaiting == sk_numOfWaiters &&
+				CountingBackend::sm_numOfWaits.load() >= sk_numOfWaiters)
+			{
+				break;
+			}
+		}
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+
+	uint64_t numOfWakesBefore = CountingBackend::sm_numOfWakes.load();
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		isReady = true;
+	}
+	cv.notify_all();
+	uint64_t numOfWakesAfter = CountingBackend::sm_numOfWakes.load();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	EXPECT_EQ(numOfDone.load(), sk_numOfWaiters);
+	// one call for all sleepers
+	EXPECT_EQ(numOfWakesAfter - numOfWakesBefore, 1);
+}
+
+
+#endif // __linux__
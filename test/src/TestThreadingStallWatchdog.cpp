@@ -0,0 +1,234 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/LambdaTask.hpp>
+#include <SimpleConcurrency/Threading/StallWatchdog.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+// a pool tracking its running tasks, for the watchdog
+using WatchedThreadPool = Threading::BasicThreadPool<
+	Threading::LockedQueuePolicy,
+	Threading::BlockingWaitPolicy,
+	Threading::DefaultCompletionPolicy,
+	Threading::CountingStatsPolicy
+>;
+
+
+std::unique_ptr<Threading::Task> MakeBlockedTask(
+	const char* tag,
+	std::atomic_bool& isBlocked,
+	std::atomic<std::thread::id>& threadId
+)
+{
+	std::unique_ptr<Threading::Task> task = Threading::MakeLambdaTask(
+		[&isBlocked, &threadId](const std::atomic_bool&)
+		{
+			threadId = std::this_thread::get_id();
+			while (isBlocked)
+			{
+				std::this_thread::yield();
+			}
+		}
+	);
+	task->SetTag(tag);
+	return task;
+}
+
+
+template<typename _PredType>
+void WaitUntil(_PredType pred)
+{
+	while (!pred())
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_StallWatchdog, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_StallWatchdog, RunningTasks)
+{
+	WatchedThreadPool pool(2);
+	EXPECT_TRUE(pool.GetRunningTasks().empty());
+
+	std::atomic_bool isBlocked(true);
+	std::atomic<std::thread::id> threadId;
+	pool.AddTask(MakeBlockedTask("Blocked", isBlocked, threadId));
+	WaitUntil(
+		[&threadId]()
+		{
+			return threadId.load() != std::thread::id();
+		}
+	);
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+	std::vector<Threading::RunningTaskInfo> infos = pool.GetRunningTasks();
+	ASSERT_EQ(infos.size(), 1);
+	EXPECT_EQ(std::strcmp(infos[0].m_tag, "Blocked"), 0);
+	EXPECT_EQ(infos[0].m_threadId, threadId.load());
+	EXPECT_EQ(infos[0].m_runIndex, 0);
+	EXPECT_GE(infos[0].m_runTime, std::chrono::milliseconds(5));
+
+	// the task is gone once it is done
+	isBlocked = false;
+	WaitUntil(
+		[&pool]()
+		{
+			return pool.GetRunningTasks().empty();
+		}
+	);
+
+	// including the ones run by adopted workers
+	WatchedThreadPool adoptingPool(0);
+	isBlocked = true;
+	threadId = std::thread::id();
+	adoptingPool.AddTask(MakeBlockedTask("Adopted", isBlocked, threadId));
+	std::thread worker(
+		[&adoptingPool]()
+		{
+			adoptingPool.RunWorker();
+		}
+	);
+	WaitUntil(
+		[&threadId]()
+		{
+			return threadId.load() != std::thread::id();
+		}
+	);
+	infos = adoptingPool.GetRunningTasks();
+	ASSERT_EQ(infos.size(), 1);
+	EXPECT_EQ(std::strcmp(infos[0].m_tag, "Adopted"), 0);
+	EXPECT_EQ(infos[0].m_threadId, worker.get_id());
+
+	isBlocked = false;
+	adoptingPool.Terminate();
+	worker.join();
+	pool.Terminate();
+
+	// a pool that doesn't track them reports none
+	Threading::ThreadPool untrackedPool(1);
+	isBlocked = true;
+	threadId = std::thread::id();
+	untrackedPool.AddTask(MakeBlockedTask("Untracked", isBlocked, threadId));
+	WaitUntil(
+		[&threadId]()
+		{
+			return threadId.load() != std::thread::id();
+		}
+	);
+	EXPECT_TRUE(untrackedPool.GetRunningTasks().empty());
+	isBlocked = false;
+	untrackedPool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_StallWatchdog, ReportStalledTasks)
+{
+	WatchedThreadPool pool(2);
+
+	std::mutex mutex;
+	std::vector<Threading::RunningTaskInfo> reports;
+	Threading::StallWatchdog watchdog(
+		pool,
+		std::chrono::milliseconds(20),
+		std::chrono::milliseconds(2),
+		[&mutex, &reports](const Threading::RunningTaskInfo& info)
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			reports.push_back(info);
+		}
+	);
+
+	// short tasks are not reported
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < 10; ++i)
+	{
+		std::unique_ptr<Threading::Task> task = Threading::MakeLambdaTask(
+			[&count](const std::atomic_bool&)
+			{
+				++count;
+			}
+		);
+		task->SetTag("Short");
+		pool.AddTask(std::move(task));
+	}
+	WaitUntil(
+		[&count]()
+		{
+			return count == 10;
+		}
+	);
+
+	// a stalled task is reported, once
+	std::atomic_bool isBlocked(true);
+	std::atomic<std::thread::id> threadId;
+	pool.AddTask(MakeBlockedTask("Stalled", isBlocked, threadId));
+	WaitUntil(
+		[&watchdog]()
+		{
+			return watchdog.GetNumOfReports() > 0;
+		}
+	);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+
+	EXPECT_EQ(watchdog.GetStalledTasks().size(), 1);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		ASSERT_EQ(reports.size(), 1);
+		EXPECT_EQ(std::strcmp(reports[0].m_tag, "Stalled"), 0);
+		EXPECT_EQ(reports[0].m_threadId, threadId.load());
+		EXPECT_GE(reports[0].m_runTime, std::chrono::milliseconds(20));
+	}
+
+	isBlocked = false;
+	WaitUntil(
+		[&watchdog]()
+		{
+			return watchdog.GetStalledTasks().empty();
+		}
+	);
+	EXPECT_EQ(watchdog.GetNumOfReports(), 1);
+
+	watchdog.Stop();
+	pool.Terminate();
+}
@@ -0,0 +1,238 @@
+// Copyright (c) 2022 Haofan Zheng
+// Use of this source code is governed by an MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT.
+
+
+#include <cstdint>
+
+#include <stdexcept>
+#include <thread>
+
+#include <gtest/gtest.h>
+
+#ifdef _MSC_VER
+#include <windows.h>
+#endif // _MSC_VER
+#include <SimpleConcurrency/Threading/TaskGroup.hpp>
+#include <SimpleConcurrency/Threading/ThreadPool.hpp>
+
+
+namespace SimpleConcurrency_Test
+{
+	extern size_t g_numOfTestFile;
+}
+
+
+#ifndef SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE
+using namespace SimpleConcurrency;
+#else
+using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
+#endif
+
+
+namespace
+{
+
+uint64_t ParallelSum(Threading::ThreadPool& pool, uint64_t begin, uint64_t end)
+{
+	if (end - begin <= 16)
+	{
+		uint64_t sum = 0;
+		for (uint64_t i = begin; i < end; ++i)
+		{
+			sum += i;
+		}
+		return sum;
+	}
+
+	// sum the two halves in subtasks, and wait for them
+	uint64_t mid = begin + (end - begin) / 2;
+	uint64_t leftSum = 0;
+	uint64_t rightSum = 0;
+
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&pool, &leftSum, begin, mid]()
+		{
+			leftSum = ParallelSum(pool, begin, mid);
+		}
+	);
+	group.Spawn(
+		[&pool, &rightSum, mid, end]()
+		{
+			rightSum = ParallelSum(pool, mid, end);
+		}
+	);
+	group.Wait();
+
+	return leftSum + rightSum;
+}
+
+} // namespace
+
+
+GTEST_TEST(Test_Threading_TaskGroup, CountTestFile)
+{
+	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
+	(void)tmp;
+}
+
+
+GTEST_TEST(Test_Threading_TaskGroup, WaitOutsidePool)
+{
+	Threading::ThreadPool pool(2);
+
+	std::atomic<int> numOfRuns(0);
+	Threading::TaskGroup group(pool);
+	for (int i = 0; i < 100; ++i)
+	{
+		group.Spawn(
+			[&numOfRuns]()
+			{
+				++numOfRuns;
+			}
+		);
+	}
+	group.Wait();
+	EXPECT_EQ(numOfRuns, 100);
+	EXPECT_EQ(group.GetNumOfUnfinished(), 0);
+
+	// the group tasks are not left for `Update`
+	EXPECT_EQ(pool.GetNumOfFinishedTasks(), 0);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_TaskGroup, RecursiveOnSingleWorker)
+{
+	// every level waits for its subtasks; with a single worker, this only
+	// finishes if the waiting worker runs them itself
+	Threading::ThreadPool pool(1);
+
+	uint64_t sum = 0;
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&pool, &sum]()
+		{
+			sum = ParallelSum(pool, 0, 2000);
+		}
+	);
+	group.Wait();
+	EXPECT_EQ(sum, 2000ULL * 1999ULL / 2);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_TaskGroup, RecursiveOnManyWorkers)
+{
+	Threading::ThreadPool pool(4);
+
+	uint64_t sum = 0;
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&pool, &sum]()
+		{
+			sum = ParallelSum(pool, 0, 20000);
+		}
+	);
+	group.Wait();
+	EXPECT_EQ(sum, 20000ULL * 19999ULL / 2);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_TaskGroup, Exception)
+{
+	Threading::ThreadPool pool(2);
+
+	std::atomic<int> numOfRuns(0);
+	Threading::TaskGroup group(pool);
+	for (int i = 0; i < 10; ++i)
+	{
+		group.Spawn(
+			[&numOfRuns, i]()
+			{
+				++numOfRuns;
+				if (i == 5)
+				{
+					throw std::runtime_error("Subtask failed");
+				}
+			}
+		);
+	}
+	EXPECT_THROW(group.Wait(), std::runtime_error);
+	// the other tasks still run
+	EXPECT_EQ(numOfRuns, 10);
+
+	// the exception is only thrown once
+	group.Wait();
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_TaskGroup, RunPendingTask)
+{
+	Threading::ThreadPool pool(1);
+
+	// occupy the only worker
+	std::atomic_bool isBlocked(true);
+	Threading::TaskGroup blockerGroup(pool);
+	blockerGroup.Spawn(
+		[&isBlocked]()
+		{
+			while (isBlocked)
+			{
+				std::this_thread::yield();
+			}
+		}
+	);
+	while (pool.GetNumOfPendingTasks() > 0)
+	{
+		std::this_thread::yield();
+	}
+
+	std::atomic<int> numOfRuns(0);
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&numOfRuns]()
+		{
+			++numOfRuns;
+		}
+	);
+
+	// any thread can help to run the pending tasks
+	EXPECT_TRUE(pool.RunPendingTask());
+	EXPECT_FALSE(pool.RunPendingTask());
+	EXPECT_EQ(numOfRuns, 1);
+	group.Wait();
+
+	isBlocked = false;
+	blockerGroup.Wait();
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_TaskGroup, TerminatedPool)
+{
+	Threading::ThreadPool pool(2);
+	pool.Terminate();
+
+	// the pool would never run the task, so it is run right away
+	std::thread::id runThreadId;
+	Threading::TaskGroup group(pool);
+	group.Spawn(
+		[&runThreadId]()
+		{
+			runThreadId = std::this_thread::get_id();
+		}
+	);
+	EXPECT_EQ(group.GetNumOfUnfinished(), 0);
+	EXPECT_EQ(runThreadId, std::this_thread::get_id());
+	group.Wait();
+}
@@ -4,6 +4,15 @@
 // https://opensource.org/licenses/MIT.
 
 
+#include <limits>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
 #include <gtest/gtest.h>
 
 #ifdef _MSC_VER
@@ -26,6 +35,60 @@ using namespace SIMPLECONCURRENCY_CUSTOMIZED_NAMESPACE;
 #endif
 
 
+namespace
+{
+
+// a pool timing its tasks, for the wait time estimate
+using TimingThreadPool = Threading::BasicThreadPool<
+	Threading::LockedQueuePolicy,
+	Threading::BlockingWaitPolicy,
+	Threading::DefaultCompletionPolicy,
+	Threading::CountingStatsPolicy
+>;
+
+
+class DeadlineTask :
+	public Threading::Task
+{
+public:
+	DeadlineTask(
+		std::atomic_uint64_t& numOfRuns,
+		std::atomic_uint64_t& numOfExpired,
+		Threading::Task::TimePoint deadline
+	) :
+		m_numOfRuns(numOfRuns),
+		m_numOfExpired(numOfExpired)
+	{
+		SetDeadline(deadline);
+		SetCompletionMode(Threading::CompletionMode::Inline);
+	}
+
+	virtual ~DeadlineTask() = default;
+
+	virtual void Run() override
+	{}
+
+	virtual void Finishing() override
+	{
+		++m_numOfRuns;
+	}
+
+	virtual void Terminate() override
+	{}
+
+	virtual void OnExpired() override
+	{
+		++m_numOfExpired;
+	}
+
+private:
+	std::atomic_uint64_t& m_numOfRuns;
+	std::atomic_uint64_t& m_numOfExpired;
+}; // class DeadlineTask
+
+} // namespace
+
+
 GTEST_TEST(Test_Threading_ThreadPool, CountTestFile)
 {
 	static auto tmp = ++SimpleConcurrency_Test::g_numOfTestFile;
@@ -225,3 +288,1130 @@ GTEST_TEST(Test_Threading_ThreadPool, CreateNewThreadForNewTask)
 
 	pool.Terminate();
 }
+
+
+GTEST_TEST(Test_Threading_ThreadPool, BatchedDequeue)
+{
+	auto testProg =
+		[](size_t maxBatchSize, const std::vector<size_t>& expPendingSizes)
+		{
+			Threading::ThreadPool pool(1);
+			pool.SetMaxDequeueBatchSize(maxBatchSize);
+			EXPECT_EQ(pool.GetMaxDequeueBatchSize(), maxBatchSize);
+
+			// keep the only worker busy, until all tasks are added
+			std::atomic_bool isBlocked(true);
+			std::atomic_uint64_t count(0);
+			pool.AddTask(
+				Threading::MakeLambdaTask(
+					[&isBlocked, &count](const std::atomic_bool&)
+					{
+						while (isBlocked)
+						{
+							std::this_thread::yield();
+						}
+						++count;
+					}
+				)
+			);
+
+			// each task records the number of tasks left in the shared
+			// queue; only one thread runs them, so no mutex is needed
+			std::vector<size_t> pendingSizes;
+			for (size_t i = 0; i < expPendingSizes.size(); ++i)
+			{
+				pool.AddTask(
+					Threading::MakeLambdaTask(
+						[&pool, &pendingSizes, &count](const std::atomic_bool&)
+						{
+							pendingSizes.push_back(pool.GetNumOfPendingTasks());
+							++count;
+						}
+					)
+				);
+			}
+			EXPECT_EQ(pool.GetNumOfPendingTasks(), expPendingSizes.size());
+
+			isBlocked = false;
+			while (count < expPendingSizes.size() + 1)
+			{
+				std::this_thread::yield();
+			}
+
+			EXPECT_EQ(pendingSizes, expPendingSizes);
+			pool.Terminate();
+		};
+
+	// one task per lock acquisition
+	testProg(1, std::vector<size_t>({ 5, 4, 3, 2, 1, 0 }));
+	// the only worker takes up to 4 tasks at once
+	testProg(
+		4,
+		std::vector<size_t>({ 6, 6, 6, 6, 2, 2, 2, 2, 0, 0 })
+	);
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, BatchedDequeueWithBusyWorkers)
+{
+	const size_t numOfWorkers = 4;
+	Threading::ThreadPool pool(numOfWorkers);
+
+	// keep all workers busy, until all tasks are added
+	std::vector<std::unique_ptr<std::atomic_bool> > isBlocked;
+	std::atomic_uint64_t numOfStarted(0);
+	std::atomic_uint64_t count(0);
+	for (size_t i = 0; i < numOfWorkers; ++i)
+	{
+		isBlocked.emplace_back(new std::atomic_bool(true));
+		std::atomic_bool& blocked = *isBlocked.back();
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&blocked, &numOfStarted, &count](const std::atomic_bool&)
+				{
+					++numOfStarted;
+					while (blocked)
+					{
+						std::this_thread::yield();
+					}
+					++count;
+				}
+			)
+		);
+	}
+	while (numOfStarted < numOfWorkers)
+	{
+		std::this_thread::yield();
+	}
+
+	std::atomic<size_t> firstPendingSize(0);
+	std::atomic_bool isFirst(true);
+	const size_t numOfTasks = 40;
+	for (size_t i = 0; i < numOfTasks; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&pool, &firstPendingSize, &isFirst, &count](
+					const std::atomic_bool&
+				)
+				{
+					if (isFirst.exchange(false))
+					{
+						firstPendingSize = pool.GetNumOfPendingTasks();
+					}
+					++count;
+				}
+			)
+		);
+	}
+
+	// the only free worker takes its share of the queue, not a full
+	// batch, as the busy workers come back for more
+	*isBlocked[0] = false;
+	while (isFirst)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(firstPendingSize, numOfTasks - (numOfTasks / numOfWorkers));
+
+	for (auto& blocked : isBlocked)
+	{
+		*blocked = false;
+	}
+	while (count < numOfTasks + numOfWorkers)
+	{
+		std::this_thread::yield();
+	}
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, CompletionModes)
+{
+	std::thread::id mainThreadId = std::this_thread::get_id();
+
+	// runs one task on `pool`, and returns the threads running the `Run`
+	// and the `Finishing` functions
+	auto testProg =
+		[](
+			Threading::ThreadPool& pool,
+			Threading::CompletionMode taskMode,
+			bool callUpdate
+		)
+		{
+			std::atomic_bool isFinished(false);
+			std::thread::id runThreadId;
+			std::thread::id finishThreadId;
+
+			auto task = Threading::MakeLambdaTask(
+				[&runThreadId](const std::atomic_bool&)
+				{
+					runThreadId = std::this_thread::get_id();
+				},
+				[&isFinished, &finishThreadId]()
+				{
+					finishThreadId = std::this_thread::get_id();
+					isFinished = true;
+				}
+			);
+			task->SetCompletionMode(taskMode);
+			pool.AddTask(std::move(task));
+
+			while (!isFinished)
+			{
+				if (callUpdate)
+				{
+					pool.Update();
+				}
+				std::this_thread::yield();
+			}
+
+			return std::make_pair(runThreadId, finishThreadId);
+		};
+
+	Threading::ThreadPool completionPool(1);
+	Threading::ThreadPool pool(1);
+
+	// default; finished in the thread calling `Update`
+	EXPECT_EQ(pool.GetCompletionMode(), Threading::CompletionMode::Update);
+	auto ids = testProg(pool, Threading::CompletionMode::UsePoolDefault, true);
+	EXPECT_EQ(ids.second, mainThreadId);
+
+	// inline; finished in the worker, without calling `Update`
+	pool.SetCompletionMode(Threading::CompletionMode::Inline);
+	ids = testProg(pool, Threading::CompletionMode::UsePoolDefault, false);
+	EXPECT_EQ(ids.second, ids.first);
+
+	// dedicated thread
+	pool.SetCompletionMode(Threading::CompletionMode::DedicatedThread);
+	ids = testProg(pool, Threading::CompletionMode::UsePoolDefault, false);
+	EXPECT_NE(ids.second, ids.first);
+	EXPECT_NE(ids.second, mainThreadId);
+	std::thread::id completionThreadId = ids.second;
+	ids = testProg(pool, Threading::CompletionMode::UsePoolDefault, false);
+	EXPECT_EQ(ids.second, completionThreadId);
+
+	// on another pool
+	EXPECT_THROW(
+		pool.SetCompletionMode(Threading::CompletionMode::UsePoolDefault),
+		std::invalid_argument
+	);
+	pool.SetCompletionExecutor(completionPool);
+	EXPECT_EQ(pool.GetCompletionMode(), Threading::CompletionMode::OnExecutor);
+	ids = testProg(pool, Threading::CompletionMode::UsePoolDefault, false);
+	EXPECT_NE(ids.second, ids.first);
+	EXPECT_NE(ids.second, mainThreadId);
+	EXPECT_NE(ids.second, completionThreadId);
+
+	// a task can override the mode of the pool
+	ids = testProg(pool, Threading::CompletionMode::Update, true);
+	EXPECT_EQ(ids.second, mainThreadId);
+	ids = testProg(pool, Threading::CompletionMode::Inline, false);
+	EXPECT_EQ(ids.second, ids.first);
+
+	pool.Terminate();
+	completionPool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, CompletionThreadException)
+{
+	Threading::ThreadPool pool(1);
+	pool.SetCompletionMode(Threading::CompletionMode::DedicatedThread);
+
+	std::atomic_bool isCaught(false);
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[](const std::atomic_bool&) {},
+			[]() { throw std::runtime_error("Finishing failed"); },
+			[]() {},
+			[&isCaught](std::exception_ptr) { isCaught = true; }
+		)
+	);
+
+	while (!isCaught)
+	{
+		std::this_thread::yield();
+	}
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, ConcurrentUpdate)
+{
+	const uint64_t numOfTasks = 2000;
+	const size_t numOfConsumers = 4;
+
+	Threading::ThreadPool pool(2);
+
+	std::atomic_uint64_t numOfRuns(0);
+	std::atomic_uint64_t numOfFinished(0);
+
+	std::vector<std::thread> consumers;
+	for (size_t i = 0; i < numOfConsumers; ++i)
+	{
+		consumers.emplace_back(
+			[&pool, &numOfFinished, numOfTasks]()
+			{
+				while (numOfFinished < numOfTasks)
+				{
+					pool.Update();
+					std::this_thread::yield();
+				}
+			}
+		);
+	}
+
+	for (uint64_t i = 0; i < numOfTasks; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&numOfRuns](const std::atomic_bool&)
+				{
+					++numOfRuns;
+				},
+				[&numOfFinished]()
+				{
+					++numOfFinished;
+				}
+			)
+		);
+	}
+
+	for (auto& consumer : consumers)
+	{
+		consumer.join();
+	}
+
+	// every task is finished exactly once
+	EXPECT_EQ(numOfRuns, numOfTasks);
+	EXPECT_EQ(numOfFinished, numOfTasks);
+	pool.Update();
+	EXPECT_EQ(numOfFinished, numOfTasks);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, UpdateOnSubmitter)
+{
+	const uint64_t numOfTasks = 100;
+
+	Threading::ThreadPool pool(2);
+	pool.SetCompletionMode(Threading::CompletionMode::UpdateOnSubmitter);
+
+	std::atomic_uint64_t numOfFinished(0);
+	std::atomic_uint64_t numOfWrongThreads(0);
+
+	auto submitAndUpdate =
+		[&pool, &numOfFinished, &numOfWrongThreads, numOfTasks]()
+		{
+			std::thread::id submitterId = std::this_thread::get_id();
+			for (uint64_t i = 0; i < numOfTasks; ++i)
+			{
+				pool.AddTask(
+					Threading::MakeLambdaTask(
+						[](const std::atomic_bool&) {},
+						[&numOfFinished, &numOfWrongThreads, submitterId]()
+						{
+							if (std::this_thread::get_id() != submitterId)
+							{
+								++numOfWrongThreads;
+							}
+							++numOfFinished;
+						}
+					)
+				);
+			}
+
+			// keep updating until all tasks of both threads are finished
+			while (numOfFinished < 2 * numOfTasks)
+			{
+				pool.Update();
+				std::this_thread::yield();
+			}
+		};
+
+	std::thread otherThread(submitAndUpdate);
+	submitAndUpdate();
+	otherThread.join();
+
+	EXPECT_EQ(numOfFinished, 2 * numOfTasks);
+	EXPECT_EQ(numOfWrongThreads, 0);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, UpdateException)
+{
+	Threading::ThreadPool pool(1);
+
+	std::atomic_uint64_t numOfRuns(0);
+	std::vector<int> finishOrder;
+	for (int i = 0; i < 3; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&numOfRuns](const std::atomic_bool&)
+				{
+					++numOfRuns;
+				},
+				[&finishOrder, i]()
+				{
+					finishOrder.push_back(i);
+					if (i == 0)
+					{
+						throw std::runtime_error("Finishing failed");
+					}
+				}
+			)
+		);
+	}
+	while (pool.GetNumOfFinishedTasks() < 3)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfRuns, 3);
+
+	// the tasks after the failed one are not lost
+	EXPECT_THROW(pool.Update(), std::runtime_error);
+	pool.Update();
+	EXPECT_EQ(finishOrder, std::vector<int>({ 0, 1, 2 }));
+
+	// and the ones routed to the submitter stay with it
+	finishOrder.clear();
+	pool.SetCompletionMode(Threading::CompletionMode::UpdateOnSubmitter);
+	for (int i = 0; i < 3; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[](const std::atomic_bool&) {},
+				[&finishOrder, i]()
+				{
+					finishOrder.push_back(i);
+					if (i == 0)
+					{
+						throw std::runtime_error("Finishing failed");
+					}
+				}
+			)
+		);
+	}
+	while (pool.GetNumOfFinishedTasks() < 3)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_THROW(pool.Update(), std::runtime_error);
+	std::thread otherThread(
+		[&pool]()
+		{
+			pool.Update();
+		}
+	);
+	otherThread.join();
+	EXPECT_EQ(finishOrder, std::vector<int>({ 0 }));
+	pool.Update();
+	EXPECT_EQ(finishOrder, std::vector<int>({ 0, 1, 2 }));
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, ExpiredTasks)
+{
+	TimingThreadPool pool(1);
+
+	// keep the only worker busy, until the deadlines have passed
+	std::atomic_bool isBlocked(true);
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&isBlocked](const std::atomic_bool&)
+			{
+				while (isBlocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		)
+	);
+
+	std::atomic_uint64_t numOfRuns(0);
+	std::atomic_uint64_t numOfExpired(0);
+	auto now = Threading::Task::Clock::now();
+	for (int i = 0; i < 4; ++i)
+	{
+		// every other task expires
+		pool.AddTask(std::unique_ptr<Threading::Task>(new DeadlineTask(
+			numOfRuns,
+			numOfExpired,
+			(i % 2 == 0) ?
+				now + std::chrono::milliseconds(1) :
+				now + std::chrono::hours(1)
+		)));
+	}
+	std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	isBlocked = false;
+
+	while (numOfRuns + numOfExpired < 4)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfRuns, 2);
+	EXPECT_EQ(numOfExpired, 2);
+	EXPECT_EQ(pool.GetNumOfExpiredTasks(), 2);
+	EXPECT_GE(pool.GetRecentQueueTime(), std::chrono::nanoseconds(1));
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, AdmissionControl)
+{
+	TimingThreadPool pool(1);
+	EXPECT_EQ(pool.GetEstimatedWaitTime(), std::chrono::nanoseconds(0));
+
+	// learn the run time of the tasks
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < 10; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&count](const std::atomic_bool&)
+				{
+					std::this_thread::sleep_for(std::chrono::milliseconds(2));
+					++count;
+				}
+			)
+		);
+	}
+	while (count < 10)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_GE(pool.GetRecentRunTime(), std::chrono::microseconds(500));
+
+	// queue up some more behind a busy worker
+	std::atomic_bool isBlocked(true);
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&isBlocked](const std::atomic_bool&)
+			{
+				while (isBlocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		)
+	);
+	while (pool.GetNumOfPendingTasks() > 0)
+	{
+		std::this_thread::yield();
+	}
+	for (int i = 0; i < 5; ++i)
+	{
+		pool.AddTask(Threading::MakeLambdaTask([](const std::atomic_bool&) {}));
+	}
+	EXPECT_GE(pool.GetEstimatedWaitTime(), std::chrono::milliseconds(3));
+
+	// a deadline that can't be met is rejected up front
+	std::atomic_uint64_t numOfRuns(0);
+	std::atomic_uint64_t numOfExpired(0);
+	auto now = Threading::Task::Clock::now();
+	std::unique_ptr<Threading::Task> task(new DeadlineTask(
+		numOfRuns, numOfExpired, now + std::chrono::microseconds(100)
+	));
+	EXPECT_FALSE(pool.TryAddTask(task));
+	EXPECT_NE(task, nullptr);
+
+	task.reset(new DeadlineTask(
+		numOfRuns, numOfExpired, now + std::chrono::hours(1)
+	));
+	EXPECT_TRUE(pool.TryAddTask(task));
+	EXPECT_EQ(task, nullptr);
+
+	isBlocked = false;
+	while (numOfRuns < 1)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfExpired, 0);
+
+	pool.Terminate();
+
+	// the default pool doesn't time its tasks
+	Threading::ThreadPool untimedPool(1);
+	count = 0;
+	untimedPool.AddTask(
+		Threading::MakeLambdaTask(
+			[&count](const std::atomic_bool&)
+			{
+				std::this_thread::sleep_for(std::chrono::milliseconds(2));
+				++count;
+			}
+		)
+	);
+	while (count < 1)
+	{
+		std::this_thread::yield();
+	}
+	untimedPool.Terminate();
+	EXPECT_EQ(untimedPool.GetRecentRunTime(), std::chrono::nanoseconds(0));
+	EXPECT_EQ(untimedPool.GetRecentQueueTime(), std::chrono::nanoseconds(0));
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, SetPoolSize)
+{
+	Threading::ThreadPool pool(1);
+
+	// more blocked tasks than workers
+	std::atomic_bool isBlocked(true);
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < 4; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&isBlocked, &count](const std::atomic_bool&)
+				{
+					while (isBlocked)
+					{
+						std::this_thread::yield();
+					}
+					++count;
+				}
+			)
+		);
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 1);
+
+	// the pending tasks get workers right away
+	pool.SetPoolSize(4);
+	EXPECT_EQ(pool.GetPoolSize(), 4);
+	EXPECT_EQ(pool.GetNumOfThreads(), 4);
+	EXPECT_EQ(pool.GetNumOfPendingTasks(), 0);
+
+	// the extra workers retire once they are done
+	pool.SetPoolSize(2);
+	EXPECT_EQ(pool.GetNumOfThreads(), 4);
+	isBlocked = false;
+	while (count < 4 || pool.GetNumOfThreads() > 2)
+	{
+		std::this_thread::yield();
+	}
+
+	// and it keeps working at the new size
+	for (int i = 0; i < 4; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&count](const std::atomic_bool&)
+				{
+					++count;
+				}
+			)
+		);
+	}
+	while (count < 8)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_LE(pool.GetNumOfThreads(), 2);
+
+	// with no workers, the tasks wait for the pool to grow again
+	pool.SetPoolSize(0);
+	while (pool.GetNumOfThreads() > 0)
+	{
+		std::this_thread::yield();
+	}
+	count = 0;
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&count](const std::atomic_bool&)
+			{
+				++count;
+			}
+		)
+	);
+	EXPECT_EQ(pool.GetNumOfPendingTasks(), 1);
+	pool.SetPoolSize(1);
+	while (count < 1)
+	{
+		std::this_thread::yield();
+	}
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, AffinityKeys)
+{
+	static constexpr int sk_poolSize = 4;
+	static constexpr int sk_numOfTasksPerKey = 20;
+
+	Threading::ThreadPool pool(sk_poolSize);
+	pool.SetMaxAffinityBacklog(sk_numOfTasksPerKey);
+	EXPECT_EQ(pool.GetMaxAffinityBacklog(), uint64_t(sk_numOfTasksPerKey));
+
+	// start all workers first; until then, keyed tasks are just shared
+	std::atomic_bool isBlocked(true);
+	std::atomic_uint64_t numOfStarted(0);
+	for (int i = 0; i < sk_poolSize; ++i)
+	{
+		pool.AddTask(
+			i,
+			Threading::MakeLambdaTask(
+				[&isBlocked, &numOfStarted](const std::atomic_bool&)
+				{
+					++numOfStarted;
+					while (isBlocked)
+					{
+						std::this_thread::yield();
+					}
+				}
+			)
+		);
+	}
+	while (numOfStarted < sk_poolSize)
+	{
+		std::this_thread::yield();
+	}
+	isBlocked = false;
+
+	// tasks with the same key run on the same worker; the others are idle,
+	// but don't steal from a short backlog
+	std::mutex mutex;
+	std::map<int, std::map<std::thread::id, int> > threadsOfKeys;
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < sk_numOfTasksPerKey; ++i)
+	{
+		for (int key = 0; key < sk_poolSize; ++key)
+		{
+			pool.AddTask(
+				key,
+				Threading::MakeLambdaTask(
+					[&mutex, &threadsOfKeys, &count, key](const std::atomic_bool&)
+					{
+						{
+							std::lock_guard<std::mutex> lock(mutex);
+							++threadsOfKeys[key][std::this_thread::get_id()];
+						}
+						++count;
+					}
+				)
+			);
+			// one at a time, so the preferred worker is back to idle
+			while (count < uint64_t(i * sk_poolSize + key + 1))
+			{
+				std::this_thread::yield();
+			}
+		}
+	}
+	std::set<std::thread::id> allThreads;
+	for (const auto& keyThreads : threadsOfKeys)
+	{
+		ASSERT_EQ(keyThreads.second.size(), 1);
+		allThreads.insert(keyThreads.second.begin()->first);
+	}
+	EXPECT_EQ(allThreads.size(), uint64_t(sk_poolSize));
+
+	// an overloaded worker shares the tasks preferring it
+	pool.SetMaxAffinityBacklog(1);
+	isBlocked = true;
+	std::atomic<std::thread::id> blockedThread;
+	pool.AddTask(
+		0,
+		Threading::MakeLambdaTask(
+			[&isBlocked, &blockedThread](const std::atomic_bool&)
+			{
+				blockedThread = std::this_thread::get_id();
+				while (isBlocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		)
+	);
+	while (blockedThread.load() == std::thread::id())
+	{
+		std::this_thread::yield();
+	}
+	std::atomic_uint64_t numOfShared(0);
+	for (int i = 0; i < 4; ++i)
+	{
+		pool.AddTask(
+			0,
+			Threading::MakeLambdaTask(
+				[&blockedThread, &numOfShared](const std::atomic_bool&)
+				{
+					if (std::this_thread::get_id() != blockedThread.load())
+					{
+						++numOfShared;
+					}
+				}
+			)
+		);
+	}
+	// one waits for the blocked worker, the rest are run by others
+	while (numOfShared < 3)
+	{
+		std::this_thread::yield();
+	}
+	isBlocked = false;
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, AffinityStealing)
+{
+	static constexpr uint64_t sk_numOfTasks = 5;
+	static constexpr uint64_t sk_stealThreshold = 2;
+
+	Threading::ThreadPool pool(2);
+	pool.SetMaxAffinityBacklog(sk_numOfTasks);
+	pool.SetAffinityStealThreshold(sk_stealThreshold);
+	EXPECT_EQ(pool.GetAffinityStealThreshold(), sk_stealThreshold);
+
+	// start both workers
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < 2; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&count](const std::atomic_bool&)
+				{
+					++count;
+				}
+			)
+		);
+	}
+	while (count < 2 || pool.GetNumOfThreads() < 2)
+	{
+		std::this_thread::yield();
+	}
+
+	// keep the worker preferred by the key busy
+	std::atomic_bool isBlocked(true);
+	std::atomic<std::thread::id> blockedThread;
+	pool.AddTask(
+		0,
+		Threading::MakeLambdaTask(
+			[&isBlocked, &blockedThread](const std::atomic_bool&)
+			{
+				blockedThread = std::this_thread::get_id();
+				while (isBlocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		)
+	);
+	while (blockedThread.load() == std::thread::id())
+	{
+		std::this_thread::yield();
+	}
+
+	// the tasks beyond the threshold are stolen by the idle worker,
+	// without waiting for the busy one; the rest wait for it
+	std::atomic_uint64_t numOfStolen(0);
+	count = 0;
+	for (uint64_t i = 0; i < sk_numOfTasks; ++i)
+	{
+		pool.AddTask(
+			0,
+			Threading::MakeLambdaTask(
+				[&blockedThread, &numOfStolen, &count](const std::atomic_bool&)
+				{
+					if (std::this_thread::get_id() != blockedThread.load())
+					{
+						++numOfStolen;
+					}
+					++count;
+				}
+			)
+		);
+	}
+	while (numOfStolen < sk_numOfTasks - sk_stealThreshold)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(pool.GetNumOfPendingTasks(), 0);
+	isBlocked = false;
+
+	while (count < sk_numOfTasks)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(numOfStolen.load(), sk_numOfTasks - sk_stealThreshold);
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, AffinityStartsWorker)
+{
+	Threading::ThreadPool pool(2);
+
+	// the only worker is busy
+	std::atomic_bool isBlocked(true);
+	std::atomic<std::thread::id> blockedThread;
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&isBlocked, &blockedThread](const std::atomic_bool&)
+			{
+				blockedThread = std::this_thread::get_id();
+				while (isBlocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		)
+	);
+	while (blockedThread.load() == std::thread::id())
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 1);
+
+	// a task preferring it doesn't wait behind it, as the pool can still
+	// start another worker
+	std::atomic<std::thread::id> keyedThread;
+	pool.AddTask(
+		0,
+		Threading::MakeLambdaTask(
+			[&keyedThread](const std::atomic_bool&)
+			{
+				keyedThread = std::this_thread::get_id();
+			}
+		)
+	);
+	while (keyedThread.load() == std::thread::id())
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_NE(keyedThread.load(), blockedThread.load());
+	EXPECT_EQ(pool.GetNumOfThreads(), 2);
+	isBlocked = false;
+
+	pool.Terminate();
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, AdoptedWorkers)
+{
+	static constexpr int sk_numOfTasks = 20;
+
+	// the pool never creates a thread of its own
+	Threading::ThreadPool pool(0);
+
+	std::mutex mutex;
+	std::set<std::thread::id> threadsOfTasks;
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < sk_numOfTasks; ++i)
+	{
+		pool.AddTask(
+			Threading::MakeLambdaTask(
+				[&mutex, &threadsOfTasks, &count](const std::atomic_bool&)
+				{
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						threadsOfTasks.insert(std::this_thread::get_id());
+					}
+					++count;
+				}
+			)
+		);
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 0);
+	EXPECT_EQ(pool.GetNumOfPendingTasks(), uint64_t(sk_numOfTasks));
+
+	// threads created elsewhere join the pool, and run the tasks
+	Threading::StopToken stopToken;
+	std::atomic_bool isWorkerAfterLeaving(true);
+	std::vector<std::thread> threads;
+	for (int i = 0; i < 2; ++i)
+	{
+		threads.emplace_back(
+			[&pool, &stopToken, &isWorkerAfterLeaving]()
+			{
+				pool.JoinAsWorker(stopToken);
+				isWorkerAfterLeaving =
+					Threading::ThreadPoolBase::GetCurrent() != nullptr;
+			}
+		);
+	}
+	while (count < sk_numOfTasks || pool.GetNumOfAdoptedWorkers() < 2)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(pool.GetNumOfThreads(), 0);
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		EXPECT_LE(threadsOfTasks.size(), 2);
+		for (const auto& thread : threads)
+		{
+			threadsOfTasks.erase(thread.get_id());
+		}
+		EXPECT_TRUE(threadsOfTasks.empty());
+	}
+
+	// a worker can't join again
+	std::atomic_bool hasThrown(false);
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&pool, &hasThrown, &count](const std::atomic_bool&)
+			{
+				try
+				{
+					pool.RunWorker();
+				}
+				catch(const std::logic_error&)
+				{
+					hasThrown = true;
+				}
+				++count;
+			}
+		)
+	);
+	while (count < sk_numOfTasks + 1)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_TRUE(hasThrown);
+
+	// they leave when told to
+	stopToken.RequestStop();
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+	EXPECT_EQ(pool.GetNumOfAdoptedWorkers(), 0);
+	EXPECT_FALSE(isWorkerAfterLeaving);
+
+	// and the tasks wait for the next worker
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&count](const std::atomic_bool&)
+			{
+				++count;
+			}
+		)
+	);
+	EXPECT_EQ(pool.GetNumOfPendingTasks(), 1);
+	std::thread worker(
+		[&pool]()
+		{
+			pool.RunWorker();
+		}
+	);
+	while (count < sk_numOfTasks + 2)
+	{
+		std::this_thread::yield();
+	}
+
+	// which works until the pool is terminated
+	pool.Terminate();
+	worker.join();
+	EXPECT_EQ(pool.GetNumOfAdoptedWorkers(), 0);
+}
+
+
+GTEST_TEST(Test_Threading_ThreadPool, PollingWorkers)
+{
+	static constexpr int sk_numOfTasks = 100;
+
+	Threading::ThreadPool pool(1);
+	EXPECT_LE(pool.StartPollingWorkers(1, std::vector<size_t>({ 0 })), 1);
+	EXPECT_EQ(pool.GetNumOfPollingWorkers(), 1);
+	EXPECT_EQ(pool.GetNumOfThreads(), 0);
+
+	// low-latency tasks are all run by the polling worker
+	std::mutex mutex;
+	std::set<std::thread::id> threadsOfTasks;
+	std::atomic_uint64_t count(0);
+	for (int i = 0; i < sk_numOfTasks; ++i)
+	{
+		pool.AddLowLatencyTask(
+			Threading::MakeLambdaTask(
+				[&mutex, &threadsOfTasks, &count](const std::atomic_bool&)
+				{
+					{
+						std::lock_guard<std::mutex> lock(mutex);
+						threadsOfTasks.insert(std::this_thread::get_id());
+					}
+					++count;
+				}
+			)
+		);
+	}
+	while (count < sk_numOfTasks)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(threadsOfTasks.size(), 1);
+	EXPECT_EQ(pool.GetNumOfThreads(), 0);
+
+	// the other tasks are run by the other workers, even when the polling
+	// worker is busy
+	std::atomic_bool isBlocked(true);
+	std::atomic_bool isStarted(false);
+	pool.AddLowLatencyTask(
+		Threading::MakeLambdaTask(
+			[&isBlocked, &isStarted](const std::atomic_bool&)
+			{
+				isStarted = true;
+				while (isBlocked)
+				{
+					std::this_thread::yield();
+				}
+			}
+		)
+	);
+	while (!isStarted)
+	{
+		std::this_thread::yield();
+	}
+	std::atomic<std::thread::id> bulkThread;
+	pool.AddTask(
+		Threading::MakeLambdaTask(
+			[&bulkThread](const std::atomic_bool&)
+			{
+				bulkThread = std::this_thread::get_id();
+			}
+		)
+	);
+	while (bulkThread.load() == std::thread::id())
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(threadsOfTasks.count(bulkThread.load()), 0);
+	EXPECT_EQ(pool.GetNumOfThreads(), 1);
+	isBlocked = false;
+
+	pool.Terminate();
+	EXPECT_EQ(pool.GetNumOfPollingWorkers(), 0);
+
+	// without polling workers, they are just tasks
+	Threading::ThreadPool plainPool(1);
+	plainPool.AddLowLatencyTask(
+		Threading::MakeLambdaTask(
+			[&count](const std::atomic_bool&)
+			{
+				++count;
+			}
+		)
+	);
+	while (count < sk_numOfTasks + 1)
+	{
+		std::this_thread::yield();
+	}
+	EXPECT_EQ(plainPool.GetNumOfThreads(), 1);
+
+	// a worker that can't be pinned is reported, and started anyway
+	std::vector<size_t> badCpus({ std::numeric_limits<size_t>::max() });
+	EXPECT_EQ(plainPool.StartPollingWorkers(1, badCpus), 0);
+	EXPECT_EQ(plainPool.GetNumOfPollingWorkers(), 1);
+	plainPool.Terminate();
+}